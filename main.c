@@ -8,25 +8,13 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define SCREEN_WIDTH 1920
 #define SCREEN_HEIGHT 1080
 #define CAMERA_THRESHOLD 0.2f
 #define CAMERA_SPEED 0.125f
 
-void PCT_DrawRect(vec4 rect, float z, SDL_Renderer *renderer, mat4 vp) {
-    vec3 bl = {0};
-    vec3 tr = {0};
-    vec4 viewport = {0.0f, 0.0f, (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT};
-    glm_project((vec3){rect[0], rect[1], z}, vp, viewport, bl);
-    glm_project((vec3){rect[2], rect[3], z}, vp, viewport, tr);
-    SDL_RenderFillRect(renderer, &(SDL_FRect){bl[0], bl[1], tr[0] - bl[0], tr[1] - bl[1]});
-}
-
-PCT_AaBb PCT_MoveBox(const PCT_AaBb *box, const PCT_Vector *vec) {
-    return (PCT_AaBb){box->x1 + vec->x, box->y1 + vec->y, box->x2 + vec->x, box->y2 + vec->y};
-}
-
 SDL_FRect PCT_BoxToScreen(const PCT_AaBb *box, mat4 vp) {
     vec3 pointA = {0}, pointB = {0};
     glm_project((vec3){box->x1, box->y1, 0.0f}, vp,
@@ -36,26 +24,203 @@ SDL_FRect PCT_BoxToScreen(const PCT_AaBb *box, mat4 vp) {
     return (SDL_FRect){pointA[0], pointB[1], pointB[0] - pointA[0], pointA[1] - pointB[1]};
 }
 
-void PCT_DrawMap(const PCT_KdTree *map, SDL_Renderer *renderer, mat4 vp, float colorVal,
-                 float xoffset, float yoffset) {
+/*
+ * Intersects rays through the screen corners with the z = 0 plane the map lives in, works for the
+ * perspective camera looking along -z. pixelSize receives world size of one screen pixel.
+ */
+void PCT_ViewRectFromVp(mat4 vp, PCT_AaBb *view, float *pixelSize) {
+    mat4 inverse;
+    glm_mat4_inv(vp, inverse);
     vec4 viewport = {0.0f, 0.0f, (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT};
-    SDL_SetRenderDrawColorFloat(renderer, 0.3f, 0.3f, 0.3f, 1.0f);
-    PCT_AaBb screenRect = {0};
-    vec3 bottomLeft;
-    vec3 topRight;
-    screenRect.x1 = -3.5f + xoffset;
-    screenRect.y1 = -2.0f + yoffset;
-    screenRect.x2 = 3.5f + xoffset;
-    screenRect.y2 = 2.0 + yoffset;
-    size_t boxesCount = 0;
-    PCT_AaBb **boxes = PCT_KdTreeRangeSearch(map, &screenRect, &boxesCount);
+    vec2 corners[4] = {{0.0f, 0.0f},
+                       {(float)SCREEN_WIDTH, 0.0f},
+                       {0.0f, (float)SCREEN_HEIGHT},
+                       {(float)SCREEN_WIDTH, (float)SCREEN_HEIGHT}};
+    *view = (PCT_AaBb){FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (size_t i = 0; i < 4; i++) {
+        vec3 near, far;
+        glm_unprojecti((vec3){corners[i][0], corners[i][1], 0.0f}, inverse, viewport, near);
+        glm_unprojecti((vec3){corners[i][0], corners[i][1], 1.0f}, inverse, viewport, far);
+        float t = near[2] / (near[2] - far[2]);
+        float x = near[0] + (far[0] - near[0]) * t;
+        float y = near[1] + (far[1] - near[1]) * t;
+        view->x1 = fminf(view->x1, x);
+        view->y1 = fminf(view->y1, y);
+        view->x2 = fmaxf(view->x2, x);
+        view->y2 = fmaxf(view->y2, y);
+    }
+    *pixelSize = (view->x2 - view->x1) / (float)SCREEN_WIDTH;
+}
+
+void PCT_CameraVp(const float cameraX, const float cameraY, mat4 vp) {
+    mat4 projection = {0};
+    mat4 view = {0};
+    glm_perspective(glm_rad(45), ((float)SCREEN_WIDTH) / ((float)SCREEN_HEIGHT), 0.1f, 100.0f,
+                    projection);
+    glm_scale(projection, (vec3){1.0f, -1.0f, 1.0f});
+    glm_lookat((vec3){cameraX, cameraY, 3.0f}, (vec3){cameraX, cameraY, -10.0f},
+               (vec3){0.0f, 1.0f, 0.0f}, view);
+    glm_mat4_mul(projection, view, vp);
+}
+
+#define PCT_MAP_LOD_PIXELS 1.0f
+#define PCT_MAP_DRAW_BATCH 1024
+
+/**
+ * @brief Queries map boxes visible from the camera into snapshot, see PCT_DrawMap.
+ */
+void PCT_QueryMapBoxes(const PCT_KdTree *map, PCT_FrameSnapshot *snapshot, mat4 vp) {
+    PCT_KdTreeSite site = PCT_KdTreeProfileSetSite(PCT_KDTREE_SITE_DRAW);
+    PCT_AaBb view;
+    float pixelSize;
+    PCT_ViewRectFromVp(vp, &view, &pixelSize);
+
+    float minExtent = pixelSize * PCT_MAP_LOD_PIXELS;
+    size_t boxesCount = PCT_KdTreeLodQuery(map, &view, minExtent, snapshot->mapBoxes,
+                                           snapshot->mapBoxCapacity);
+    if (boxesCount > snapshot->mapBoxCapacity) {
+        PCT_ReserveSnapshotMapBoxes(snapshot, boxesCount);
+        boxesCount = PCT_KdTreeLodQuery(map, &view, minExtent, snapshot->mapBoxes,
+                                        snapshot->mapBoxCapacity);
+    }
+    snapshot->mapBoxCount = boxesCount;
+    PCT_KdTreeProfileSetSite(site);
+}
+
+void PCT_DrawMap(const PCT_LodBox *boxes, const size_t boxesCount, SDL_Renderer *renderer,
+                 mat4 vp) {
+    // Solid rects go out in a single call, merged ones are blended by how much of them is filled.
+    SDL_FRect rects[PCT_MAP_DRAW_BATCH];
+    size_t rectsCount = 0;
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
     for (size_t i = 0; i < boxesCount; i++) {
-        if (boxes[i] != NULL) {
-            PCT_DrawRect((vec4){boxes[i]->x1, boxes[i]->y1, boxes[i]->x2, boxes[i]->y2}, 0.0f,
-                         renderer, vp);
+        SDL_FRect rect = PCT_BoxToScreen(&boxes[i].box, vp);
+        if (boxes[i].coverage >= 1.0f) {
+            rects[rectsCount++] = rect;
+            if (rectsCount == PCT_MAP_DRAW_BATCH) {
+                SDL_SetRenderDrawColorFloat(renderer, 0.3f, 0.3f, 0.3f, 1.0f);
+                SDL_RenderFillRects(renderer, rects, (int)rectsCount);
+                rectsCount = 0;
+            }
+        } else {
+            SDL_SetRenderDrawColorFloat(renderer, 0.3f, 0.3f, 0.3f, boxes[i].coverage);
+            SDL_RenderFillRect(renderer, &rect);
+        }
+    }
+    SDL_SetRenderDrawColorFloat(renderer, 0.3f, 0.3f, 0.3f, 1.0f);
+    SDL_RenderFillRects(renderer, rects, (int)rectsCount);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+}
+
+#define PCT_KDTREE_OVERLAY_ALPHA 0.35f
+#define PCT_KDTREE_PROFILE_WINDOW_MS 1000
+
+void PCT_DrawKdTreeNode(const PCT_KdTree *node, const PCT_KdTreeProfile *profile,
+                        const PCT_AaBb *view, SDL_Renderer *renderer, mat4 vp) {
+    if (node == NULL || !PCT_AaBbCollisionTest(view, &node->bounds, NULL)) {
+        return;
+    }
+    SDL_FRect bounds = PCT_BoxToScreen(&node->bounds, vp);
+    if (node->axis == PCT_KDTREE_AXIS_NONE) {
+        uint32_t heat = PCT_KdTreeLeafHeat(node);
+        if (heat > 0 && profile->maxHeat > 0) {
+            // Log scale keeps rarely scanned leaves visible next to the ones under the player.
+            float t = logf(1.0f + (float)heat) / logf(1.0f + (float)profile->maxHeat);
+            SDL_SetRenderDrawColorFloat(renderer, t, 0.2f, 1.0f - t, PCT_KDTREE_OVERLAY_ALPHA);
+            SDL_RenderFillRect(renderer, &bounds);
         }
+        SDL_SetRenderDrawColorFloat(renderer, 0.9f, 0.9f, 0.3f, 0.6f);
+        SDL_RenderRect(renderer, &bounds);
+        return;
     }
-    free(boxes);
+
+    float boundary = node->data.node.boundary;
+    PCT_AaBb plane = node->axis == PCT_KDTREE_AXIS_X
+                         ? (PCT_AaBb){boundary, node->bounds.y1, boundary, node->bounds.y2}
+                         : (PCT_AaBb){node->bounds.x1, boundary, node->bounds.x2, boundary};
+    SDL_FRect line = PCT_BoxToScreen(&plane, vp);
+    SDL_SetRenderDrawColorFloat(renderer, 0.3f, 0.9f, 0.9f, 0.8f);
+    SDL_RenderLine(renderer, line.x, line.y, line.x + line.w, line.y + line.h);
+    PCT_DrawKdTreeNode(node->data.node.nodes[0], profile, view, renderer, vp);
+    PCT_DrawKdTreeNode(node->data.node.nodes[1], profile, view, renderer, vp);
+}
+
+/**
+ * @brief Draws split planes and leaf bounds of tree on top of the map. Leaves are filled by how
+ * many queries scanned them in the last closed profile window, from blue for few to red for most.
+ * Heat stays empty unless built with PCT_KDTREE_PROFILE.
+ */
+void PCT_DrawKdTreeOverlay(const PCT_KdTree *tree, const PCT_KdTreeProfile *profile,
+                           SDL_Renderer *renderer, mat4 vp) {
+    PCT_AaBb view;
+    float pixelSize;
+    PCT_ViewRectFromVp(vp, &view, &pixelSize);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    PCT_DrawKdTreeNode(tree, profile, &view, renderer, vp);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+}
+
+#define PCT_LATENCY_OVERLAY_BAR 8.0f
+#define PCT_LATENCY_OVERLAY_HEIGHT 120.0f
+#define PCT_LATENCY_OVERLAY_STRIP 16.0f
+
+/**
+ * @brief Draws histogram of input to present latency over the last PCT_LATENCY_FRAMES frames in
+ * the bottom left corner, one bar per millisecond. Bars within one refresh are green, within two
+ * yellow and slower ones red. The strip below shows the same frames oldest first, missed
+ * refreshes in red.
+ */
+void PCT_DrawLatencyOverlay(const PCT_FramePacer *pacer, SDL_Renderer *renderer) {
+    float width = PCT_LATENCY_BUCKETS * PCT_LATENCY_OVERLAY_BAR;
+    float left = 16.0f;
+    float bottom = (float)SCREEN_HEIGHT - 16.0f - PCT_LATENCY_OVERLAY_STRIP - 4.0f;
+    uint32_t highest = 1;
+    for (size_t i = 0; i < PCT_LATENCY_BUCKETS; i++) {
+        highest = SDL_max(highest, pacer->buckets[i]);
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColorFloat(renderer, 0.0f, 0.0f, 0.0f, 0.6f);
+    SDL_FRect panel = {left - 4.0f, bottom - PCT_LATENCY_OVERLAY_HEIGHT - 4.0f, width + 8.0f,
+                       PCT_LATENCY_OVERLAY_HEIGHT + PCT_LATENCY_OVERLAY_STRIP + 12.0f};
+    SDL_RenderFillRect(renderer, &panel);
+    for (size_t i = 0; i < PCT_LATENCY_BUCKETS; i++) {
+        if (pacer->buckets[i] == 0) {
+            continue;
+        }
+        Uint64 endNs = (i + 1) * PCT_LATENCY_BUCKET_NS;
+        if (endNs <= pacer->periodNs) {
+            SDL_SetRenderDrawColorFloat(renderer, 0.3f, 0.8f, 0.3f, 1.0f);
+        } else if (endNs <= 2 * pacer->periodNs) {
+            SDL_SetRenderDrawColorFloat(renderer, 0.9f, 0.8f, 0.2f, 1.0f);
+        } else {
+            SDL_SetRenderDrawColorFloat(renderer, 0.9f, 0.2f, 0.2f, 1.0f);
+        }
+        float height = PCT_LATENCY_OVERLAY_HEIGHT * (float)pacer->buckets[i] / (float)highest;
+        SDL_FRect bar = {left + (float)i * PCT_LATENCY_OVERLAY_BAR, bottom - height,
+                         PCT_LATENCY_OVERLAY_BAR - 1.0f, height};
+        SDL_RenderFillRect(renderer, &bar);
+    }
+    // Refresh period marker.
+    float period = left + PCT_LATENCY_OVERLAY_BAR * (float)pacer->periodNs / PCT_LATENCY_BUCKET_NS;
+    SDL_SetRenderDrawColorFloat(renderer, 1.0f, 1.0f, 1.0f, 0.8f);
+    SDL_RenderLine(renderer, period, bottom - PCT_LATENCY_OVERLAY_HEIGHT, period, bottom);
+
+    float column = width / PCT_LATENCY_FRAMES;
+    size_t recent = (size_t)SDL_min(pacer->frameCount, (uint64_t)PCT_LATENCY_FRAMES);
+    for (size_t i = 0; i < recent; i++) {
+        bool missed;
+        PCT_FramePacerRecentBucket(pacer, i, &missed);
+        if (missed) {
+            SDL_SetRenderDrawColorFloat(renderer, 0.9f, 0.2f, 0.2f, 1.0f);
+        } else {
+            SDL_SetRenderDrawColorFloat(renderer, 0.2f, 0.4f, 0.2f, 1.0f);
+        }
+        SDL_FRect frame = {left + (float)i * column, bottom + 4.0f, column,
+                           PCT_LATENCY_OVERLAY_STRIP};
+        SDL_RenderFillRect(renderer, &frame);
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
 }
 
 #define PCT_DEAD_ZONE 4096
@@ -69,256 +234,396 @@ float PCT_GetAnalogInput(const Sint16 rawValue) {
     }
 }
 
-#define PCT_RUN_SPEED 1.0f
-#define PCT_JUMP_HEIGHT_MAX 0.45f
-#define PCT_JUMP_HEIGHT_MIN 0.1f
-#define PCT_TERMINAL_VELOCITY 0.7f
-#define PCT_JUMP_DISTANCE 0.4f
-#define PCT_SMALL_JUMP_DISTANCE 0.1f
+typedef struct {
+    uint16_t idle;
+    uint16_t running;
+    uint16_t jumpingUp;
+    uint16_t jumpingTop;
+    uint16_t jumpingDown;
+} PCT_PlayerClips;
 
-typedef enum {
-    PCT_PLAYER_STATE_IDLE,
-    PCT_PLAYER_STATE_RUNNING,
-    PCT_PLAYER_STATE_JUMPING_UP,
-    PCT_PLAYER_STATE_JUMPING_TOP,
-    PCT_PLAYER_STATE_JUMPING_DOWN
-} PCT_PlayerState;
+/**
+ * @brief Reads clips returned by the precompiled animations script. Falls back to the walk sheet
+ * layout when the script does not define player_idle, missing jump clips fall back to idle.
+ */
+PCT_PlayerClips PCT_LoadPlayerClips(PCT_LuaScriptingContext *luaCtx,
+                                    PCT_AnimationLibrary *animations, PCT_AssetManager *assets,
+                                    PCT_AssetHandle script) {
+    Sint32 top = lua_gettop(luaCtx->L);
+    Sint32 status = PCT_RunScript(assets, script, luaCtx->L);
+    if (status == LUA_OK && lua_gettop(luaCtx->L) > top) {
+        PCT_ReadAnimationClips(luaCtx->L, top + 1, animations, "robots/animations.lua");
+    } else if (status != LUA_OK && status != LUA_ERRFILE) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", lua_tostring(luaCtx->L, -1));
+    }
+    lua_settop(luaCtx->L, top);
+    if (PCT_FindAnimationClip(animations, "player_idle") == PCT_ANIMATION_NO_CLIP) {
+        PCT_AnimationFrame idle = {.x = 0, .y = 0, .w = 32, .h = 32, .durationMs = 64};
+        PCT_AnimationFrame running[6];
+        for (int32_t i = 0; i < 6; i++) {
+            running[i] = (PCT_AnimationFrame){
+                .x = 32 * (i % 3), .y = 32 * (i / 3), .w = 32, .h = 32, .durationMs = 64};
+        }
+        PCT_AddAnimationClip(animations, "player_idle", &idle, 1, true);
+        PCT_AddAnimationClip(animations, "player_run", running, 6, true);
+    }
+    PCT_PlayerClips clips = {.idle = PCT_FindAnimationClip(animations, "player_idle")};
+    const char *names[] = {"player_run", "player_jump_up", "player_jump_top", "player_jump_down"};
+    uint16_t *targets[] = {&clips.running, &clips.jumpingUp, &clips.jumpingTop,
+                           &clips.jumpingDown};
+    for (size_t i = 0; i < 4; i++) {
+        uint16_t clip = PCT_FindAnimationClip(animations, names[i]);
+        *targets[i] = clip != PCT_ANIMATION_NO_CLIP ? clip : clips.idle;
+    }
+    return clips;
+}
 
-typedef struct {
-    float locationX;
-    float locationY;
-    float velocityY;
-    Sint8 direction;
-    PCT_PlayerState currentState;
-    float spriteX;
-    float spriteY;
-    bool isOnGround;
-    bool isJumping;
-    bool isAttacking;
-} PCT_Player;
-
-void PCT_UpdatePlayerAnimation(PCT_Player *player, Sint64 deltaTimeMs) {
-    static Sint64 deltaTimeAccumulator = 0;
-    static Sint8 frameCounter = 0;
-    static Sint8 row = 0;
+uint16_t PCT_PlayerClip(const PCT_Player *player, const PCT_PlayerClips *clips) {
     switch (player->currentState) {
-    case PCT_PLAYER_STATE_IDLE:
-        player->spriteX = 0;
-        player->spriteY = 0;
-        deltaTimeAccumulator = 0;
-        break;
     case PCT_PLAYER_STATE_RUNNING:
-        if (deltaTimeAccumulator >= 64) {
-            deltaTimeAccumulator = 0;
-            frameCounter = (frameCounter + 1) % 3;
-            if (frameCounter == 0) {
-                row = (row + 1) % 2;
-            }
-            player->spriteX = 32.0 * frameCounter;
-            player->spriteY = 32.0 * row;
-        } else {
-            deltaTimeAccumulator += deltaTimeMs;
-        }
+        return clips->running;
     case PCT_PLAYER_STATE_JUMPING_UP:
+        return clips->jumpingUp;
     case PCT_PLAYER_STATE_JUMPING_TOP:
+        return clips->jumpingTop;
     case PCT_PLAYER_STATE_JUMPING_DOWN:
-        break;
+        return clips->jumpingDown;
+    case PCT_PLAYER_STATE_IDLE:
+    default:
+        return clips->idle;
     }
 }
 
-void PCT_PlayerAttack(PCT_Player *player, PCT_Entity *enemies, float deltaTimeS,
-                      SDL_Renderer *renderer, mat4 vp, uint8_t attack) {
-    static int64_t attackStartTime = 0;
-    static bool attackInProggress = false;
-    if(!player->isAttacking && attack && !attackInProggress){
-        attackStartTime = SDL_GetTicks();
-        player->isAttacking = true;
-        attackInProggress = true;
+/**
+ * @brief Places player sprite into batch, its source rect is written by the animator pass.
+ */
+void PCT_BatchPlayer(const PCT_Player *player, PCT_SpriteBatch *batch, size_t sprite, mat4 vp) {
+    vec3 pointA = {0}, pointB = {0};
+    glm_project((vec3){player->locationX, player->locationY, 0.0f}, vp,
+                (vec4){0.0f, 0.0f, (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT}, pointA);
+    glm_project((vec3){player->locationX + 0.1f, player->locationY + 0.1f, 0.0f}, vp,
+                (vec4){0.0f, 0.0f, (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT}, pointB);
+    batch->destinations[sprite] =
+        (SDL_FRect){pointA[0], pointB[1], pointB[0] - pointA[0], pointA[1] - pointB[1]};
+    batch->flipped[sprite] = player->direction < 0;
+}
+
+void PCT_DrawPlayerAttack(const PCT_SimState *state, SDL_Renderer *renderer, mat4 vp) {
+    if (!state->attack.inProgress) {
+        return;
     }
+    SDL_SetRenderDrawColorFloat(renderer, 0.8, 0.2, 0.2, 1.0);
+    PCT_AaBb attackBox = PCT_PlayerAttackBox(&state->player);
+    SDL_FRect attackRect = PCT_BoxToScreen(&attackBox, vp);
+    SDL_RenderRect(renderer, &attackRect);
+}
 
-    if(attackInProggress) {
-        SDL_SetRenderDrawColorFloat(renderer, 0.8, 0.2, 0.2, 1.0);
-        PCT_AaBb attackBox = {0.0f, 0.0f, 0.1f, 0.1f};
-        attackBox = PCT_MoveBox(&attackBox, &(PCT_Vector){.x = -0.05f + player->locationX + 0.05f + player->direction * 0.1f, .y = player->locationY});
-        SDL_FRect attackRect = PCT_BoxToScreen(&attackBox, vp);
-        SDL_RenderRect(renderer, &attackRect);
+void PCT_DrawEnemy(const PCT_Entity *enemy, SDL_Renderer *renderer, mat4 vp) {
+    if(enemy->health <= 0) {
+        return;
+    }
+    SDL_SetRenderDrawColorFloat(renderer, 0.8f, 0.4f, 0.4f, 1.0f);
+    PCT_AaBb visual = PCT_MoveBox(&enemy->box, (PCT_Vector *)&enemy->location);
+    SDL_FRect box = PCT_BoxToScreen(&visual, vp);
+    SDL_RenderFillRect(renderer, &box);
+}
 
-        for(size_t i = 0; i < 2; i++){
-            PCT_AaBb enemyBox = PCT_MoveBox(&enemies[i].box, (PCT_Vector *)&enemies[i].location);
-            bool collided = PCT_AaBbCollisionTest(&attackBox, &enemyBox, NULL);
-            if(collided) {
-                enemies[i].health -= 5.0f;
+typedef struct {
+    size_t sparks;
+    size_t dust;
+    size_t debris;
+} PCT_EffectEmitters;
+
+PCT_EffectEmitters PCT_AddEffectEmitters(PCT_ParticleSystem *particles) {
+    PCT_ParticleEmitterDesc sparks = {.capacity = 4096,
+                                      .angle = 0.3f,
+                                      .spread = 1.4f,
+                                      .speedMin = 0.6f,
+                                      .speedMax = 1.6f,
+                                      .lifetimeMin = 0.15f,
+                                      .lifetimeMax = 0.35f,
+                                      .gravityScale = 0.3f,
+                                      .drag = 4.0f,
+                                      .size = 0.008f,
+                                      .color = {1.0f, 0.85f, 0.4f, 1.0f}};
+    PCT_ParticleEmitterDesc dust = {.capacity = 4096,
+                                    .angle = GLM_PI_2f,
+                                    .spread = GLM_PIf,
+                                    .speedMin = 0.05f,
+                                    .speedMax = 0.25f,
+                                    .lifetimeMin = 0.3f,
+                                    .lifetimeMax = 0.6f,
+                                    .gravityScale = -0.02f,
+                                    .drag = 3.0f,
+                                    .size = 0.012f,
+                                    .color = {0.7f, 0.65f, 0.6f, 0.5f}};
+    PCT_ParticleEmitterDesc debris = {.capacity = 8192,
+                                      .angle = GLM_PI_2f,
+                                      .spread = 2.4f,
+                                      .speedMin = 0.4f,
+                                      .speedMax = 1.2f,
+                                      .lifetimeMin = 1.0f,
+                                      .lifetimeMax = 2.0f,
+                                      .gravityScale = 1.0f,
+                                      .drag = 0.2f,
+                                      .size = 0.012f,
+                                      .color = {0.8f, 0.4f, 0.4f, 1.0f},
+                                      .collide = true,
+                                      .bounce = 0.4f};
+    return (PCT_EffectEmitters){.sparks = PCT_AddParticleEmitter(particles, &sparks),
+                                .dust = PCT_AddParticleEmitter(particles, &dust),
+                                .debris = PCT_AddParticleEmitter(particles, &debris)};
+}
+
+/**
+ * @brief Spawns effects for what changed since the previously drawn state. Particles are
+ * cosmetic, so they are derived from state on the render side instead of being simulated and
+ * rolled back.
+ * @param previousHealth enemy health in the previous state, updated to the current one
+ * @param wasOnGround whether player stood on ground in the previous state, updated as well
+ */
+void PCT_EmitTickEffects(PCT_ParticleSystem *particles, const PCT_EffectEmitters *emitters,
+                         const PCT_SimState *state, float *previousHealth, bool *wasOnGround) {
+    const PCT_Player *player = &state->player;
+    for (size_t i = 0; i < state->enemyCount; i++) {
+        const PCT_Entity *enemy = state->enemies + i;
+        if (enemy->health < previousHealth[i]) {
+            PCT_Point center = {enemy->location.x + (enemy->box.x1 + enemy->box.x2) / 2,
+                                enemy->location.y + (enemy->box.y1 + enemy->box.y2) / 2};
+            PCT_EmitParticles(particles, emitters->sparks, &center, player->direction, 48);
+            if (enemy->health <= 0.0f && previousHealth[i] > 0.0f) {
+                PCT_EmitParticles(particles, emitters->debris, &center, player->direction, 256);
             }
         }
-
+        previousHealth[i] = enemy->health;
+    }
+    if (player->isOnGround && !*wasOnGround) {
+        PCT_Point feet = {player->locationX + 0.05f, player->locationY};
+        PCT_EmitParticles(particles, emitters->dust, &feet, 1.0f, 24);
     }
+    *wasOnGround = player->isOnGround;
+}
 
-    if(attackStartTime + 200 < SDL_GetTicks()) {
-        attackInProggress = false;
-    } 
+#ifndef PCT_SIM_TICK_MS
+#define PCT_SIM_TICK_MS 8
+#endif
+// Ticks the simulation may fall behind before it skips ahead instead of catching up.
+#define PCT_SIM_MAX_LAG_TICKS 4
+
+/**
+ * @brief Simulation running on its own thread. Input is written by the main thread packed into a
+ * single atomic followed by the microsecond it was sampled at, frames go back through the snapshot
+ * buffer. In low latency mode no thread is
+ * started and the main thread steps it right after sampling input instead.
+ */
+typedef struct {
+    PCT_World *world;
+    PCT_FrameSnapshotBuffer *snapshots;
+    float cameraX;
+    float cameraY;
+    SDL_AtomicInt input;
+    // Low 32 bits of the SDL_GetTicksNS microsecond input was sampled at.
+    SDL_AtomicInt inputUs;
+    SDL_AtomicInt running;
+    SDL_Thread *thread;
+} PCT_SimThread;
+
+Sint32 PCT_PackInput(const float moveX, const bool jump, const bool attack) {
+    Sint32 move = (Sint32)lroundf(SDL_clamp(moveX, -1.0f, 1.0f) * SDL_MAX_SINT16);
+    return (move & 0xFFFF) | (jump ? 0x10000 : 0) | (attack ? 0x20000 : 0);
 }
 
-float PCT_PlayerJump(PCT_Player *player, bool jump, float deltaTimeS) {
-    float gravity = (-2.0f * PCT_JUMP_HEIGHT_MAX * PCT_RUN_SPEED * PCT_RUN_SPEED) /
-                    (PCT_JUMP_DISTANCE * PCT_JUMP_DISTANCE);
+void PCT_UnpackInput(const Sint32 packed, PCT_TickInput *input) {
+    input->moveX = (float)(Sint16)(packed & 0xFFFF) / SDL_MAX_SINT16;
+    input->jump = (packed & 0x10000) != 0;
+    input->attack = (packed & 0x20000) != 0;
+}
 
-    if ((jump && !player->isJumping) && (player->isOnGround || player->velocityY < 0)) {
-        player->velocityY = (2.0 * PCT_JUMP_HEIGHT_MAX * PCT_RUN_SPEED) / PCT_JUMP_DISTANCE;
-        player->locationY +=
-            (player->velocityY * deltaTimeS) + ((gravity / 2) * deltaTimeS * deltaTimeS);
-        // 1/2 * (G0 + G1) * dT
-        player->isOnGround = false;
-        player->isJumping = true;
-    }
+/**
+ * @brief Hands input sampled at sampleNs to the simulation thread.
+ */
+void PCT_SetSimInput(PCT_SimThread *sim, const float moveX, const bool jump, const bool attack,
+                     const Uint64 sampleNs) {
+    SDL_AtomicSet(&sim->input, PCT_PackInput(moveX, jump, attack));
+    // Written after the input, so a tick that sees this time sees this input or a newer one and
+    // latency can only come out long, never short.
+    SDL_AtomicSet(&sim->inputUs, (int)(Uint32)(sampleNs / 1000));
+}
 
-    if (player->velocityY > 0 && !jump) {
-        return (-2.0f * PCT_JUMP_HEIGHT_MIN * PCT_RUN_SPEED * PCT_RUN_SPEED) /
-               (PCT_SMALL_JUMP_DISTANCE * PCT_SMALL_JUMP_DISTANCE);
-    }
+/**
+ * @brief Reads input handed over by PCT_SetSimInput at nowNs.
+ * @return SDL_GetTicksNS time the input was sampled at
+ */
+Uint64 PCT_GetSimInput(PCT_SimThread *sim, const Uint64 nowNs, PCT_TickInput *input) {
+    Uint32 inputUs = (Uint32)SDL_AtomicGet(&sim->inputUs);
+    PCT_UnpackInput(SDL_AtomicGet(&sim->input), input);
+    // Wrapping difference, samples are never anywhere near 35 minutes old. Input sampled after
+    // nowNs was read counts as sampled at nowNs.
+    Sint32 ageUs = (Sint32)((Uint32)(nowNs / 1000) - inputUs);
+    return nowNs - (Uint64)SDL_max(ageUs, 0) * 1000;
+}
 
-    return gravity;
+/**
+ * @brief Copies world state into snapshot together with the camera and the map boxes it sees.
+ */
+void PCT_FillFrameSnapshot(PCT_FrameSnapshot *snapshot, const PCT_World *world,
+                           const float cameraX, const float cameraY) {
+    memcpy(snapshot->state, world->state, PCT_SimStateSize(world->state));
+    snapshot->cameraX = cameraX;
+    snapshot->cameraY = cameraY;
+    mat4 vp;
+    PCT_CameraVp(cameraX, cameraY, vp);
+    PCT_QueryMapBoxes(world->map->tree, snapshot, vp);
 }
 
-void PCT_UpdatePlayer(PCT_Player *player, float controllerX, Uint8 jump, Uint8 attack,
-                      Sint64 deltaTimeMs, const PCT_KdTree *tree) {
-    float deltaTimeS = deltaTimeMs / 1000.0f;
-    float gravity = PCT_PlayerJump(player, jump > 0, deltaTimeS);
+/**
+ * @brief Ticks world and publishes a snapshot of it. The camera follows the player here so
+ * snapshots need no further work.
+ * @param inputNs SDL_GetTicksNS time input was sampled at
+ */
+void PCT_StepSim(PCT_SimThread *sim, const PCT_TickInput *input, const Uint64 inputNs) {
+    Uint64 startNs = SDL_GetTicksNS();
+    PCT_World *world = sim->world;
+    PCT_WorldTick(world, input);
 
-    if (controllerX == 0) {
-        player->currentState = PCT_PLAYER_STATE_IDLE;
-    } else {
-        player->currentState = PCT_PLAYER_STATE_RUNNING;
-    }
-
-    float nextLocationX = player->locationX;
-    float nextLocationY = player->locationY;
-    float nextVelocityY = player->velocityY;
-    if (controllerX != 0) {
-        player->direction = controllerX > 0 ? 1 : -1;
-        float position = player->locationX + (controllerX * deltaTimeS * PCT_RUN_SPEED);
-        nextLocationX = position;
-    }
-
-    nextVelocityY +=
-        SDL_clamp(gravity * deltaTimeS, -PCT_TERMINAL_VELOCITY, 100.0f); // 1/2 * (G0 + G1) * dT
-    nextLocationY += (player->velocityY * deltaTimeS) + ((gravity / 2) * deltaTimeS * deltaTimeS);
-    size_t collisionRectsCount;
-    PCT_AaBb playerBox = {.x1 = player->locationX - 0.01f,
-                          .y1 = player->locationY - 0.01f,
-                          .x2 = player->locationX + 0.11f,
-                          .y2 = player->locationY + 0.11f};
-    PCT_AaBb **rects = PCT_KdTreeRangeSearch(tree, &playerBox, &collisionRectsCount);
-    for (size_t i = 0; i < collisionRectsCount; i++) {
-        PCT_Collision collisionInfo = {0};
-        bool collides = PCT_AaBbCollisionTest(&(PCT_AaBb){.x1 = nextLocationX,
-                                                          .y1 = nextLocationY,
-                                                          .x2 = nextLocationX + 0.1f,
-                                                          .y2 = nextLocationY + 0.1f},
-                                              rects[i], &collisionInfo);
-        if (collides) {
-            if (collisionInfo.normal[0] != 0.0f) {
-                nextLocationX += collisionInfo.normal[0] * collisionInfo.distance;
-            } else {
-                nextLocationY += collisionInfo.normal[1] * collisionInfo.distance;
-                if (collisionInfo.normal[1] > 0) {
-                    player->isOnGround = true;
-                    nextVelocityY = 0.0f;
-                } else {
-                    nextVelocityY = glm_min(player->velocityY, -0.01f);
-                }
-            }
+    const PCT_Player *player = &world->state->player;
+    float deltaTimeS = input->deltaTimeMs / 1000.0f;
+    float cameraTargetX = (player->locationX + 0.05f) + ((float)player->direction) * 0.05f;
+    float cameraTargetY = player->locationY + 0.05f;
+    sim->cameraX = glm_lerpc(sim->cameraX, cameraTargetX, 10.0f * deltaTimeS);
+    sim->cameraY = SDL_clamp(glm_lerpc(sim->cameraY, cameraTargetY, 10.0f * deltaTimeS),
+                             player->locationY - 1, player->locationY + 1);
+
+    PCT_FrameSnapshot *snapshot = PCT_FrameSnapshotWriting(sim->snapshots);
+    PCT_FillFrameSnapshot(snapshot, world, sim->cameraX, sim->cameraY);
+    snapshot->inputNs = inputNs;
+    snapshot->simNs = SDL_GetTicksNS() - startNs;
+    PCT_PublishFrameSnapshot(sim->snapshots);
+}
+
+/*
+ * Ticks at a fixed rate and publishes a snapshot after every tick, it never waits on the
+ * renderer or the GPU.
+ */
+static int PCT_SimThreadMain(void *data) {
+    PCT_SimThread *sim = data;
+    const Uint64 tickNs = SDL_MS_TO_NS(PCT_SIM_TICK_MS);
+    Uint64 nextTickNs = SDL_GetTicksNS();
+    while (SDL_AtomicGet(&sim->running)) {
+        Uint64 startNs = SDL_GetTicksNS();
+        if (startNs < nextTickNs) {
+            SDL_DelayNS(nextTickNs - startNs);
+            continue;
         }
+        if (startNs - nextTickNs > tickNs * PCT_SIM_MAX_LAG_TICKS) {
+            nextTickNs = startNs;
+        }
+        nextTickNs += tickNs;
+
+        PCT_TickInput input = {.deltaTimeMs = PCT_SIM_TICK_MS};
+        Uint64 inputNs = PCT_GetSimInput(sim, startNs, &input);
+        PCT_StepSim(sim, &input, inputNs);
     }
-    free(rects);
+    return 0;
+}
 
-    player->locationY = nextLocationY;
-    player->velocityY = nextVelocityY;
-    player->locationX = nextLocationX;
+void PCT_InitSim(PCT_SimThread *sim, PCT_World *world, PCT_FrameSnapshotBuffer *snapshots) {
+    *sim = (PCT_SimThread){.world = world, .snapshots = snapshots};
+    PCT_SetSimInput(sim, 0.0f, false, false, SDL_GetTicksNS());
 }
 
-void PCT_DrawPlayer(PCT_Player *player, SDL_Texture *texture, SDL_Renderer *renderer, mat4 vp) {
-    vec3 pointA = {0}, pointB = {0};
-    glm_project((vec3){player->locationX, player->locationY, 0.0f}, vp,
-                (vec4){0.0f, 0.0f, (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT}, pointA);
-    glm_project((vec3){player->locationX + 0.1f, player->locationY + 0.1f, 0.0f}, vp,
-                (vec4){0.0f, 0.0f, (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT}, pointB);
-    SDL_FlipMode direction = player->direction >= 0 ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL;
-    SDL_RenderTextureRotated(
-        renderer, texture, &(SDL_FRect){player->spriteX, player->spriteY, 32.0, 32.0},
-        &(SDL_FRect){pointA[0], pointB[1], pointB[0] - pointA[0], pointA[1] - pointB[1]}, 0.0, NULL,
-        direction);
+/**
+ * @brief Starts ticking world on a new thread. World must not be touched by anyone else until
+ * PCT_StopSimThread returns.
+ */
+void PCT_StartSimThread(PCT_SimThread *sim) {
+    SDL_AtomicSet(&sim->running, 1);
+    sim->thread = SDL_CreateThread(PCT_SimThreadMain, "PCT_Simulation", sim);
+    if (sim->thread == NULL) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to create simulation thread: %s",
+                     SDL_GetError());
+        exit(0);
+    }
 }
 
-void PCT_DrawEnemy(PCT_Entity *enemy, SDL_Renderer *renderer, mat4 vp) {
-    if(enemy->health <= 0) {
+void PCT_StopSimThread(PCT_SimThread *sim) {
+    if (sim->thread == NULL) {
         return;
     }
-    SDL_SetRenderDrawColorFloat(renderer, 0.8f, 0.4f, 0.4f, 1.0f);
-    PCT_AaBb visual = PCT_MoveBox(&enemy->box, (PCT_Vector *)&enemy->location);
-    SDL_FRect box = PCT_BoxToScreen(&visual, vp);
-    SDL_RenderFillRect(renderer, &box);
+    SDL_AtomicSet(&sim->running, 0);
+    SDL_WaitThread(sim->thread, NULL);
+    sim->thread = NULL;
 }
 
-bool PCT_PointInBoxTop(const PCT_AaBb *box, const PCT_Point *point) {
-    return point->x > box->x1 && point->x < box->x2 && point->y <= box->y2;
-}
-
-void PCT_UpdateEnemy(PCT_Entity *enemy, Sint64 deltaTimeMs, const PCT_KdTree *tree) {
-    float deltaTimeS = deltaTimeMs / 1000.0f;
-    float gravity = (-2.0f * PCT_JUMP_HEIGHT_MAX * PCT_RUN_SPEED * PCT_RUN_SPEED) /
-                    (PCT_JUMP_DISTANCE * PCT_JUMP_DISTANCE);
-    float nextLocationX = enemy->location.x + ((enemy->direction) * 0.35f * deltaTimeS);
-    float nextLocationY = enemy->location.y;
-    float nextVelocityY = enemy->velocity.y;
-    nextVelocityY +=
-        SDL_clamp(gravity * deltaTimeS, -PCT_TERMINAL_VELOCITY, 100.0f); // 1/2 * (G0 + G1) * dT
-    nextLocationY += ((enemy->velocity.y) * deltaTimeS) + ((gravity / 2) * deltaTimeS * deltaTimeS);
-    size_t collisionRectsCount;
-    PCT_Vector nextLocation = {.x = nextLocationX, .y = nextLocationY};
-    PCT_AaBb collisionBox = PCT_MoveBox(&enemy->box, &nextLocation);
-    PCT_AaBb searchBox = {.x1 = collisionBox.x1 - 0.01f,
-                          .y1 = collisionBox.y1 - 0.05f,
-                          .x2 = collisionBox.x2 + 0.01f,
-                          .y2 = collisionBox.y2 + 0.05f};
-    PCT_AaBb **rects = PCT_KdTreeRangeSearch(tree, &searchBox, &collisionRectsCount);
-    bool collides = false;
-    bool isOnGround = false;
-    bool leftEdgeOnGround = false;
-    bool rightEdgeOnGround = false;
-    for (size_t i = 0; i < collisionRectsCount; i++) {
-        PCT_Collision collisionInfo = {0};
-        collides = PCT_AaBbCollisionTest(&collisionBox, rects[i], &collisionInfo);
-        if (collides) {
-            if (collisionInfo.normal[0] != 0) {
-                enemy->direction += 2.0f * collisionInfo.normal[0];
-            }
-            nextLocationX += collisionInfo.normal[0] * collisionInfo.distance;
-            nextLocationY += collisionInfo.normal[1] * collisionInfo.distance;
-            if (collisionInfo.normal[1] > 0) {
-                nextVelocityY = 0.0f;
-            } else {
-                nextVelocityY = glm_min(enemy->velocity.y, -0.01f);
-            }
-        }
-        PCT_Point left = {collisionBox.x1, collisionBox.y1 - 0.1f};
-        PCT_Point right = {collisionBox.x2, collisionBox.y1 - 0.1f};
-        leftEdgeOnGround |= PCT_PointInBoxTop(rects[i], &left);
-        rightEdgeOnGround |= PCT_PointInBoxTop(rects[i], &right);
+/**
+ * @brief Keeps count particles alive over the map for frames frames and prints the CPU time of
+ * the update and of building their geometry.
+ */
+void PCT_RunParticleBenchmark(const char *mapName, size_t count, size_t frames) {
+    size_t pointsRead = 0, rectCount = 0;
+    vec2 *mapPoints = PCT_ReadMapRaw(mapName, &pointsRead);
+    PCT_AaBb *mapRects = PCT_ParseMapRects(mapPoints, pointsRead, &rectCount);
+    free(mapPoints);
+    PCT_OccupancyGrid *occupancy =
+        PCT_BuildOccupancyGrid(mapRects, rectCount, PCT_OCCUPANCY_CELL_SIZE);
+    PCT_AaBb bounds = mapRects[0];
+    for (size_t i = 0; i < rectCount; i++) {
+        bounds = (PCT_AaBb){fminf(bounds.x1, mapRects[i].x1), fminf(bounds.y1, mapRects[i].y1),
+                            fmaxf(bounds.x2, mapRects[i].x2), fmaxf(bounds.y2, mapRects[i].y2)};
     }
-    free(rects);
+    free(mapRects);
 
-    enemy->location.x = nextLocationX;
-    enemy->location.y = nextLocationY;
-    enemy->velocity.y = nextVelocityY;
-
-    if (!leftEdgeOnGround) {
-        enemy->direction = 1.0f;
-    } else if (!rightEdgeOnGround) {
-        enemy->direction = -1.0f;
+    PCT_ParticleSystem *particles = PCT_CreateParticleSystem(occupancy, 1);
+    PCT_ParticleEmitterDesc desc = {.capacity = count,
+                                    .angle = GLM_PI_2f,
+                                    .spread = GLM_PIf * 2.0f,
+                                    .speedMin = 0.2f,
+                                    .speedMax = 1.0f,
+                                    .lifetimeMin = 1.0f,
+                                    .lifetimeMax = 3.0f,
+                                    .gravityScale = 1.0f,
+                                    .drag = 0.2f,
+                                    .size = 0.01f,
+                                    .color = {1.0f, 1.0f, 1.0f, 1.0f},
+                                    .collide = true,
+                                    .bounce = 0.4f};
+    size_t emitter = PCT_AddParticleEmitter(particles, &desc);
+    srand(1);
+    Uint64 updateTime = 0, geometryTime = 0;
+    size_t quads = 0;
+    for (size_t frame = 0; frame < frames; frame++) {
+        // Bursts of 64 refill what died, like many hits and landings would.
+        while (particles->emitters[emitter].count < count) {
+            PCT_Point origin = {
+                bounds.x1 + (bounds.x2 - bounds.x1) * ((float)rand() / (float)RAND_MAX),
+                bounds.y1 + (bounds.y2 - bounds.y1) * ((float)rand() / (float)RAND_MAX)};
+            if (PCT_OccupancyAtPoint(occupancy, &origin) == PCT_OCCUPANCY_EMPTY) {
+                PCT_EmitParticles(particles, emitter, &origin, 1.0f, 64);
+            }
+        }
+        Uint64 start = SDL_GetPerformanceCounter();
+        PCT_UpdateParticles(particles, 0.016f);
+        Uint64 updated = SDL_GetPerformanceCounter();
+        quads += PCT_BuildParticleGeometry(particles, &bounds, (float)SCREEN_WIDTH,
+                                           (float)SCREEN_HEIGHT);
+        geometryTime += SDL_GetPerformanceCounter() - updated;
+        updateTime += updated - start;
     }
+    double msPerFrame = 1e3 / (double)SDL_GetPerformanceFrequency() / (double)frames;
+    printf("particles: %zu live%s, update %.3f ms, geometry %.3f ms per frame, %zu quads\n",
+           count,
+#if defined(PCT_PARTICLES_SSE)
+           " (SSE)",
+#else
+           "",
+#endif
+           (double)updateTime * msPerFrame, (double)geometryTime * msPerFrame,
+           frames > 0 ? quads / frames : 0);
+    PCT_DestroyParticleSystem(particles);
+    PCT_DestroyOccupancyGrid(occupancy);
 }
 
-Sint32 main(Sint32 argc, char **argv) {
+void PCT_SpawnEnemies(PCT_SimState *state) {
     PCT_Entity enemies[2];
     enemies[0] = (PCT_Entity){.location = {.x = 1.0f, .y = 0.01f},
                               .box = {.x1 = 0, .y1 = 0, .x2 = 0.15f, .y2 = 0.1f},
@@ -332,6 +637,453 @@ Sint32 main(Sint32 argc, char **argv) {
                               .idx = 1,
                               .health = 10.0f,
                               .direction = -1.0f};
+    for (size_t i = 0; i < 2; i++) {
+        PCT_SimAddEnemy(state, enemies + i);
+    }
+}
+
+/**
+ * @brief Ticks instanceCount bot driven worlds sharing one map for ticks fixed ticks on a thread
+ * pool and prints the achieved throughput.
+ */
+void PCT_RunHeadless(PCT_MapCache *mapCache, size_t instanceCount, size_t ticks,
+                     size_t threadCount) {
+    const int64_t deltaTimeMs = 16;
+    PCT_World **worlds = malloc(sizeof(PCT_World *) * instanceCount);
+    PCT_TickInput *inputs = malloc(sizeof(PCT_TickInput) * instanceCount);
+    if (worlds == NULL || inputs == NULL) {
+        printf("Failed to allocate headless instances.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    for (size_t i = 0; i < instanceCount; i++) {
+        worlds[i] = PCT_CreateWorld(mapCache, "01.map", PCT_WORLD_DEFAULT_ENEMY_CAPACITY, i + 1,
+                                    false);
+        PCT_SpawnEnemies(worlds[i]->state);
+    }
+    PCT_ThreadPool *pool = PCT_CreateThreadPool(threadCount);
+    PCT_KdTreeProfile treeProfile = {0};
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (size_t tick = 0; tick < ticks; tick++) {
+        for (size_t i = 0; i < instanceCount; i++) {
+            PCT_WorldBotInput(worlds[i], deltaTimeMs, inputs + i);
+        }
+        PCT_TickWorlds(pool, worlds, inputs, instanceCount);
+        if (PCT_KdTreeProfileEnabled()) {
+            PCT_KdTreeProfileRoll(NULL, &treeProfile);
+        }
+    }
+    double seconds =
+        (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    double instanceTicks = (double)instanceCount * (double)ticks;
+    printf("headless: %zu instances, %zu maps loaded, %zu threads + caller, %zu ticks in %.3f s: "
+           "%.2f us per instance tick, %.0f instance ticks/s\n",
+           instanceCount, mapCache->count, pool->threadCount, ticks, seconds,
+           instanceTicks > 0 ? seconds * 1e6 / instanceTicks : 0.0,
+           seconds > 0 ? instanceTicks / seconds : 0.0);
+    if (PCT_KdTreeProfileEnabled()) {
+        PCT_KdTreePrintProfile(&treeProfile, stdout);
+    }
+
+    PCT_DestroyThreadPool(pool);
+    for (size_t i = 0; i < instanceCount; i++) {
+        PCT_DestroyWorld(worlds[i]);
+    }
+    free(inputs);
+    free(worlds);
+}
+
+static bool PCT_SameRayHits(const PCT_RayHit *hits, const PCT_RayHit *others, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if ((hits[i].box == NULL) != (others[i].box == NULL) ||
+            (hits[i].box != NULL && hits[i].time != others[i].time)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Builds float and compact trees of mapName with params and compares their memory and
+ * query latency on the same random player sized ranges and short casts. The casts are also
+ * traced as packets and emulated by a range query of the swept box with a slab test per found
+ * box, the way casts were answered before the tree could trace them.
+ * @return false when the trees or the cast methods disagree on any query
+ */
+bool PCT_RunKdTreeBenchmark(const char *mapName, const PCT_KdTreeBuildParams *params) {
+    const size_t queryCount = 100000;
+    size_t pointsRead = 0, rectCount = 0;
+    vec2 *mapPoints = PCT_ReadMapRaw(mapName, &pointsRead);
+    PCT_AaBb *mapRects = PCT_ParseMapRects(mapPoints, pointsRead, &rectCount);
+    free(mapPoints);
+    PCT_AaBb *treeRects = malloc(sizeof(PCT_AaBb) * rectCount);
+    PCT_AaBb *ranges = malloc(sizeof(PCT_AaBb) * queryCount);
+    PCT_Point *casts = malloc(sizeof(PCT_Point) * queryCount * 2);
+    PCT_Point *origins = malloc(sizeof(PCT_Point) * queryCount);
+    PCT_Vector *directions = malloc(sizeof(PCT_Vector) * queryCount);
+    PCT_RayHit *hits = malloc(sizeof(PCT_RayHit) * queryCount);
+    PCT_RayHit *otherHits = malloc(sizeof(PCT_RayHit) * queryCount);
+    if (treeRects == NULL || ranges == NULL || casts == NULL || origins == NULL ||
+        directions == NULL || hits == NULL || otherHits == NULL) {
+        printf("Failed to allocate kdTree benchmark.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    memcpy(treeRects, mapRects, sizeof(PCT_AaBb) * rectCount);
+    PCT_KdTree *tree = PCT_BuildKdTreeWithParams(treeRects, rectCount, params);
+    PCT_KdTreeStats stats;
+    PCT_KdTreeComputeStats(tree, rectCount, &stats);
+    // Straddling boxes are returned once per leaf they are stored in, so a range query finds at
+    // most every stored copy and not just every map rect.
+    size_t foundCapacity = SDL_max(stats.storedBoxes, rectCount);
+    const PCT_AaBb **found = malloc(sizeof(PCT_AaBb *) * foundCapacity);
+    if (found == NULL) {
+        printf("Failed to allocate kdTree benchmark.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+
+    srand(1);
+    float width = tree->bounds.x2 - tree->bounds.x1;
+    float height = tree->bounds.y2 - tree->bounds.y1;
+    for (size_t i = 0; i < queryCount; i++) {
+        float x = tree->bounds.x1 + width * ((float)rand() / (float)RAND_MAX);
+        float y = tree->bounds.y1 + height * ((float)rand() / (float)RAND_MAX);
+        ranges[i] = (PCT_AaBb){x, y, x + 0.15f, y + 0.2f};
+        casts[i * 2] = (PCT_Point){x, y};
+        casts[i * 2 + 1] = (PCT_Point){x + ((float)rand() / (float)RAND_MAX - 0.5f),
+                                       y + ((float)rand() / (float)RAND_MAX - 0.5f)};
+        origins[i] = casts[i * 2];
+        directions[i] = (PCT_Vector){casts[i * 2 + 1].x - x, casts[i * 2 + 1].y - y};
+    }
+
+    size_t rangeHits = 0, castHits = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (size_t i = 0; i < queryCount; i++) {
+        rangeHits += PCT_KdTreeRangeQuery(tree, ranges + i, found, foundCapacity) > 0;
+    }
+    Uint64 rangeTime = SDL_GetPerformanceCounter() - start;
+    start = SDL_GetPerformanceCounter();
+    for (size_t i = 0; i < queryCount; i++) {
+        castHits += PCT_KdTreeSegmentCast(tree, casts + i * 2, casts + i * 2 + 1, hits + i);
+    }
+    Uint64 castTime = SDL_GetPerformanceCounter() - start;
+    double nsPerTick = 1e9 / (double)SDL_GetPerformanceFrequency() / (double)queryCount;
+    printf("kdTree float:     %8zu KiB, range %7.1f ns, cast %7.1f ns\n",
+           stats.memoryBytes / 1024, (double)rangeTime * nsPerTick,
+           (double)castTime * nsPerTick);
+
+    start = SDL_GetPerformanceCounter();
+    PCT_KdTreeRaycastPacket(tree, origins, directions, NULL, queryCount, otherHits);
+    Uint64 packetTime = SDL_GetPerformanceCounter() - start;
+    bool castsAgree = PCT_SameRayHits(hits, otherHits, queryCount);
+    start = SDL_GetPerformanceCounter();
+    for (size_t i = 0; i < queryCount; i++) {
+        const PCT_Point *from = casts + i * 2;
+        const PCT_Point *to = casts + i * 2 + 1;
+        PCT_AaBb swept = {fminf(from->x, to->x), fminf(from->y, to->y), fmaxf(from->x, to->x),
+                          fmaxf(from->y, to->y)};
+        size_t count = PCT_KdTreeRangeQuery(tree, &swept, found, foundCapacity);
+        if (count > foundCapacity) {
+            const PCT_AaBb **grown = realloc(found, sizeof(PCT_AaBb *) * count);
+            if (grown == NULL) {
+                printf("Failed to grow kdTree benchmark query.\n");
+                exit(PCT_EXIT_CODE_MEMORY_ERROR);
+            }
+            found = grown;
+            foundCapacity = count;
+            PCT_KdTreeRangeQuery(tree, &swept, found, foundCapacity);
+        }
+        otherHits[i] = (PCT_RayHit){.box = NULL, .time = 1.0f};
+        for (size_t j = 0; j < count; j++) {
+            float time;
+            vec2 normal;
+            if (PCT_RayBoxTest(origins + i, directions + i, found[j], otherHits[i].time, &time,
+                               normal) &&
+                (otherHits[i].box == NULL || time < otherHits[i].time)) {
+                otherHits[i].box = found[j];
+                otherHits[i].time = time;
+            }
+        }
+    }
+    Uint64 emulatedTime = SDL_GetPerformanceCounter() - start;
+    castsAgree = castsAgree && PCT_SameRayHits(hits, otherHits, queryCount);
+    printf("kdTree casts:     segment %7.1f ns, packet %7.1f ns, range + slab %7.1f ns, %s\n",
+           (double)castTime * nsPerTick, (double)packetTime * nsPerTick,
+           (double)emulatedTime * nsPerTick, castsAgree ? "agree" : "DISAGREE");
+
+    bool agree = castsAgree;
+    const uint8_t quantizationBits[] = {16, 8};
+    for (size_t b = 0; b < sizeof(quantizationBits) / sizeof(quantizationBits[0]); b++) {
+        PCT_CompactKdTree *compact =
+            PCT_BuildCompactKdTree(mapRects, rectCount, params, quantizationBits[b]);
+        size_t compactRangeHits = 0, compactCastHits = 0;
+        start = SDL_GetPerformanceCounter();
+        for (size_t i = 0; i < queryCount; i++) {
+            compactRangeHits +=
+                PCT_CompactKdTreeRangeQuery(compact, ranges + i, found, foundCapacity) > 0;
+        }
+        rangeTime = SDL_GetPerformanceCounter() - start;
+        start = SDL_GetPerformanceCounter();
+        for (size_t i = 0; i < queryCount; i++) {
+            compactCastHits +=
+                PCT_CompactKdTreeSegmentCast(compact, casts + i * 2, casts + i * 2 + 1, NULL);
+        }
+        castTime = SDL_GetPerformanceCounter() - start;
+        printf("kdTree %2u bit:    %8zu KiB, range %7.1f ns, cast %7.1f ns, %3.0f%% of float\n",
+               quantizationBits[b], compact->memoryBytes / 1024, (double)rangeTime * nsPerTick,
+               (double)castTime * nsPerTick,
+               100.0 * (double)compact->memoryBytes / (double)stats.memoryBytes);
+        agree = agree && compactRangeHits == rangeHits && compactCastHits == castHits;
+        PCT_DestroyCompactKdTree(compact);
+    }
+    printf("kdTree: %zu rects, %zu of %zu ranges and %zu casts hit, trees %s\n", rectCount,
+           rangeHits, queryCount, castHits, agree ? "agree" : "DISAGREE");
+    if (PCT_KdTreeProfileEnabled()) {
+        PCT_KdTreeProfile treeProfile = {0};
+        PCT_KdTreeProfileRoll(tree, &treeProfile);
+        PCT_KdTreePrintProfile(&treeProfile, stdout);
+    }
+
+    PCT_DestroyKdTree(tree);
+    free(found);
+    free(otherHits);
+    free(hits);
+    free(directions);
+    free(origins);
+    free(casts);
+    free(ranges);
+    free(mapRects);
+    return agree;
+}
+
+static int PCT_CompareBoxValues(const void *a, const void *b) {
+    return memcmp(*(const PCT_AaBb *const *)a, *(const PCT_AaBb *const *)b, sizeof(PCT_AaBb));
+}
+
+static int PCT_CompareFloats(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static float PCT_SelfTestRandom(float scale, bool onGrid) {
+    // Grid coordinates put box edges, query points and split planes on the same values.
+    return onGrid ? (float)(rand() % (int)(scale * 4.0f)) * 0.25f
+                  : scale * ((float)rand() / (float)RAND_MAX);
+}
+
+/**
+ * @brief Checks nearest and point queries of trees built with params and a few other settings
+ * from random maps against a linear scan of the boxes. Nearest distances have to match in value
+ * and order with copies of straddling boxes counted once, point queries have to return the same
+ * set of boxes. Prints the first mismatches.
+ * @return false on any mismatch
+ */
+bool PCT_RunKdTreeSelfTest(const PCT_KdTreeBuildParams *params) {
+    const size_t mapSizes[] = {1, 7, 64, 500, 3000};
+    const size_t queryCount = 2000;
+    const size_t maxNeighbours = 16;
+    PCT_KdTreeBuildParams paramSets[4] = {*params, *params, *params, *params};
+    paramSets[1].splitMode = PCT_KDTREE_SPLIT_MEDIAN;
+    paramSets[1].leafSize = 1;
+    paramSets[2].splitMode = PCT_KDTREE_SPLIT_SAH;
+    paramSets[3].splitMode = PCT_KDTREE_SPLIT_SAH;
+    paramSets[3].leafSize = 2;
+    paramSets[3].maxDepth = 6;
+    const size_t maxBoxes = mapSizes[sizeof(mapSizes) / sizeof(mapSizes[0]) - 1];
+    PCT_AaBb *mapBoxes = malloc(sizeof(PCT_AaBb) * maxBoxes);
+    const PCT_AaBb **unique = malloc(sizeof(PCT_AaBb *) * maxBoxes);
+    float *expectedDistances = malloc(sizeof(float) * maxBoxes);
+    const PCT_AaBb **expected = malloc(sizeof(PCT_AaBb *) * maxBoxes);
+    const PCT_AaBb **found = malloc(sizeof(PCT_AaBb *) * maxBoxes);
+    const PCT_AaBb **neighbours = malloc(sizeof(PCT_AaBb *) * maxNeighbours);
+    float *distances = malloc(sizeof(float) * maxNeighbours);
+    if (mapBoxes == NULL || unique == NULL || expectedDistances == NULL || expected == NULL ||
+        found == NULL || neighbours == NULL || distances == NULL) {
+        printf("Failed to allocate kdTree self test.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+
+    srand(1);
+    size_t maps = 0, queries = 0, mismatches = 0;
+    for (size_t p = 0; p < sizeof(paramSets) / sizeof(paramSets[0]); p++) {
+        for (size_t m = 0; m < sizeof(mapSizes) / sizeof(mapSizes[0]); m++) {
+            for (size_t grid = 0; grid < 2; grid++) {
+                size_t boxCount = mapSizes[m];
+                float extent = 4.0f + sqrtf((float)boxCount) * 2.0f;
+                for (size_t i = 0; i < boxCount; i++) {
+                    float x = PCT_SelfTestRandom(extent, grid);
+                    float y = PCT_SelfTestRandom(extent, grid);
+                    mapBoxes[i] = (PCT_AaBb){x, y, x + 0.25f + PCT_SelfTestRandom(3.0f, grid),
+                                             y + 0.25f + PCT_SelfTestRandom(1.0f, grid)};
+                }
+                PCT_AaBb *treeBoxes = malloc(sizeof(PCT_AaBb) * boxCount);
+                if (treeBoxes == NULL) {
+                    printf("Failed to allocate kdTree self test.\n");
+                    exit(PCT_EXIT_CODE_MEMORY_ERROR);
+                }
+                memcpy(treeBoxes, mapBoxes, sizeof(PCT_AaBb) * boxCount);
+                PCT_KdTree *tree = PCT_BuildKdTreeWithParams(treeBoxes, boxCount, paramSets + p);
+                maps++;
+
+                // Equal boxes are one box to the nearest query, same as copies of a straddling one.
+                for (size_t i = 0; i < boxCount; i++) {
+                    unique[i] = mapBoxes + i;
+                }
+                qsort(unique, boxCount, sizeof(PCT_AaBb *), PCT_CompareBoxValues);
+                size_t uniqueCount = 0;
+                for (size_t i = 0; i < boxCount; i++) {
+                    if (uniqueCount == 0 ||
+                        PCT_CompareBoxValues(unique + uniqueCount - 1, unique + i) != 0) {
+                        unique[uniqueCount++] = unique[i];
+                    }
+                }
+
+                for (size_t q = 0; q < queryCount; q++) {
+                    PCT_Point point;
+                    const PCT_AaBb *corner = mapBoxes + (size_t)rand() % boxCount;
+                    switch (q % 4) {
+                    case 0:
+                        point = (PCT_Point){corner->x1, corner->y1};
+                        break;
+                    case 1:
+                        point = (PCT_Point){corner->x2, corner->y2};
+                        break;
+                    default:
+                        point = (PCT_Point){PCT_SelfTestRandom(extent + 4.0f, grid) - 2.0f,
+                                            PCT_SelfTestRandom(extent + 4.0f, grid) - 2.0f};
+                        break;
+                    }
+                    queries++;
+
+                    size_t k = 1 + q % maxNeighbours;
+                    size_t count = PCT_KdTreeNearest(tree, &point, k, neighbours, distances);
+                    for (size_t i = 0; i < uniqueCount; i++) {
+                        float dx = fmaxf(fmaxf(unique[i]->x1 - point.x, point.x - unique[i]->x2),
+                                         0.0f);
+                        float dy = fmaxf(fmaxf(unique[i]->y1 - point.y, point.y - unique[i]->y2),
+                                         0.0f);
+                        expectedDistances[i] = sqrtf(dx * dx + dy * dy);
+                    }
+                    qsort(expectedDistances, uniqueCount, sizeof(float), PCT_CompareFloats);
+                    bool nearestMatch = count == SDL_min(k, uniqueCount);
+                    for (size_t i = 0; nearestMatch && i < count; i++) {
+                        nearestMatch = distances[i] == expectedDistances[i];
+                        for (size_t j = 0; nearestMatch && j < i; j++) {
+                            nearestMatch =
+                                PCT_CompareBoxValues(neighbours + i, neighbours + j) != 0;
+                        }
+                    }
+                    if (!nearestMatch) {
+                        if (mismatches++ < 8) {
+                            printf("kdTree selftest: params %zu, %zu boxes, nearest %zu of (%g, "
+                                   "%g) returned %zu boxes, expected %zu\n",
+                                   p, boxCount, k, (double)point.x, (double)point.y, count,
+                                   SDL_min(k, uniqueCount));
+                        }
+                        continue;
+                    }
+
+                    count = PCT_KdTreePointQuery(tree, &point, found, boxCount);
+                    size_t expectedCount = 0;
+                    for (size_t i = 0; i < boxCount; i++) {
+                        const PCT_AaBb *box = mapBoxes + i;
+                        if (point.x >= box->x1 && point.x < box->x2 && point.y >= box->y1 &&
+                            point.y < box->y2) {
+                            expected[expectedCount++] = box;
+                        }
+                    }
+                    bool pointMatch = count == expectedCount;
+                    if (pointMatch) {
+                        qsort(found, count, sizeof(PCT_AaBb *), PCT_CompareBoxValues);
+                        qsort(expected, expectedCount, sizeof(PCT_AaBb *), PCT_CompareBoxValues);
+                        for (size_t i = 0; pointMatch && i < count; i++) {
+                            pointMatch = PCT_CompareBoxValues(found + i, expected + i) == 0;
+                        }
+                    }
+                    if (!pointMatch && mismatches++ < 8) {
+                        printf("kdTree selftest: params %zu, %zu boxes, point (%g, %g) found %zu "
+                               "boxes, expected %zu\n",
+                               p, boxCount, (double)point.x, (double)point.y, count,
+                               expectedCount);
+                    }
+                }
+                PCT_DestroyKdTree(tree);
+            }
+        }
+    }
+    printf("kdTree selftest: %zu maps, %zu queries, %zu mismatches\n", maps, queries, mismatches);
+
+    free(distances);
+    free(neighbours);
+    free(found);
+    free(expected);
+    free(expectedDistances);
+    free(unique);
+    free(mapBoxes);
+    return mismatches == 0;
+}
+
+Sint32 main(Sint32 argc, char **argv) {
+    PCT_KdTreeBuildParams treeParams = PCT_KdTreeDefaultBuildParams();
+    bool printTreeStats = false;
+    size_t headlessInstances = 0;
+    size_t headlessTicks = 600;
+    size_t headlessThreads = 0;
+    bool runTreeBenchmark = false;
+    bool runTreeSelfTest = false;
+    size_t benchmarkParticles = 0;
+    bool lowLatency = false;
+    for (Sint32 i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--kdtree-sah") == 0) {
+            treeParams.splitMode = PCT_KDTREE_SPLIT_SAH;
+        } else if (strcmp(argv[i], "--kdtree-leaf") == 0 && i + 1 < argc) {
+            treeParams.leafSize = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--kdtree-depth") == 0 && i + 1 < argc) {
+            treeParams.maxDepth = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--kdtree-bins") == 0 && i + 1 < argc) {
+            treeParams.binCount = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--kdtree-stats") == 0) {
+            printTreeStats = true;
+        } else if (strcmp(argv[i], "--kdtree-bench") == 0) {
+            runTreeBenchmark = true;
+        } else if (strcmp(argv[i], "--kdtree-selftest") == 0) {
+            runTreeSelfTest = true;
+        } else if (strcmp(argv[i], "--low-latency") == 0) {
+            lowLatency = true;
+        } else if (strcmp(argv[i], "--particles-bench") == 0 && i + 1 < argc) {
+            benchmarkParticles = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--net-loopback") == 0) {
+            const size_t entityCounts[] = {1000, 5000, 10000, 50000};
+            bool inSync = true;
+            for (size_t j = 0; j < sizeof(entityCounts) / sizeof(entityCounts[0]); j++) {
+                inSync = PCT_NetRunLoopback(entityCounts[j], 600, stdout) && inSync;
+            }
+            return inSync ? 0 : 1;
+        } else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headlessInstances = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            headlessTicks = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            headlessThreads = strtoul(argv[++i], NULL, 10);
+        }
+    }
+
+    if (runTreeSelfTest) {
+        return PCT_RunKdTreeSelfTest(&treeParams) ? 0 : 1;
+    }
+    if (runTreeBenchmark) {
+        return PCT_RunKdTreeBenchmark("01.map", &treeParams) ? 0 : 1;
+    }
+    if (benchmarkParticles > 0) {
+        PCT_RunParticleBenchmark("01.map", benchmarkParticles, 600);
+        return 0;
+    }
+
+    PCT_MapCache *mapCache = PCT_CreateMapCache(&treeParams);
+    if (headlessInstances > 0) {
+        PCT_RunHeadless(mapCache, headlessInstances, headlessTicks, headlessThreads);
+        PCT_DestroyMapCache(mapCache);
+        return 0;
+    }
 
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD) < 0) {
         SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to initialize SDL: %s", SDL_GetError());
@@ -353,13 +1105,26 @@ Sint32 main(Sint32 argc, char **argv) {
         exit(0);
     }
 
+    // Map parsing and tree build, script compilation and texture decode all run on the loaders,
+    // only what the first simulated frame needs is waited for. The sprite sheet shows a
+    // placeholder until it is uploaded.
+    PCT_AssetManager *assets = PCT_CreateAssetManager(renderer, mapCache, 0);
+    PCT_AssetHandle mapAsset = PCT_RequestMap(assets, "01.map");
+    PCT_AssetHandle tocScript = PCT_RequestScript(assets, "robots/toc.lua");
+    PCT_AssetHandle animationScript = PCT_RequestScript(assets, "robots/animations.lua");
+    PCT_AssetHandle spriteSheet = PCT_RequestTexture(assets, "robots/assets/walk.bmp");
     PCT_LuaScriptingContext *luaCtx = PCT_InitLuaScripting();
-    if (luaL_dofile(luaCtx->L, "robots/toc.lua") != LUA_OK) {
+    PCT_WaitForAssets(assets, (PCT_AssetHandle[]){mapAsset, tocScript, animationScript}, 3);
+
+    if (PCT_RunScript(assets, tocScript, luaCtx->L) != LUA_OK) {
         SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", lua_tostring(luaCtx->L, -1));
     }
-    SDL_Surface *spriteSheetSurface = SDL_LoadBMP("robots/assets/walk.bmp");
-    SDL_Texture *spriteSheetTexture = SDL_CreateTextureFromSurface(renderer, spriteSheetSurface);
-    SDL_DestroySurface(spriteSheetSurface);
+    lua_settop(luaCtx->L, 0);
+    PCT_AnimationLibrary *animations = PCT_CreateAnimationLibrary();
+    PCT_PlayerClips playerClips =
+        PCT_LoadPlayerClips(luaCtx, animations, assets, animationScript);
+    PCT_Animator playerAnimator = {.clip = PCT_ANIMATION_NO_CLIP};
+    PCT_SpriteBatch *spriteBatch = PCT_CreateSpriteBatch(64);
 
     Sint32 controllerCount;
     SDL_Gamepad *gamepad = NULL;
@@ -369,31 +1134,74 @@ Sint32 main(Sint32 argc, char **argv) {
     }
 
     SDL_bool running = SDL_TRUE;
-    PCT_Player player = {.currentState = PCT_PLAYER_STATE_IDLE,
-                         .direction = 1,
-                         .locationX = 0.0f,
-                         .locationY = 0.0f};
-
-    size_t pointsRead = 0;
-    vec2 *mapPoints = PCT_ReadMapRaw("01.map", &pointsRead);
-    size_t rectsRead = 0;
-    PCT_AaBb *mapRects = PCT_ParseMapRects(mapPoints, pointsRead, &rectsRead);
-    free(mapPoints);
-    PCT_KdTree *map = PCT_BuildKdTree(mapRects, rectsRead);
 
-    mat4 view = {0};
-    mat4 vp = {0};
-    float cameraY = 0.0f;
+    // Map is already in the cache, so the world only takes another reference to it.
+    PCT_World *world = PCT_CreateWorld(mapCache, "01.map", PCT_WORLD_DEFAULT_ENEMY_CAPACITY,
+                                       SDL_GetPerformanceCounter(), true);
+    PCT_SpawnEnemies(world->state);
+    PCT_SimState *state = world->state;
+    const PCT_KdTree *map = world->map->tree;
+    PCT_ParticleSystem *particles =
+        PCT_CreateParticleSystem(world->map->occupancy, SDL_GetPerformanceCounter());
+    PCT_EffectEmitters effectEmitters = PCT_AddEffectEmitters(particles);
+    float enemyHealth[PCT_WORLD_DEFAULT_ENEMY_CAPACITY] = {0};
+    for (size_t i = 0; i < state->enemyCount; i++) {
+        enemyHealth[i] = state->enemies[i].health;
+    }
+    bool playerWasOnGround = state->player.isOnGround;
+
+    if (printTreeStats) {
+        PCT_KdTreeStats treeStats;
+        PCT_KdTreeComputeStats(map, world->map->rectCount, &treeStats);
+        PCT_KdTreePrintStats(&treeStats, stdout);
+        const PCT_OccupancyGrid *occupancy = world->map->occupancy;
+        printf("occupancy: %zux%zu cells of %.4f, %zu levels, %zu KiB\n", occupancy->width,
+               occupancy->height, occupancy->cellSize, occupancy->levelCount,
+               occupancy->memoryBytes / 1024);
+        const PCT_NavGraph *navigation = world->map->navigation;
+        printf("navigation: %zu surfaces, %zu segments, %zu links\n", navigation->nodeCount,
+               navigation->segmentCount, navigation->linkCount);
+    }
+
     float z = 0.0f;
-    float cameraX = 0.0f;
 
     Sint64 lastFrameTime = SDL_GetTicks();
     Sint64 deltaTimeMs = 0;
     Sint64 currentFrameTime = SDL_GetTicks();
     float velocityX = 0.0f;
+    bool showTreeOverlay = false;
+    bool printFrameMetrics = false;
+    bool showLatencyOverlay = lowLatency;
+    PCT_KdTreeProfile treeProfile = {0};
+    PCT_FrameMetrics frameMetrics = {0};
+    PCT_FrameMetrics frameMetricsTotal = {0};
+    Sint64 profileWindowStart = lastFrameTime;
+
+    // Rendering stays on the main thread, which is the only one SDL lets touch the renderer on
+    // every platform. The simulation moves to its own thread, so a slow present delays only the
+    // next picked up snapshot and a slow tick never holds back present. Low latency mode trades
+    // that overlap for sampling input, ticking and drawing back to back just before the refresh.
+    PCT_FrameSnapshotBuffer *snapshots =
+        PCT_CreateFrameSnapshotBuffer(PCT_WORLD_DEFAULT_ENEMY_CAPACITY);
+    PCT_SimThread sim;
+    PCT_InitSim(&sim, world, snapshots);
+    const SDL_DisplayMode *displayMode =
+        SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+    PCT_FramePacer pacer;
+    PCT_InitFramePacer(&pacer, displayMode != NULL ? displayMode->refresh_rate : 0.0f);
+    // Both modes present on vsync, so their latency and missed refreshes compare like for like.
+    SDL_SetRenderVSync(renderer, 1);
+    if (!lowLatency) {
+        PCT_StartSimThread(&sim);
+    }
     while (running) {
         float x = 0.0f;
 
+        // Work the frame does not depend on input for happens before the wait, not after it.
+        PCT_AssetManagerUpdate(assets, PCT_ASSET_UPLOAD_BUDGET_NS);
+        if (lowLatency) {
+            PCT_FramePacerWait(&pacer);
+        }
         currentFrameTime = SDL_GetTicks();
         deltaTimeMs = currentFrameTime - lastFrameTime;
         lastFrameTime = currentFrameTime;
@@ -403,13 +1211,15 @@ Sint32 main(Sint32 argc, char **argv) {
             case SDL_EVENT_QUIT:
                 running = SDL_FALSE;
                 break;
-            case SDL_EVENT_KEY_UP:
-                if (e.key.keysym.scancode == SDL_SCANCODE_Z) {
-                    player.isJumping = false;
-                }
-                if (e.key.keysym.scancode == SDL_SCANCODE_X) {
-                    player.isAttacking = false;
+            case SDL_EVENT_KEY_DOWN:
+                if (e.key.keysym.scancode == SDL_SCANCODE_F3 && !e.key.repeat) {
+                    showTreeOverlay = !showTreeOverlay;
+                } else if (e.key.keysym.scancode == SDL_SCANCODE_F2 && !e.key.repeat) {
+                    printFrameMetrics = !printFrameMetrics;
+                } else if (e.key.keysym.scancode == SDL_SCANCODE_F4 && !e.key.repeat) {
+                    showLatencyOverlay = !showLatencyOverlay;
                 }
+                break;
             }
         }
         float deltaTimeS = deltaTimeMs / 1000.0f;
@@ -424,41 +1234,89 @@ Sint32 main(Sint32 argc, char **argv) {
             attack = SDL_GetGamepadButton(gamepad, SDL_GAMEPAD_BUTTON_WEST);
             x = PCT_GetAnalogInput(xRaw);
         }
-        PCT_UpdatePlayer(&player, x, jump, attack, deltaTimeMs, map);
-        PCT_UpdatePlayerAnimation(&player, deltaTimeMs);
-        for (size_t i = 0; i < 2; i++) {
-            PCT_UpdateEnemy(&enemies[i], deltaTimeMs, map);
+        Uint64 inputNs = SDL_GetTicksNS();
+        if (lowLatency) {
+            PCT_TickInput input = {
+                .moveX = x, .jump = jump, .attack = attack, .deltaTimeMs = deltaTimeMs};
+            PCT_StepSim(&sim, &input, inputNs);
+        } else {
+            PCT_SetSimInput(&sim, x, jump, attack, inputNs);
+        }
+        if (currentFrameTime - profileWindowStart >= PCT_KDTREE_PROFILE_WINDOW_MS) {
+            PCT_KdTreeProfileRoll(map, &treeProfile);
+            PCT_RollFrameMetrics(snapshots, &frameMetrics, &frameMetricsTotal);
+            if (printFrameMetrics) {
+                PCT_PrintFrameMetrics(&frameMetrics, stdout);
+            }
+            profileWindowStart = currentFrameTime;
         }
 
-        float cameraTargetX = (player.locationX + 0.05f) + ((float)player.direction) * 0.05f;
-        float cameraTargetY = player.locationY + 0.05f;
-        cameraX = glm_lerpc(cameraX, cameraTargetX, 10.0f * deltaTimeS);
-        cameraY = SDL_clamp(glm_lerpc(cameraY, cameraTargetY, 10.0f * deltaTimeS),
-                            player.locationY - 1, player.locationY + 1);
-
-        mat4 projection = {0};
-        glm_perspective(glm_rad(45), ((float)SCREEN_WIDTH) / ((float)SCREEN_HEIGHT), 0.1f, 100.0f,
-                        projection);
-        glm_scale(projection, (vec3){1.0f, -1.0f, 1.0f});
-        glm_lookat((vec3){cameraX, cameraY, 3.0f}, (vec3){cameraX, cameraY, -10.0f},
-                   (vec3){0.0f, 1.0f, 0.0f}, view);
-        glm_mat4_mul(projection, view, vp);
-
+        const PCT_FrameSnapshot *frame = PCT_AcquireFrameSnapshot(snapshots);
         SDL_SetRenderDrawColorFloat(renderer, 0.1, 0.12, 0.13, 1.0);
         SDL_RenderClear(renderer);
-        PCT_DrawMap(map, renderer, vp, 0.22f, cameraX, cameraY);
-        PCT_DrawPlayer(&player, spriteSheetTexture, renderer, vp);
-        for (size_t i = 0; i < 2; i++) {
-            PCT_DrawEnemy(enemies + i, renderer, vp);
+        if (frame != NULL) {
+            const PCT_SimState *frameState = frame->state;
+            const PCT_Player *player = &frameState->player;
+            PCT_EmitTickEffects(particles, &effectEmitters, frameState, enemyHealth,
+                                &playerWasOnGround);
+            PCT_UpdateParticles(particles, deltaTimeS);
+
+            mat4 vp;
+            PCT_CameraVp(frame->cameraX, frame->cameraY, vp);
+            PCT_SpriteBatchClear(spriteBatch);
+            size_t playerSprite = PCT_SpriteBatchAppend(spriteBatch, 1);
+            PCT_BatchPlayer(player, spriteBatch, playerSprite, vp);
+            PCT_PlayAnimation(&playerAnimator, PCT_PlayerClip(player, &playerClips));
+            PCT_AdvanceAnimators(animations, &playerAnimator, 1, (uint32_t)deltaTimeMs,
+                                 spriteBatch->sources + playerSprite);
+
+            PCT_DrawMap(frame->mapBoxes, frame->mapBoxCount, renderer, vp);
+            if (showTreeOverlay) {
+                PCT_DrawKdTreeOverlay(map, &treeProfile, renderer, vp);
+            }
+            PCT_DrawSpriteBatch(spriteBatch, renderer, PCT_GetTexture(assets, spriteSheet));
+            for (size_t i = 0; i < frameState->enemyCount; i++) {
+                PCT_DrawEnemy(frameState->enemies + i, renderer, vp);
+            }
+            PCT_DrawPlayerAttack(frameState, renderer, vp);
+            PCT_AaBb viewRect;
+            float pixelSize;
+            PCT_ViewRectFromVp(vp, &viewRect, &pixelSize);
+            PCT_DrawParticles(particles, renderer, &viewRect, (float)SCREEN_WIDTH,
+                              (float)SCREEN_HEIGHT);
         }
-        PCT_PlayerAttack(&player, enemies, deltaTimeS, renderer, vp, attack);
+        if (showLatencyOverlay) {
+            PCT_DrawLatencyOverlay(&pacer, renderer);
+        }
+        PCT_FramePacerPresenting(&pacer);
         SDL_RenderPresent(renderer);
+        if (frame != NULL) {
+            PCT_FramePacerPresented(&pacer, frame->inputNs);
+            PCT_FrameSnapshotPresented(snapshots, frame);
+        }
     }
+    PCT_StopSimThread(&sim);
 
-    free(map);
+    PCT_RollFrameMetrics(snapshots, NULL, &frameMetricsTotal);
+    PCT_PrintFrameMetrics(&frameMetricsTotal, stdout);
+    PCT_PrintFramePacer(&pacer, stdout);
+    if (PCT_KdTreeProfileEnabled()) {
+        PCT_KdTreeProfileRoll(map, &treeProfile);
+        PCT_KdTreePrintProfile(&treeProfile, stdout);
+    }
+    PCT_DestroyParticleSystem(particles);
+    PCT_DestroyFrameSnapshotBuffer(snapshots);
+    PCT_DestroyWorld(world);
+    PCT_ReleaseAsset(assets, spriteSheet);
+    PCT_ReleaseAsset(assets, animationScript);
+    PCT_ReleaseAsset(assets, tocScript);
+    PCT_ReleaseAsset(assets, mapAsset);
+    PCT_DestroyAssetManager(assets);
+    PCT_DestroyMapCache(mapCache);
+    PCT_DestroySpriteBatch(spriteBatch);
+    PCT_DestroyAnimationLibrary(animations);
     PCT_DestroyLuaScripting(luaCtx);
     SDL_CloseGamepad(gamepad);
-    SDL_DestroyTexture(spriteSheetTexture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -3,9 +3,22 @@
 
 #include "scripting.h"
 
+#include "assets/assetManager.h"
 #include "assets/assets.h"
+#include "game/animation.h"
 #include "game/game.h"
+#include "game/map.h"
+#include "game/navigation.h"
+#include "game/physics.h"
+#include "game/simulation.h"
+#include "game/world.h"
 #include "misc/errors.h"
+#include "misc/threadPool.h"
+#include "net/replication.h"
+#include "render/framePacer.h"
+#include "render/frameSnapshot.h"
+#include "render/particles.h"
+#include "render/spriteBatch.h"
 #include "structures/structures.h"
 #include "entity.h"
 
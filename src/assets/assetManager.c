@@ -0,0 +1,374 @@
+#include "assetManager.h"
+#include "../game/world.h"
+#include "../misc/errors.h"
+#include "../scripting.h"
+#include <SDL3/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PCT_PLACEHOLDER_SIZE 64
+#define PCT_PLACEHOLDER_TILE 8
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} PCT_ChunkWriter;
+
+static inline PCT_Asset *PCT_AssetFromHandle(const PCT_AssetManager *manager,
+                                             const PCT_AssetHandle handle) {
+    if (handle.index == 0 || handle.index > PCT_ASSET_MAX) {
+        return NULL;
+    }
+    PCT_Asset *asset = (PCT_Asset *)manager->assets + (handle.index - 1);
+    return asset->generation == handle.generation && asset->refCount > 0 ? asset : NULL;
+}
+
+/**
+ * @brief Frees everything asset holds and returns its slot, caller holds the manager lock.
+ * Textures only exist once uploaded on the main thread, so workers never destroy one.
+ */
+static void PCT_FreeAsset(PCT_AssetManager *manager, PCT_Asset *asset) {
+    if (asset->surface != NULL) {
+        SDL_DestroySurface(asset->surface);
+    }
+    if (asset->texture != NULL) {
+        SDL_DestroyTexture(asset->texture);
+    }
+    free(asset->chunk);
+    if (asset->map != NULL) {
+        PCT_MapCacheRelease(manager->mapCache, asset->map);
+    }
+    uint32_t generation = asset->generation + 1;
+    memset(asset, 0, sizeof(PCT_Asset));
+    asset->generation = generation;
+    SDL_AtomicSet(&asset->state, PCT_ASSET_STATE_FREE);
+}
+
+static int PCT_WriteChunk(lua_State *L, const void *data, size_t size, void *context) {
+    (void)L;
+    PCT_ChunkWriter *writer = context;
+    if (writer->size + size > writer->capacity) {
+        size_t capacity = writer->capacity > 0 ? writer->capacity * 2 : 4096;
+        while (capacity < writer->size + size) {
+            capacity *= 2;
+        }
+        uint8_t *grown = realloc(writer->data, capacity);
+        if (grown == NULL) {
+            return 1;
+        }
+        writer->data = grown;
+        writer->capacity = capacity;
+    }
+    memcpy(writer->data + writer->size, data, size);
+    writer->size += size;
+    return 0;
+}
+
+/**
+ * @brief Compiles script in a private Lua state and keeps the bytecode, so the main thread only
+ * has to load precompiled chunks.
+ */
+static bool PCT_CompileScript(PCT_Asset *asset) {
+    lua_State *L = luaL_newstate();
+    if (L == NULL) {
+        return false;
+    }
+    bool compiled = luaL_loadfile(L, asset->path) == LUA_OK;
+    if (!compiled) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", lua_tostring(L, -1));
+    } else {
+        PCT_ChunkWriter writer = {0};
+        compiled = lua_dump(L, PCT_WriteChunk, &writer, 0) == 0;
+        asset->chunk = writer.data;
+        asset->chunkSize = writer.size;
+    }
+    lua_close(L);
+    return compiled;
+}
+
+static int PCT_AssetWorker(void *data) {
+    PCT_AssetManager *manager = data;
+
+    SDL_LockMutex(manager->lock);
+    for (;;) {
+        while (!manager->shuttingDown && manager->loadCount == 0) {
+            SDL_WaitCondition(manager->workReady, manager->lock);
+        }
+        if (manager->shuttingDown) {
+            break;
+        }
+        PCT_Asset *asset = manager->assets + manager->loadQueue[manager->loadHead];
+        manager->loadHead = (manager->loadHead + 1) % PCT_ASSET_MAX;
+        manager->loadCount--;
+        bool wanted = asset->refCount > 0;
+        SDL_UnlockMutex(manager->lock);
+
+        // Asset fields are owned by this worker until the state leaves QUEUED.
+        bool loaded = false;
+        if (wanted) {
+            switch (asset->type) {
+            case PCT_ASSET_TEXTURE:
+                asset->surface = SDL_LoadBMP(asset->path);
+                loaded = asset->surface != NULL;
+                if (!loaded) {
+                    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to load %s: %s", asset->path,
+                                 SDL_GetError());
+                }
+                break;
+            case PCT_ASSET_SCRIPT:
+                loaded = PCT_CompileScript(asset);
+                break;
+            case PCT_ASSET_MAP:
+                asset->map = PCT_MapCacheAcquire(manager->mapCache, asset->path);
+                loaded = asset->map != NULL;
+                break;
+            }
+        }
+
+        SDL_LockMutex(manager->lock);
+        if (asset->refCount == 0) {
+            PCT_FreeAsset(manager, asset);
+        } else if (loaded && asset->type == PCT_ASSET_TEXTURE) {
+            size_t tail = (manager->uploadHead + manager->uploadCount) % PCT_ASSET_MAX;
+            manager->uploadQueue[tail] = (uint32_t)(asset - manager->assets);
+            manager->uploadCount++;
+            SDL_AtomicSet(&asset->state, PCT_ASSET_STATE_DECODED);
+        } else {
+            SDL_AtomicSet(&asset->state, loaded ? PCT_ASSET_STATE_READY : PCT_ASSET_STATE_FAILED);
+        }
+        SDL_BroadcastCondition(manager->assetLoaded);
+    }
+    SDL_UnlockMutex(manager->lock);
+    return 0;
+}
+
+static SDL_Texture *PCT_CreatePlaceholderTexture(SDL_Renderer *renderer) {
+    SDL_Surface *surface =
+        SDL_CreateSurface(PCT_PLACEHOLDER_SIZE, PCT_PLACEHOLDER_SIZE, SDL_PIXELFORMAT_RGBA8888);
+    if (surface == NULL) {
+        return NULL;
+    }
+    for (Sint32 y = 0; y < PCT_PLACEHOLDER_SIZE; y++) {
+        Uint32 *row = (Uint32 *)((uint8_t *)surface->pixels + y * surface->pitch);
+        for (Sint32 x = 0; x < PCT_PLACEHOLDER_SIZE; x++) {
+            bool odd = ((x / PCT_PLACEHOLDER_TILE) + (y / PCT_PLACEHOLDER_TILE)) % 2;
+            row[x] = odd ? 0xFF00FFFF : 0x000000FF;
+        }
+    }
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_DestroySurface(surface);
+    return texture;
+}
+
+PCT_AssetManager *PCT_CreateAssetManager(SDL_Renderer *renderer, PCT_MapCache *mapCache,
+                                         size_t threadCount) {
+    if (threadCount == 0) {
+        Sint32 cpuCount = SDL_GetCPUCount();
+        threadCount = cpuCount > 2 ? (size_t)cpuCount - 1 : 1;
+    }
+    PCT_AssetManager *manager = calloc(1, sizeof(PCT_AssetManager));
+    if (manager != NULL) {
+        manager->workers = calloc(threadCount, sizeof(SDL_Thread *));
+        manager->lock = SDL_CreateMutex();
+        manager->workReady = SDL_CreateCondition();
+        manager->assetLoaded = SDL_CreateCondition();
+    }
+    if (manager == NULL || manager->workers == NULL || manager->lock == NULL ||
+        manager->workReady == NULL || manager->assetLoaded == NULL) {
+        printf("Failed to allocate asset manager.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    manager->renderer = renderer;
+    manager->mapCache = mapCache;
+    manager->placeholder = renderer != NULL ? PCT_CreatePlaceholderTexture(renderer) : NULL;
+    for (size_t i = 0; i < threadCount; i++) {
+        manager->workers[i] = SDL_CreateThread(PCT_AssetWorker, "PCT_AssetLoader", manager);
+        if (manager->workers[i] == NULL) {
+            SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to create loader: %s", SDL_GetError());
+            break;
+        }
+        manager->workerCount++;
+    }
+    if (manager->workerCount == 0) {
+        printf("Failed to start any asset loader.\n");
+        exit(PCT_EXIT_CODE_INVALID_OPERATION);
+    }
+    return manager;
+}
+
+void PCT_DestroyAssetManager(PCT_AssetManager *manager) {
+    if (manager == NULL) {
+        return;
+    }
+    SDL_LockMutex(manager->lock);
+    manager->shuttingDown = true;
+    SDL_BroadcastCondition(manager->workReady);
+    SDL_UnlockMutex(manager->lock);
+    for (size_t i = 0; i < manager->workerCount; i++) {
+        SDL_WaitThread(manager->workers[i], NULL);
+    }
+    for (size_t i = 0; i < PCT_ASSET_MAX; i++) {
+        if (SDL_AtomicGet(&manager->assets[i].state) != PCT_ASSET_STATE_FREE) {
+            PCT_FreeAsset(manager, manager->assets + i);
+        }
+    }
+    if (manager->placeholder != NULL) {
+        SDL_DestroyTexture(manager->placeholder);
+    }
+    SDL_DestroyCondition(manager->assetLoaded);
+    SDL_DestroyCondition(manager->workReady);
+    SDL_DestroyMutex(manager->lock);
+    free(manager->workers);
+    free(manager);
+}
+
+static PCT_AssetHandle PCT_RequestAsset(PCT_AssetManager *manager, const PCT_AssetType type,
+                                        const char *path) {
+    assert(manager != NULL);
+    assert(path != NULL);
+
+    SDL_LockMutex(manager->lock);
+    PCT_Asset *freeSlot = NULL;
+    for (size_t i = 0; i < PCT_ASSET_MAX; i++) {
+        PCT_Asset *asset = manager->assets + i;
+        if (asset->refCount > 0 && asset->type == type &&
+            strncmp(asset->path, path, PCT_ASSET_PATH_MAX - 1) == 0) {
+            asset->refCount++;
+            SDL_UnlockMutex(manager->lock);
+            return (PCT_AssetHandle){.index = (uint32_t)i + 1, .generation = asset->generation};
+        }
+        if (freeSlot == NULL && SDL_AtomicGet(&asset->state) == PCT_ASSET_STATE_FREE) {
+            freeSlot = asset;
+        }
+    }
+    if (freeSlot == NULL) {
+        SDL_UnlockMutex(manager->lock);
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "No free asset slot for %s", path);
+        return (PCT_AssetHandle){0};
+    }
+
+    freeSlot->type = type;
+    strncpy(freeSlot->path, path, PCT_ASSET_PATH_MAX - 1);
+    freeSlot->refCount = 1;
+    SDL_AtomicSet(&freeSlot->state, PCT_ASSET_STATE_QUEUED);
+    uint32_t index = (uint32_t)(freeSlot - manager->assets);
+    manager->loadQueue[(manager->loadHead + manager->loadCount) % PCT_ASSET_MAX] = index;
+    manager->loadCount++;
+    SDL_SignalCondition(manager->workReady);
+    SDL_UnlockMutex(manager->lock);
+    return (PCT_AssetHandle){.index = index + 1, .generation = freeSlot->generation};
+}
+
+PCT_AssetHandle PCT_RequestTexture(PCT_AssetManager *manager, const char *path) {
+    return PCT_RequestAsset(manager, PCT_ASSET_TEXTURE, path);
+}
+
+PCT_AssetHandle PCT_RequestScript(PCT_AssetManager *manager, const char *path) {
+    return PCT_RequestAsset(manager, PCT_ASSET_SCRIPT, path);
+}
+
+PCT_AssetHandle PCT_RequestMap(PCT_AssetManager *manager, const char *mapName) {
+    return PCT_RequestAsset(manager, PCT_ASSET_MAP, mapName);
+}
+
+void PCT_ReleaseAsset(PCT_AssetManager *manager, const PCT_AssetHandle handle) {
+    assert(manager != NULL);
+
+    SDL_LockMutex(manager->lock);
+    PCT_Asset *asset = PCT_AssetFromHandle(manager, handle);
+    if (asset != NULL && --asset->refCount == 0) {
+        // Queued and decoded assets are still referenced by a worker or the upload queue, which
+        // free them once they see the dropped reference.
+        PCT_AssetState state = SDL_AtomicGet(&asset->state);
+        if (state == PCT_ASSET_STATE_READY || state == PCT_ASSET_STATE_FAILED) {
+            PCT_FreeAsset(manager, asset);
+        }
+    }
+    SDL_UnlockMutex(manager->lock);
+}
+
+PCT_AssetState PCT_GetAssetState(const PCT_AssetManager *manager, const PCT_AssetHandle handle) {
+    PCT_Asset *asset = PCT_AssetFromHandle(manager, handle);
+    return asset != NULL ? (PCT_AssetState)SDL_AtomicGet(&asset->state) : PCT_ASSET_STATE_FREE;
+}
+
+void PCT_WaitForAssets(PCT_AssetManager *manager, const PCT_AssetHandle *handles,
+                       const size_t count) {
+    assert(manager != NULL);
+
+    SDL_LockMutex(manager->lock);
+    for (size_t i = 0; i < count; i++) {
+        while (PCT_GetAssetState(manager, handles[i]) == PCT_ASSET_STATE_QUEUED) {
+            SDL_WaitCondition(manager->assetLoaded, manager->lock);
+        }
+    }
+    SDL_UnlockMutex(manager->lock);
+}
+
+void PCT_AssetManagerUpdate(PCT_AssetManager *manager, const Uint64 budgetNs) {
+    assert(manager != NULL);
+
+    Uint64 start = SDL_GetTicksNS();
+    do {
+        SDL_LockMutex(manager->lock);
+        if (manager->uploadCount == 0) {
+            SDL_UnlockMutex(manager->lock);
+            break;
+        }
+        PCT_Asset *asset = manager->assets + manager->uploadQueue[manager->uploadHead];
+        manager->uploadHead = (manager->uploadHead + 1) % PCT_ASSET_MAX;
+        manager->uploadCount--;
+        if (asset->refCount == 0) {
+            PCT_FreeAsset(manager, asset);
+            SDL_UnlockMutex(manager->lock);
+            continue;
+        }
+        SDL_UnlockMutex(manager->lock);
+
+        asset->texture = SDL_CreateTextureFromSurface(manager->renderer, asset->surface);
+        SDL_DestroySurface(asset->surface);
+        asset->surface = NULL;
+        if (asset->texture == NULL) {
+            SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to upload %s: %s", asset->path,
+                         SDL_GetError());
+        }
+        SDL_AtomicSet(&asset->state, asset->texture != NULL ? PCT_ASSET_STATE_READY
+                                                            : PCT_ASSET_STATE_FAILED);
+    } while (SDL_GetTicksNS() - start < budgetNs);
+}
+
+SDL_Texture *PCT_GetTexture(const PCT_AssetManager *manager, const PCT_AssetHandle handle) {
+    PCT_Asset *asset = PCT_AssetFromHandle(manager, handle);
+    if (asset == NULL || asset->type != PCT_ASSET_TEXTURE ||
+        SDL_AtomicGet(&asset->state) != PCT_ASSET_STATE_READY) {
+        return manager->placeholder;
+    }
+    return asset->texture;
+}
+
+const PCT_Map *PCT_GetMap(const PCT_AssetManager *manager, const PCT_AssetHandle handle) {
+    PCT_Asset *asset = PCT_AssetFromHandle(manager, handle);
+    if (asset == NULL || asset->type != PCT_ASSET_MAP ||
+        SDL_AtomicGet(&asset->state) != PCT_ASSET_STATE_READY) {
+        return NULL;
+    }
+    return asset->map;
+}
+
+int32_t PCT_RunScript(const PCT_AssetManager *manager, const PCT_AssetHandle handle,
+                      lua_State *L) {
+    PCT_Asset *asset = PCT_AssetFromHandle(manager, handle);
+    if (asset == NULL || asset->type != PCT_ASSET_SCRIPT ||
+        SDL_AtomicGet(&asset->state) != PCT_ASSET_STATE_READY) {
+        return LUA_ERRFILE;
+    }
+    int32_t status =
+        luaL_loadbuffer(L, (const char *)asset->chunk, asset->chunkSize, asset->path);
+    if (status != LUA_OK) {
+        return status;
+    }
+    return lua_pcall(L, 0, LUA_MULTRET, 0);
+}
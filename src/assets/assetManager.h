@@ -0,0 +1,129 @@
+/**
+ * @file assetManager.h
+ * Reference counted assets loaded in the background. Files are read, decoded and compiled on
+ * worker threads, textures are then uploaded on the main thread within a per frame budget.
+ * Until a texture is uploaded a placeholder is handed out instead.
+ */
+#if !defined(PCT_ASSET_MANAGER)
+#define PCT_ASSET_MANAGER
+
+#include "../game/world.h"
+#include "../scripting.h"
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef PCT_ASSET_MAX
+#define PCT_ASSET_MAX 1024
+#endif
+
+#define PCT_ASSET_PATH_MAX 256
+#define PCT_ASSET_UPLOAD_BUDGET_NS SDL_MS_TO_NS(2)
+
+typedef enum { PCT_ASSET_TEXTURE, PCT_ASSET_SCRIPT, PCT_ASSET_MAP } PCT_AssetType;
+
+typedef enum {
+    PCT_ASSET_STATE_FREE,
+    PCT_ASSET_STATE_QUEUED,
+    PCT_ASSET_STATE_DECODED,
+    PCT_ASSET_STATE_READY,
+    PCT_ASSET_STATE_FAILED
+} PCT_AssetState;
+
+/**
+ * @brief Refers to a slot, generation tells a released and reused slot apart.
+ * Zero value is never a valid handle.
+ */
+typedef struct {
+    uint32_t index;
+    uint32_t generation;
+} PCT_AssetHandle;
+
+typedef struct {
+    PCT_AssetType type;
+    char path[PCT_ASSET_PATH_MAX];
+    SDL_AtomicInt state;
+    uint32_t generation;
+    size_t refCount;
+    SDL_Surface *surface;
+    SDL_Texture *texture;
+    uint8_t *chunk;
+    size_t chunkSize;
+    const PCT_Map *map;
+} PCT_Asset;
+
+typedef struct {
+    PCT_Asset assets[PCT_ASSET_MAX];
+    SDL_Mutex *lock;
+    SDL_Condition *workReady;
+    SDL_Condition *assetLoaded;
+    uint32_t loadQueue[PCT_ASSET_MAX];
+    size_t loadHead;
+    size_t loadCount;
+    uint32_t uploadQueue[PCT_ASSET_MAX];
+    size_t uploadHead;
+    size_t uploadCount;
+    SDL_Thread **workers;
+    size_t workerCount;
+    bool shuttingDown;
+    SDL_Renderer *renderer;
+    SDL_Texture *placeholder;
+    PCT_MapCache *mapCache;
+} PCT_AssetManager;
+
+/**
+ * @brief Starts threadCount loader threads, 0 picks one less than the number of CPUs.
+ * Maps are loaded through mapCache. User should call PCT_DestroyAssetManager to free it.
+ */
+PCT_AssetManager *PCT_CreateAssetManager(SDL_Renderer *renderer, PCT_MapCache *mapCache,
+                                         size_t threadCount);
+void PCT_DestroyAssetManager(PCT_AssetManager *manager);
+
+/**
+ * @brief Queues asset for loading or references the already requested one with the same path.
+ * Every request has to be matched by PCT_ReleaseAsset.
+ * @return handle with zero index when no slot is free
+ */
+PCT_AssetHandle PCT_RequestTexture(PCT_AssetManager *manager, const char *path);
+PCT_AssetHandle PCT_RequestScript(PCT_AssetManager *manager, const char *path);
+PCT_AssetHandle PCT_RequestMap(PCT_AssetManager *manager, const char *mapName);
+
+/**
+ * @brief Drops a reference, the last one frees the asset. Main thread only, as textures may be
+ * destroyed.
+ */
+void PCT_ReleaseAsset(PCT_AssetManager *manager, PCT_AssetHandle handle);
+
+PCT_AssetState PCT_GetAssetState(const PCT_AssetManager *manager, PCT_AssetHandle handle);
+
+/**
+ * @brief Blocks until none of the handles is queued anymore. Must not wait for textures, those
+ * are finished by PCT_AssetManagerUpdate.
+ */
+void PCT_WaitForAssets(PCT_AssetManager *manager, const PCT_AssetHandle *handles, size_t count);
+
+/**
+ * @brief Uploads decoded textures until budgetNs elapses, at least one per call.
+ * Call once per frame on the main thread.
+ */
+void PCT_AssetManagerUpdate(PCT_AssetManager *manager, Uint64 budgetNs);
+
+/**
+ * @return uploaded texture or placeholder while it is loading or when it failed
+ */
+SDL_Texture *PCT_GetTexture(const PCT_AssetManager *manager, PCT_AssetHandle handle);
+
+/**
+ * @return map once loaded, NULL before
+ */
+const PCT_Map *PCT_GetMap(const PCT_AssetManager *manager, PCT_AssetHandle handle);
+
+/**
+ * @brief Runs precompiled script in L, leaving its results on the stack.
+ * @return Lua status, LUA_ERRFILE when the script is not loaded, error message is on the stack
+ * for other errors
+ */
+int32_t PCT_RunScript(const PCT_AssetManager *manager, PCT_AssetHandle handle, lua_State *L);
+
+#endif // PCT_ASSET_MANAGER
@@ -0,0 +1,245 @@
+#include "animation.h"
+#include "../misc/errors.h"
+#include "../scripting.h"
+#include <SDL3/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PCT_ANIMATION_MAX_FRAMES 256
+
+PCT_AnimationLibrary *PCT_CreateAnimationLibrary(void) {
+    PCT_AnimationLibrary *library = calloc(1, sizeof(PCT_AnimationLibrary));
+    if (library == NULL) {
+        printf("Failed to allocate animation library.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    return library;
+}
+
+void PCT_DestroyAnimationLibrary(PCT_AnimationLibrary *library) {
+    if (library == NULL) {
+        return;
+    }
+    free(library->clips);
+    free(library->frames);
+    free(library);
+}
+
+uint16_t PCT_AddAnimationClip(PCT_AnimationLibrary *library, const char *name,
+                              const PCT_AnimationFrame *frames, const size_t frameCount,
+                              const bool looping) {
+    assert(library != NULL);
+    assert(name != NULL);
+
+    if (frameCount == 0 || library->clipCount >= PCT_ANIMATION_NO_CLIP) {
+        return PCT_ANIMATION_NO_CLIP;
+    }
+    if (library->clipCount == library->clipCapacity) {
+        size_t capacity = library->clipCapacity > 0 ? library->clipCapacity * 2 : 8;
+        PCT_AnimationClip *clips = realloc(library->clips, sizeof(PCT_AnimationClip) * capacity);
+        if (clips == NULL) {
+            printf("Failed to grow animation clips.\n");
+            exit(PCT_EXIT_CODE_MEMORY_ERROR);
+        }
+        library->clips = clips;
+        library->clipCapacity = capacity;
+    }
+    if (library->frameCount + frameCount > library->frameCapacity) {
+        size_t capacity = library->frameCapacity > 0 ? library->frameCapacity * 2 : 32;
+        while (capacity < library->frameCount + frameCount) {
+            capacity *= 2;
+        }
+        PCT_AnimationFrame *grown =
+            realloc(library->frames, sizeof(PCT_AnimationFrame) * capacity);
+        if (grown == NULL) {
+            printf("Failed to grow animation frames.\n");
+            exit(PCT_EXIT_CODE_MEMORY_ERROR);
+        }
+        library->frames = grown;
+        library->frameCapacity = capacity;
+    }
+
+    PCT_AnimationClip *clip = library->clips + library->clipCount;
+    *clip = (PCT_AnimationClip){.firstFrame = (uint32_t)library->frameCount,
+                                .frameCount = (uint32_t)frameCount,
+                                .looping = looping};
+    strncpy(clip->name, name, PCT_ANIMATION_CLIP_NAME_MAX - 1);
+    for (size_t i = 0; i < frameCount; i++) {
+        PCT_AnimationFrame frame = frames[i];
+        frame.durationMs = frame.durationMs > 0 ? frame.durationMs : 1;
+        clip->durationMs += frame.durationMs;
+        library->frames[library->frameCount++] = frame;
+    }
+    return (uint16_t)library->clipCount++;
+}
+
+static lua_Integer PCT_LuaIntegerField(lua_State *L, const int32_t table, const char *name,
+                                       const lua_Integer fallback) {
+    lua_Integer value = fallback;
+    if (lua_getfield(L, table, name) == LUA_TNUMBER) {
+        value = lua_tointeger(L, -1);
+    }
+    lua_pop(L, 1);
+    return value;
+}
+
+static size_t PCT_ReadAnimationFrames(lua_State *L, const int32_t clipTable,
+                                      PCT_AnimationFrame *frames) {
+    size_t frameCount = 0;
+    if (lua_getfield(L, clipTable, "frames") == LUA_TTABLE) {
+        int32_t framesTable = lua_gettop(L);
+        size_t length = lua_rawlen(L, framesTable);
+        for (size_t i = 1; i <= length && frameCount < PCT_ANIMATION_MAX_FRAMES; i++) {
+            if (lua_geti(L, framesTable, (lua_Integer)i) == LUA_TTABLE) {
+                int32_t frameTable = lua_gettop(L);
+                frames[frameCount++] = (PCT_AnimationFrame){
+                    .x = (int32_t)PCT_LuaIntegerField(L, frameTable, "x", 0),
+                    .y = (int32_t)PCT_LuaIntegerField(L, frameTable, "y", 0),
+                    .w = (int32_t)PCT_LuaIntegerField(L, frameTable, "w", 0),
+                    .h = (int32_t)PCT_LuaIntegerField(L, frameTable, "h", 0),
+                    .durationMs = (uint32_t)PCT_LuaIntegerField(L, frameTable, "ms", 0)};
+            }
+            lua_pop(L, 1);
+        }
+    }
+    lua_pop(L, 1);
+
+    if (frameCount == 0 && lua_getfield(L, clipTable, "strip") == LUA_TTABLE) {
+        int32_t strip = lua_gettop(L);
+        int32_t x = (int32_t)PCT_LuaIntegerField(L, strip, "x", 0);
+        int32_t y = (int32_t)PCT_LuaIntegerField(L, strip, "y", 0);
+        int32_t w = (int32_t)PCT_LuaIntegerField(L, strip, "w", 0);
+        int32_t h = (int32_t)PCT_LuaIntegerField(L, strip, "h", 0);
+        lua_Integer columns = PCT_LuaIntegerField(L, strip, "columns", 1);
+        lua_Integer count = PCT_LuaIntegerField(L, strip, "count", 1);
+        uint32_t durationMs = (uint32_t)PCT_LuaIntegerField(L, strip, "ms", 0);
+        columns = columns > 0 ? columns : 1;
+        for (lua_Integer i = 0; i < count && frameCount < PCT_ANIMATION_MAX_FRAMES; i++) {
+            frames[frameCount++] = (PCT_AnimationFrame){.x = x + w * (int32_t)(i % columns),
+                                                        .y = y + h * (int32_t)(i / columns),
+                                                        .w = w,
+                                                        .h = h,
+                                                        .durationMs = durationMs};
+        }
+        lua_pop(L, 1);
+    } else if (frameCount == 0) {
+        lua_pop(L, 1);
+    }
+    return frameCount;
+}
+
+size_t PCT_ReadAnimationClips(lua_State *L, const int32_t tableIndex,
+                              PCT_AnimationLibrary *library, const char *source) {
+    assert(L != NULL);
+    assert(library != NULL);
+
+    if (lua_type(L, tableIndex) != LUA_TTABLE) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s does not return a table of clips", source);
+        return 0;
+    }
+    PCT_AnimationFrame frames[PCT_ANIMATION_MAX_FRAMES];
+    int32_t top = lua_gettop(L);
+    int32_t clipsTable = tableIndex < 0 ? top + tableIndex + 1 : tableIndex;
+    size_t length = lua_rawlen(L, clipsTable);
+    size_t added = 0;
+    for (size_t i = 1; i <= length; i++) {
+        if (lua_geti(L, clipsTable, (lua_Integer)i) == LUA_TTABLE) {
+            int32_t clipTable = lua_gettop(L);
+            lua_getfield(L, clipTable, "name");
+            const char *name = lua_tostring(L, -1);
+            lua_getfield(L, clipTable, "loop");
+            bool looping = lua_toboolean(L, -1);
+            lua_pop(L, 1);
+            size_t frameCount = PCT_ReadAnimationFrames(L, clipTable, frames);
+            if (name != NULL && PCT_AddAnimationClip(library, name, frames, frameCount,
+                                                     looping) != PCT_ANIMATION_NO_CLIP) {
+                added++;
+            } else {
+                SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s: skipping malformed clip %zu", source,
+                             i);
+            }
+        }
+        lua_settop(L, top);
+    }
+    return added;
+}
+
+size_t PCT_LoadAnimationClips(PCT_LuaScriptingContext *ctx, PCT_AnimationLibrary *library,
+                              const char *scriptPath) {
+    assert(ctx != NULL);
+    assert(scriptPath != NULL);
+
+    lua_State *L = ctx->L;
+    int32_t top = lua_gettop(L);
+    size_t added = 0;
+    if (luaL_dofile(L, scriptPath) != LUA_OK) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s", lua_tostring(L, -1));
+    } else if (lua_gettop(L) > top) {
+        added = PCT_ReadAnimationClips(L, top + 1, library, scriptPath);
+    }
+    lua_settop(L, top);
+    return added;
+}
+
+uint16_t PCT_FindAnimationClip(const PCT_AnimationLibrary *library, const char *name) {
+    assert(library != NULL);
+    assert(name != NULL);
+
+    for (size_t i = 0; i < library->clipCount; i++) {
+        if (strncmp(library->clips[i].name, name, PCT_ANIMATION_CLIP_NAME_MAX - 1) == 0) {
+            return (uint16_t)i;
+        }
+    }
+    return PCT_ANIMATION_NO_CLIP;
+}
+
+void PCT_PlayAnimation(PCT_Animator *animator, const uint16_t clip) {
+    if (animator->clip == clip) {
+        return;
+    }
+    *animator = (PCT_Animator){.clip = clip};
+}
+
+void PCT_AdvanceAnimators(const PCT_AnimationLibrary *library, PCT_Animator *animators,
+                          const size_t count, const uint32_t deltaTimeMs, SDL_FRect *sources) {
+    assert(library != NULL);
+    assert(animators != NULL || count == 0);
+
+    for (size_t i = 0; i < count; i++) {
+        PCT_Animator *animator = animators + i;
+        if (animator->clip >= library->clipCount) {
+            if (sources != NULL) {
+                sources[i] = (SDL_FRect){0};
+            }
+            continue;
+        }
+        const PCT_AnimationClip *clip = library->clips + animator->clip;
+        const PCT_AnimationFrame *frames = library->frames + clip->firstFrame;
+        uint32_t frameTimeMs = animator->frameTimeMs + deltaTimeMs;
+        uint32_t frame = animator->frame;
+        // Whole loops land on the same frame, skip them so long hitches cost nothing extra.
+        if (clip->looping && frameTimeMs >= clip->durationMs) {
+            frameTimeMs %= clip->durationMs;
+        }
+        while (!animator->finished && frameTimeMs >= frames[frame].durationMs) {
+            frameTimeMs -= frames[frame].durationMs;
+            if (++frame == clip->frameCount) {
+                if (clip->looping) {
+                    frame = 0;
+                } else {
+                    frame = clip->frameCount - 1;
+                    animator->finished = true;
+                }
+            }
+        }
+        animator->frame = (uint16_t)frame;
+        animator->frameTimeMs = animator->finished ? 0 : frameTimeMs;
+        if (sources != NULL) {
+            const PCT_AnimationFrame *current = frames + frame;
+            sources[i] = (SDL_FRect){(float)current->x, (float)current->y, (float)current->w,
+                                     (float)current->h};
+        }
+    }
+}
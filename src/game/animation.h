@@ -0,0 +1,109 @@
+/**
+ * @file animation.h
+ * Data driven sprite animation. Clips are shared definitions loaded from Lua, every animated
+ * object only keeps a small PCT_Animator and all of them are advanced in one batched pass.
+ */
+#if !defined(PCT_ANIMATION)
+#define PCT_ANIMATION
+
+#include "../scripting.h"
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PCT_ANIMATION_CLIP_NAME_MAX 32
+#define PCT_ANIMATION_NO_CLIP UINT16_MAX
+
+/**
+ * @brief Source rect of one frame in the sprite sheet, shown for durationMs.
+ */
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t w;
+    int32_t h;
+    uint32_t durationMs;
+} PCT_AnimationFrame;
+
+typedef struct {
+    char name[PCT_ANIMATION_CLIP_NAME_MAX];
+    uint32_t firstFrame;
+    uint32_t frameCount;
+    uint32_t durationMs;
+    bool looping;
+} PCT_AnimationClip;
+
+/**
+ * @brief All clip definitions, frames of every clip are stored contiguously in frames.
+ */
+typedef struct {
+    PCT_AnimationClip *clips;
+    size_t clipCount;
+    size_t clipCapacity;
+    PCT_AnimationFrame *frames;
+    size_t frameCount;
+    size_t frameCapacity;
+} PCT_AnimationLibrary;
+
+/**
+ * @brief Per object playback state.
+ */
+typedef struct {
+    uint16_t clip;
+    uint16_t frame;
+    uint32_t frameTimeMs;
+    bool finished;
+} PCT_Animator;
+
+/**
+ * @brief Creates empty library. User should call PCT_DestroyAnimationLibrary to free it.
+ */
+PCT_AnimationLibrary *PCT_CreateAnimationLibrary(void);
+void PCT_DestroyAnimationLibrary(PCT_AnimationLibrary *library);
+
+/**
+ * @brief Copies frames into a new clip, frames shorter than 1 ms are stretched to 1 ms.
+ * @return clip index or PCT_ANIMATION_NO_CLIP when frameCount is 0 or the library is full
+ */
+uint16_t PCT_AddAnimationClip(PCT_AnimationLibrary *library, const char *name,
+                              const PCT_AnimationFrame *frames, size_t frameCount, bool looping);
+
+/**
+ * @brief Adds clips returned by a Lua script as an array of tables
+ * { name = "run", loop = true, frames = { { x = 0, y = 0, w = 32, h = 32, ms = 64 }, ... } }.
+ * Instead of frames a clip may give a sheet strip
+ * strip = { x = 0, y = 0, w = 32, h = 32, columns = 3, count = 6, ms = 64 }.
+ * @return number of clips added, malformed clips are skipped
+ */
+size_t PCT_LoadAnimationClips(PCT_LuaScriptingContext *ctx, PCT_AnimationLibrary *library,
+                              const char *scriptPath);
+
+/**
+ * @brief Adds clips from a table already on the Lua stack, in the format described at
+ * PCT_LoadAnimationClips. Stack is left as it was.
+ * @param source name used in error messages
+ */
+size_t PCT_ReadAnimationClips(lua_State *L, int32_t tableIndex, PCT_AnimationLibrary *library,
+                              const char *source);
+
+/**
+ * @return clip index or PCT_ANIMATION_NO_CLIP when no clip has that name
+ */
+uint16_t PCT_FindAnimationClip(const PCT_AnimationLibrary *library, const char *name);
+
+/**
+ * @brief Switches animator to clip, restarting it only when the clip changes.
+ */
+void PCT_PlayAnimation(PCT_Animator *animator, uint16_t clip);
+
+/**
+ * @brief Advances count animators by deltaTimeMs and writes their current frame rects into
+ * sources, which is usually the sources array of a sprite batch. Animators without a clip get
+ * an empty rect.
+ * @param sources count rects or NULL when only playback state should advance
+ */
+void PCT_AdvanceAnimators(const PCT_AnimationLibrary *library, PCT_Animator *animators,
+                          size_t count, uint32_t deltaTimeMs, SDL_FRect *sources);
+
+#endif // PCT_ANIMATION
@@ -2,6 +2,10 @@
 #include "math.h"
 #include <cglm/cglm.h>
 
+PCT_AaBb PCT_MoveBox(const PCT_AaBb *box, const PCT_Vector *vec) {
+    return (PCT_AaBb){box->x1 + vec->x, box->y1 + vec->y, box->x2 + vec->x, box->y2 + vec->y};
+}
+
 bool PCT_AaBbCollisionTest(const PCT_AaBb *first, const PCT_AaBb *second, PCT_Collision *collisionResult) {
     float firstWidthHalf = (first->x2 - first->x1) / 2.0f;
     float firstHeightHalf = (first->y2 - first->y1) / 2.0;
@@ -30,3 +34,65 @@ bool PCT_AaBbCollisionTest(const PCT_AaBb *first, const PCT_AaBb *second, PCT_Co
     }
     return false;
 }
+
+bool PCT_AaBbSweepTest(const PCT_AaBb *first, const PCT_Vector *motion, const PCT_AaBb *second,
+                       float *timeOfImpact, PCT_Collision *collisionResult) {
+    if (motion->x == 0.0f && motion->y == 0.0f) {
+        return false;
+    }
+
+    float entryX, exitX, entryY, exitY;
+    if (motion->x > 0.0f) {
+        entryX = (second->x1 - first->x2) / motion->x;
+        exitX = (second->x2 - first->x1) / motion->x;
+    } else if (motion->x < 0.0f) {
+        entryX = (second->x2 - first->x1) / motion->x;
+        exitX = (second->x1 - first->x2) / motion->x;
+    } else {
+        if (first->x2 <= second->x1 || first->x1 >= second->x2) {
+            return false;
+        }
+        entryX = -INFINITY;
+        exitX = INFINITY;
+    }
+    if (motion->y > 0.0f) {
+        entryY = (second->y1 - first->y2) / motion->y;
+        exitY = (second->y2 - first->y1) / motion->y;
+    } else if (motion->y < 0.0f) {
+        entryY = (second->y2 - first->y1) / motion->y;
+        exitY = (second->y1 - first->y2) / motion->y;
+    } else {
+        if (first->y2 <= second->y1 || first->y1 >= second->y2) {
+            return false;
+        }
+        entryY = -INFINITY;
+        exitY = INFINITY;
+    }
+
+    float entry = fmaxf(entryX, entryY);
+    float exit = fminf(exitX, exitY);
+    if (entry > exit || entry > 1.0f || exit <= 0.0f) {
+        return false;
+    }
+
+    // Ties go to the vertical axis so boxes running over floor seams land instead of snagging.
+    bool hitX = entryX > entryY;
+    if (entry < 0.0f) {
+        // Already overlapping, only accept it as a contact when the overlap is within the skin.
+        float depth = -entry * fabsf(hitX ? motion->x : motion->y);
+        if (depth > PCT_SWEEP_SKIN) {
+            return false;
+        }
+        entry = 0.0f;
+    }
+
+    if (timeOfImpact != NULL) {
+        *timeOfImpact = entry;
+    }
+    if (collisionResult != NULL) {
+        collisionResult->normal[0] = hitX ? (motion->x > 0.0f ? -1.0f : 1.0f) : 0.0f;
+        collisionResult->normal[1] = hitX ? 0.0f : (motion->y > 0.0f ? -1.0f : 1.0f);
+        collisionResult->distance = entry * sqrtf(motion->x * motion->x + motion->y * motion->y);
+    }
+    return true;
+}
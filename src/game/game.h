@@ -26,6 +26,22 @@ typedef struct {
     float distance;
 } PCT_Collision;
 
+#ifndef PCT_SWEEP_SKIN
+#define PCT_SWEEP_SKIN 0.0001f
+#endif
+
+PCT_AaBb PCT_MoveBox(const PCT_AaBb *box, const PCT_Vector *vec);
 bool PCT_AaBbCollisionTest(const PCT_AaBb *first, const PCT_AaBb *second, PCT_Collision *collisionResult);
 
+/**
+ * @brief Sweeps first box along motion and finds the earliest contact with second box.
+ * Boxes already overlapping deeper than PCT_SWEEP_SKIN are not reported, resolve those with
+ * PCT_AaBbCollisionTest.
+ * @param timeOfImpact receives fraction of motion in [0, 1] travelled before the contact, may be NULL
+ * @param collisionResult receives contact normal and travelled distance, may be NULL
+ * @return true when boxes touch during the motion
+ */
+bool PCT_AaBbSweepTest(const PCT_AaBb *first, const PCT_Vector *motion, const PCT_AaBb *second,
+                       float *timeOfImpact, PCT_Collision *collisionResult);
+
 #endif // PCT_GAME_H
\ No newline at end of file
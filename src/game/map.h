@@ -0,0 +1,28 @@
+/**
+ * @file map.h
+ * Static level geometry shared read-only by everything that plays the level.
+ */
+#if !defined(PCT_MAP)
+#define PCT_MAP
+
+#include "../structures/structures.h"
+#include "navigation.h"
+#include <stddef.h>
+
+#define PCT_MAP_NAME_MAX 256
+
+/**
+ * @brief Immutable map data, shared between worlds through PCT_MapCache. Occupancy answers
+ * coarse probes in a few bit operations, tree resolves the exact rects. Navigation holds the
+ * surfaces enemies can reach, flow fields over it are kept per world.
+ */
+typedef struct {
+    char name[PCT_MAP_NAME_MAX];
+    PCT_KdTree *tree;
+    PCT_OccupancyGrid *occupancy;
+    PCT_NavGraph *navigation;
+    size_t rectCount;
+    size_t refCount;
+} PCT_Map;
+
+#endif // PCT_MAP
@@ -0,0 +1,609 @@
+#include "navigation.h"
+#include "../misc/errors.h"
+#include "../structures/structures.h"
+#include "game.h"
+#include "physics.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PCT_NAV_EPSILON 1e-5f
+
+typedef struct {
+    float x1;
+    float x2;
+    float y;
+} PCT_NavSpan;
+
+typedef struct {
+    PCT_NavSpan *spans;
+    size_t count;
+    size_t capacity;
+} PCT_NavSpanList;
+
+typedef struct {
+    PCT_NavLink *links;
+    size_t count;
+    size_t capacity;
+} PCT_NavLinkList;
+
+static void PCT_NavPushSpan(PCT_NavSpanList *list, const PCT_NavSpan *span) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        PCT_NavSpan *spans = realloc(list->spans, sizeof(PCT_NavSpan) * capacity);
+        if (spans == NULL) {
+            printf("Failed to grow navigation surfaces.\n");
+            exit(PCT_EXIT_CODE_MEMORY_ERROR);
+        }
+        list->spans = spans;
+        list->capacity = capacity;
+    }
+    list->spans[list->count++] = *span;
+}
+
+static void PCT_NavPushLink(PCT_NavLinkList *list, const PCT_NavLink *link) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        PCT_NavLink *links = realloc(list->links, sizeof(PCT_NavLink) * capacity);
+        if (links == NULL) {
+            printf("Failed to grow navigation links.\n");
+            exit(PCT_EXIT_CODE_MEMORY_ERROR);
+        }
+        list->links = links;
+        list->capacity = capacity;
+    }
+    list->links[list->count++] = *link;
+}
+
+static int PCT_CompareSpans(const void *first, const void *second) {
+    const PCT_NavSpan *a = first;
+    const PCT_NavSpan *b = second;
+    if (a->y != b->y) {
+        return a->y < b->y ? -1 : 1;
+    }
+    if (a->x1 != b->x1) {
+        return a->x1 < b->x1 ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Adds ranges of agent centers at which agent stands on top of rect with nothing in its
+ * box. Blocking rects are widened by the agent half width, so narrow ledges and walls next to the
+ * top are accounted for exactly.
+ */
+static void PCT_NavRectSurfaces(const PCT_AaBb *rect, const PCT_KdTree *tree,
+                                const PCT_NavAgent *agent, const PCT_AaBb ***found,
+                                size_t *foundCapacity, PCT_NavSpanList *blockers,
+                                PCT_NavSpanList *surfaces) {
+    float halfWidth = agent->halfWidth;
+    PCT_AaBb strip = {rect->x1 - halfWidth * 2, rect->y2, rect->x2 + halfWidth * 2,
+                      rect->y2 + agent->height};
+    size_t foundCount = PCT_KdTreeRangeQuery(tree, &strip, *found, *foundCapacity);
+    if (foundCount > *foundCapacity) {
+        const PCT_AaBb **grown = realloc(*found, sizeof(PCT_AaBb *) * foundCount);
+        if (grown == NULL) {
+            printf("Failed to grow navigation query.\n");
+            exit(PCT_EXIT_CODE_MEMORY_ERROR);
+        }
+        *found = grown;
+        *foundCapacity = foundCount;
+        PCT_KdTreeRangeQuery(tree, &strip, *found, *foundCapacity);
+    }
+
+    blockers->count = 0;
+    for (size_t i = 0; i < foundCount; i++) {
+        const PCT_AaBb *box = (*found)[i];
+        if (box->y1 < strip.y2 && box->y2 > strip.y1 && box->x1 < strip.x2 && box->x2 > strip.x1) {
+            PCT_NavPushSpan(blockers,
+                            &(PCT_NavSpan){box->x1 - halfWidth, box->x2 + halfWidth, 0.0f});
+        }
+    }
+    if (blockers->count > 1) {
+        qsort(blockers->spans, blockers->count, sizeof(PCT_NavSpan), PCT_CompareSpans);
+    }
+
+    float cursor = rect->x1 - halfWidth;
+    float end = rect->x2 + halfWidth;
+    for (size_t i = 0; i < blockers->count && cursor < end; i++) {
+        if (blockers->spans[i].x1 > cursor) {
+            float x2 = fminf(blockers->spans[i].x1, end);
+            PCT_NavPushSpan(surfaces, &(PCT_NavSpan){cursor, x2, rect->y2});
+        }
+        cursor = fmaxf(cursor, blockers->spans[i].x2);
+    }
+    if (cursor < end) {
+        PCT_NavPushSpan(surfaces, &(PCT_NavSpan){cursor, end, rect->y2});
+    }
+}
+
+static void PCT_NavNodeColumns(const PCT_NavGraph *graph, const PCT_NavNode *node, size_t *first,
+                               size_t *last) {
+    *first = (size_t)((node->x1 - PCT_NAV_FOOT_TOLERANCE - graph->columnOrigin) /
+                      PCT_NAV_COLUMN_WIDTH);
+    *last = (size_t)((node->x2 + PCT_NAV_FOOT_TOLERANCE - graph->columnOrigin) /
+                     PCT_NAV_COLUMN_WIDTH);
+}
+
+static void PCT_NavBuildColumns(PCT_NavGraph *graph) {
+    float end = 0.0f;
+    graph->columnOrigin = 0.0f;
+    for (size_t i = 0; i < graph->nodeCount; i++) {
+        const PCT_NavNode *node = graph->nodes + i;
+        if (i == 0 || node->x1 - PCT_NAV_FOOT_TOLERANCE < graph->columnOrigin) {
+            graph->columnOrigin = node->x1 - PCT_NAV_FOOT_TOLERANCE;
+        }
+        if (i == 0 || node->x2 + PCT_NAV_FOOT_TOLERANCE > end) {
+            end = node->x2 + PCT_NAV_FOOT_TOLERANCE;
+        }
+    }
+    graph->columnCount = (size_t)((end - graph->columnOrigin) / PCT_NAV_COLUMN_WIDTH) + 1;
+    graph->columnFirst = calloc(graph->columnCount + 1, sizeof(uint32_t));
+    if (graph->columnFirst == NULL) {
+        printf("Failed to allocate navigation columns.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+
+    // Count nodes per column, turn counts into offsets, then fill moving offsets back.
+    for (size_t i = 0; i < graph->nodeCount; i++) {
+        size_t first, last;
+        PCT_NavNodeColumns(graph, graph->nodes + i, &first, &last);
+        for (size_t column = first; column <= last && column < graph->columnCount; column++) {
+            graph->columnFirst[column + 1]++;
+        }
+    }
+    for (size_t column = 0; column < graph->columnCount; column++) {
+        graph->columnFirst[column + 1] += graph->columnFirst[column];
+    }
+    graph->columnNodes = malloc(sizeof(uint32_t) * (graph->columnFirst[graph->columnCount] + 1));
+    if (graph->columnNodes == NULL) {
+        printf("Failed to allocate navigation columns.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    for (size_t i = 0; i < graph->nodeCount; i++) {
+        size_t first, last;
+        PCT_NavNodeColumns(graph, graph->nodes + i, &first, &last);
+        for (size_t column = first; column <= last && column < graph->columnCount; column++) {
+            graph->columnNodes[graph->columnFirst[column]++] = (uint32_t)i;
+        }
+    }
+    for (size_t column = graph->columnCount; column > 0; column--) {
+        graph->columnFirst[column] = graph->columnFirst[column - 1];
+    }
+    graph->columnFirst[0] = 0;
+}
+
+/**
+ * @brief Moves agent from feet the way enemies move, running in direction with initial
+ * velocityY, until it lands after having been in the air. Feet start at the end of a node range,
+ * so walking more than a few steps means a wall or a flush neighbour and yields no landing.
+ * @return node landed on or PCT_NAV_NONE
+ */
+static uint32_t PCT_NavFly(const PCT_NavGraph *graph, const PCT_KdTree *tree,
+                           const PCT_Point *feet, float direction, float velocityY, float lowestY,
+                           float *landingX, float *timeS) {
+    const PCT_NavAgent *agent = &graph->agent;
+    const float deltaTimeS = PCT_NAV_STEP_MS / 1000.0f;
+    PCT_AaBb box = {feet->x - agent->halfWidth, feet->y, feet->x + agent->halfWidth,
+                    feet->y + agent->height};
+    bool airborne = false;
+    float walked = 0.0f;
+    for (int32_t step = 1; step * PCT_NAV_STEP_MS <= PCT_NAV_MAX_FLIGHT_MS; step++) {
+        PCT_Vector motion = {direction * agent->runSpeed * deltaTimeS,
+                             velocityY * deltaTimeS +
+                                 (agent->gravity / 2) * deltaTimeS * deltaTimeS};
+        PCT_SweepResult sweep = {0};
+        PCT_MoveAndSlide(tree, &box, &motion, &sweep);
+        box = PCT_MoveBox(&box, &sweep.motion);
+        if (sweep.contacts & PCT_CONTACT_GROUND) {
+            if (airborne) {
+                PCT_Point landing = {(box.x1 + box.x2) / 2, box.y1};
+                *landingX = landing.x;
+                *timeS = step * deltaTimeS;
+                return PCT_NavFindNode(graph, &landing);
+            }
+            velocityY = 0.0f;
+            walked += agent->runSpeed * deltaTimeS;
+            if (walked > PCT_NAV_ARRIVE_DISTANCE * 2) {
+                return PCT_NAV_NONE;
+            }
+        } else {
+            airborne = true;
+            velocityY += agent->gravity * deltaTimeS;
+            if (sweep.contacts & PCT_CONTACT_CEILING) {
+                velocityY = fminf(velocityY, -0.01f);
+            }
+        }
+        if (box.y2 < lowestY) {
+            return PCT_NAV_NONE;
+        }
+    }
+    return PCT_NAV_NONE;
+}
+
+/**
+ * @brief Adds link when agent leaving from takeoffX lands on another node. Agents start jumps
+ * anywhere within PCT_NAV_ARRIVE_DISTANCE past the takeoff, so a jump is only kept when both ends
+ * of that window land on the same node.
+ */
+static void PCT_NavTryLink(const PCT_NavGraph *graph, const PCT_KdTree *tree, uint32_t from,
+                           float takeoffX, float direction, PCT_NavLinkType type, float lowestY,
+                           PCT_NavLinkList *links) {
+    const PCT_NavAgent *agent = &graph->agent;
+    const PCT_NavNode *node = graph->nodes + from;
+    PCT_Point feet = {takeoffX, node->y};
+    float velocityY = type == PCT_NAV_LINK_JUMP ? agent->jumpVelocity : 0.0f;
+    float landingX = 0.0f, timeS = 0.0f;
+    uint32_t to = PCT_NavFly(graph, tree, &feet, direction, velocityY, lowestY, &landingX, &timeS);
+    if (to == PCT_NAV_NONE || to == from) {
+        return;
+    }
+    if (type == PCT_NAV_LINK_JUMP) {
+        float lateX = takeoffX + direction * PCT_NAV_ARRIVE_DISTANCE;
+        PCT_Point late = {fminf(fmaxf(lateX, node->x1), node->x2), node->y};
+        float lateLandingX = 0.0f, lateTimeS = 0.0f;
+        if (PCT_NavFly(graph, tree, &late, direction, velocityY, lowestY, &lateLandingX,
+                       &lateTimeS) != to) {
+            return;
+        }
+    }
+    PCT_NavLink link = {.from = from,
+                        .to = to,
+                        .takeoffX = takeoffX,
+                        .landingX = landingX,
+                        .direction = direction,
+                        .cost = timeS * agent->runSpeed +
+                                (type == PCT_NAV_LINK_JUMP ? PCT_NAV_JUMP_COST : 0.0f),
+                        .type = type};
+    // Neighbouring takeoffs reaching the same node the same way only slow flow fields down.
+    for (size_t i = node->firstLink; i < links->count; i++) {
+        PCT_NavLink *other = links->links + i;
+        if (other->to == to && other->type == type && other->direction == direction &&
+            fabsf(other->takeoffX - takeoffX) < PCT_NAV_SEGMENT_LENGTH) {
+            if (link.cost < other->cost) {
+                *other = link;
+            }
+            return;
+        }
+    }
+    PCT_NavPushLink(links, &link);
+}
+
+PCT_NavGraph *PCT_BuildNavGraph(const PCT_AaBb *rects, const size_t rectCount,
+                                const PCT_KdTree *tree, const PCT_NavAgent *agent) {
+    assert(rects != NULL || rectCount == 0);
+    assert(tree != NULL);
+    assert(agent != NULL);
+
+    PCT_NavGraph *graph = calloc(1, sizeof(PCT_NavGraph));
+    size_t foundCapacity = 64;
+    const PCT_AaBb **found = malloc(sizeof(PCT_AaBb *) * foundCapacity);
+    if (graph == NULL || found == NULL) {
+        printf("Failed to allocate navigation graph.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    graph->agent = *agent;
+
+    PCT_NavSpanList blockers = {0}, surfaces = {0};
+    float lowestY = 0.0f;
+    for (size_t i = 0; i < rectCount; i++) {
+        PCT_NavRectSurfaces(rects + i, tree, agent, &found, &foundCapacity, &blockers, &surfaces);
+        lowestY = i == 0 ? rects[i].y1 : fminf(lowestY, rects[i].y1);
+    }
+    free(found);
+    free(blockers.spans);
+
+    // Ranges on tops of neighbouring rects at the same height overlap and form one node.
+    qsort(surfaces.spans, surfaces.count, sizeof(PCT_NavSpan), PCT_CompareSpans);
+    size_t merged = 0;
+    for (size_t i = 0; i < surfaces.count; i++) {
+        PCT_NavSpan *last = merged > 0 ? surfaces.spans + merged - 1 : NULL;
+        const PCT_NavSpan *span = surfaces.spans + i;
+        if (last != NULL && fabsf(last->y - span->y) < PCT_NAV_EPSILON &&
+            span->x1 <= last->x2 + PCT_NAV_EPSILON) {
+            last->x2 = fmaxf(last->x2, span->x2);
+        } else {
+            surfaces.spans[merged++] = *span;
+        }
+    }
+
+    graph->nodes = malloc(sizeof(PCT_NavNode) * (merged + 1));
+    if (graph->nodes == NULL) {
+        printf("Failed to allocate navigation nodes.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    for (size_t i = 0; i < merged; i++) {
+        const PCT_NavSpan *span = surfaces.spans + i;
+        float width = span->x2 - span->x1;
+        size_t segmentCount = (size_t)ceilf(width / PCT_NAV_SEGMENT_LENGTH);
+        graph->nodes[graph->nodeCount++] =
+            (PCT_NavNode){.x1 = span->x1,
+                          .x2 = span->x2,
+                          .y = span->y,
+                          .firstSegment = (uint32_t)graph->segmentCount,
+                          .segmentCount = (uint32_t)(segmentCount > 0 ? segmentCount : 1)};
+        graph->segmentCount += graph->nodes[graph->nodeCount - 1].segmentCount;
+    }
+    free(surfaces.spans);
+    PCT_NavBuildColumns(graph);
+
+    // Walk off both ends, jump both ways from near both ends and from every segment center. Jumps
+    // take off a step inside the ends, so agents running toward an end pass the takeoff on it.
+    PCT_NavLinkList links = {0};
+    for (uint32_t i = 0; i < graph->nodeCount; i++) {
+        PCT_NavNode *node = graph->nodes + i;
+        node->firstLink = (uint32_t)links.count;
+        PCT_NavTryLink(graph, tree, i, node->x1, -1.0f, PCT_NAV_LINK_FALL, lowestY, &links);
+        PCT_NavTryLink(graph, tree, i, node->x2, 1.0f, PCT_NAV_LINK_FALL, lowestY, &links);
+        float segmentLength = (node->x2 - node->x1) / node->segmentCount;
+        float inset = fminf(PCT_NAV_ARRIVE_DISTANCE, (node->x2 - node->x1) / 2);
+        for (uint32_t s = 0; s <= node->segmentCount + 1; s++) {
+            float x = s == 0                       ? node->x1 + inset
+                      : s == node->segmentCount + 1 ? node->x2 - inset
+                                                    : node->x1 + segmentLength * (s - 0.5f);
+            PCT_NavTryLink(graph, tree, i, x, -1.0f, PCT_NAV_LINK_JUMP, lowestY, &links);
+            PCT_NavTryLink(graph, tree, i, x, 1.0f, PCT_NAV_LINK_JUMP, lowestY, &links);
+        }
+        node->linkCount = (uint32_t)links.count - node->firstLink;
+    }
+    graph->links = links.links;
+    graph->linkCount = links.count;
+
+    graph->inLinks = malloc(sizeof(uint32_t) * (graph->linkCount + 1));
+    if (graph->inLinks == NULL) {
+        printf("Failed to allocate navigation links.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    for (size_t i = 0; i < graph->linkCount; i++) {
+        graph->nodes[graph->links[i].to].inLinkCount++;
+    }
+    uint32_t offset = 0;
+    for (size_t i = 0; i < graph->nodeCount; i++) {
+        graph->nodes[i].firstInLink = offset;
+        offset += graph->nodes[i].inLinkCount;
+        graph->nodes[i].inLinkCount = 0;
+    }
+    for (size_t i = 0; i < graph->linkCount; i++) {
+        PCT_NavNode *to = graph->nodes + graph->links[i].to;
+        graph->inLinks[to->firstInLink + to->inLinkCount++] = (uint32_t)i;
+    }
+    return graph;
+}
+
+void PCT_DestroyNavGraph(PCT_NavGraph *graph) {
+    if (graph == NULL) {
+        return;
+    }
+    free(graph->nodes);
+    free(graph->links);
+    free(graph->inLinks);
+    free(graph->columnFirst);
+    free(graph->columnNodes);
+    free(graph);
+}
+
+uint32_t PCT_NavFindNode(const PCT_NavGraph *graph, const PCT_Point *feet) {
+    float column = (feet->x - graph->columnOrigin) / PCT_NAV_COLUMN_WIDTH;
+    if (graph->nodeCount == 0 || !(column >= 0.0f) || column >= (float)graph->columnCount) {
+        return PCT_NAV_NONE;
+    }
+    size_t index = (size_t)column;
+    uint32_t best = PCT_NAV_NONE;
+    for (uint32_t i = graph->columnFirst[index]; i < graph->columnFirst[index + 1]; i++) {
+        const PCT_NavNode *node = graph->nodes + graph->columnNodes[i];
+        if (feet->x >= node->x1 - PCT_NAV_FOOT_TOLERANCE &&
+            feet->x <= node->x2 + PCT_NAV_FOOT_TOLERANCE &&
+            fabsf(feet->y - node->y) <= PCT_NAV_FOOT_TOLERANCE &&
+            (best == PCT_NAV_NONE || node->y > graph->nodes[best].y)) {
+            best = graph->columnNodes[i];
+        }
+    }
+    return best;
+}
+
+PCT_FlowField *PCT_CreateFlowField(const PCT_NavGraph *graph) {
+    assert(graph != NULL);
+
+    PCT_FlowField *field = calloc(1, sizeof(PCT_FlowField));
+    if (field != NULL) {
+        field->graph = graph;
+        field->targetNode = PCT_NAV_NONE;
+        field->linkCosts = malloc(sizeof(float) * (graph->linkCount + 1));
+        field->next = malloc(sizeof(uint32_t) * (graph->segmentCount + 1));
+        field->heapCapacity = graph->linkCount + 1;
+        field->heap = malloc(sizeof(PCT_NavHeapEntry) * field->heapCapacity);
+    }
+    if (field == NULL || field->linkCosts == NULL || field->next == NULL || field->heap == NULL) {
+        printf("Failed to allocate flow field.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    for (size_t i = 0; i < graph->segmentCount; i++) {
+        field->next[i] = PCT_NAV_NONE;
+    }
+    return field;
+}
+
+void PCT_DestroyFlowField(PCT_FlowField *field) {
+    if (field == NULL) {
+        return;
+    }
+    free(field->linkCosts);
+    free(field->next);
+    free(field->heap);
+    free(field);
+}
+
+static bool PCT_NavHeapLess(const PCT_NavHeapEntry *a, const PCT_NavHeapEntry *b) {
+    return a->cost < b->cost || (a->cost == b->cost && a->link < b->link);
+}
+
+static void PCT_NavHeapPush(PCT_FlowField *field, size_t *count, float cost, uint32_t link) {
+    if (*count == field->heapCapacity) {
+        size_t capacity = field->heapCapacity * 2;
+        PCT_NavHeapEntry *heap = realloc(field->heap, sizeof(PCT_NavHeapEntry) * capacity);
+        if (heap == NULL) {
+            printf("Failed to grow flow field heap.\n");
+            exit(PCT_EXIT_CODE_MEMORY_ERROR);
+        }
+        field->heap = heap;
+        field->heapCapacity = capacity;
+    }
+    PCT_NavHeapEntry *heap = field->heap;
+    size_t i = (*count)++;
+    heap[i] = (PCT_NavHeapEntry){cost, link};
+    while (i > 0 && PCT_NavHeapLess(heap + i, heap + (i - 1) / 2)) {
+        PCT_NavHeapEntry swap = heap[i];
+        heap[i] = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = swap;
+        i = (i - 1) / 2;
+    }
+}
+
+static PCT_NavHeapEntry PCT_NavHeapPop(PCT_FlowField *field, size_t *count) {
+    PCT_NavHeapEntry *heap = field->heap;
+    PCT_NavHeapEntry top = heap[0];
+    heap[0] = heap[--(*count)];
+    size_t i = 0;
+    while (true) {
+        size_t smallest = i;
+        size_t left = i * 2 + 1;
+        size_t right = left + 1;
+        if (left < *count && PCT_NavHeapLess(heap + left, heap + smallest)) {
+            smallest = left;
+        }
+        if (right < *count && PCT_NavHeapLess(heap + right, heap + smallest)) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        PCT_NavHeapEntry swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+    return top;
+}
+
+bool PCT_UpdateFlowField(PCT_FlowField *field, const uint32_t targetNode) {
+    assert(field != NULL);
+
+    const PCT_NavGraph *graph = field->graph;
+    uint32_t target = targetNode < graph->nodeCount ? targetNode : PCT_NAV_NONE;
+    if (target == field->targetNode) {
+        return false;
+    }
+    field->targetNode = target;
+    for (size_t i = 0; i < graph->segmentCount; i++) {
+        field->next[i] = PCT_NAV_NONE;
+    }
+    if (target == PCT_NAV_NONE) {
+        return true;
+    }
+
+    // Dijkstra from the target backwards over links. Cost of a link is what it takes to reach the
+    // target once it is taken, walking between landing and the next takeoff included.
+    const PCT_NavNode *targetNodePtr = graph->nodes + target;
+    float targetX = (targetNodePtr->x1 + targetNodePtr->x2) / 2;
+    size_t heapCount = 0;
+    for (size_t i = 0; i < graph->linkCount; i++) {
+        field->linkCosts[i] = INFINITY;
+    }
+    for (uint32_t i = 0; i < targetNodePtr->inLinkCount; i++) {
+        uint32_t link = graph->inLinks[targetNodePtr->firstInLink + i];
+        float cost = graph->links[link].cost + fabsf(graph->links[link].landingX - targetX);
+        if (cost < field->linkCosts[link]) {
+            field->linkCosts[link] = cost;
+            PCT_NavHeapPush(field, &heapCount, cost, link);
+        }
+    }
+    while (heapCount > 0) {
+        PCT_NavHeapEntry entry = PCT_NavHeapPop(field, &heapCount);
+        if (entry.cost > field->linkCosts[entry.link]) {
+            continue;
+        }
+        const PCT_NavLink *taken = graph->links + entry.link;
+        if (taken->from == target) {
+            continue;
+        }
+        const PCT_NavNode *node = graph->nodes + taken->from;
+        for (uint32_t i = 0; i < node->inLinkCount; i++) {
+            uint32_t link = graph->inLinks[node->firstInLink + i];
+            float cost = graph->links[link].cost +
+                         fabsf(graph->links[link].landingX - taken->takeoffX) + entry.cost;
+            if (cost < field->linkCosts[link]) {
+                field->linkCosts[link] = cost;
+                PCT_NavHeapPush(field, &heapCount, cost, link);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < graph->nodeCount; i++) {
+        const PCT_NavNode *node = graph->nodes + i;
+        if (i == target) {
+            continue;
+        }
+        float segmentLength = (node->x2 - node->x1) / node->segmentCount;
+        for (uint32_t s = 0; s < node->segmentCount; s++) {
+            float center = node->x1 + segmentLength * (s + 0.5f);
+            float bestCost = INFINITY;
+            for (uint32_t l = node->firstLink; l < node->firstLink + node->linkCount; l++) {
+                float cost = fabsf(center - graph->links[l].takeoffX) + field->linkCosts[l];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    field->next[node->firstSegment + s] = l;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool PCT_NavSteer(const PCT_FlowField *field, const PCT_Point *feet, const float targetX,
+                  PCT_NavSteering *steering) {
+    assert(field != NULL);
+    assert(steering != NULL);
+
+    const PCT_NavGraph *graph = field->graph;
+    *steering = (PCT_NavSteering){0};
+    uint32_t nodeIndex = PCT_NavFindNode(graph, feet);
+    if (nodeIndex == PCT_NAV_NONE) {
+        return true;
+    }
+    if (field->targetNode == PCT_NAV_NONE) {
+        return false;
+    }
+    if (nodeIndex == field->targetNode) {
+        float distance = targetX - feet->x;
+        steering->cost = fabsf(distance);
+        if (fabsf(distance) > PCT_NAV_ARRIVE_DISTANCE) {
+            steering->direction = distance > 0 ? 1.0f : -1.0f;
+        }
+        return true;
+    }
+
+    const PCT_NavNode *node = graph->nodes + nodeIndex;
+    float segment = (feet->x - node->x1) * node->segmentCount / (node->x2 - node->x1);
+    uint32_t s = segment > 0.0f ? (uint32_t)fminf(segment, node->segmentCount - 1) : 0;
+    uint32_t linkIndex = field->next[node->firstSegment + s];
+    if (linkIndex == PCT_NAV_NONE) {
+        return false;
+    }
+    const PCT_NavLink *link = graph->links + linkIndex;
+    float distance = link->takeoffX - feet->x;
+    steering->cost = fabsf(distance) + field->linkCosts[linkIndex];
+    // Links are taken running in their direction once the takeoff is reached, so a jump starts
+    // where its flight was traced give or take one step. Past the takeoff of a walk off the agent
+    // only has to keep going over the edge.
+    float past = -distance * link->direction;
+    if (past >= -PCT_NAV_FOOT_TOLERANCE &&
+        (past <= PCT_NAV_ARRIVE_DISTANCE || link->type == PCT_NAV_LINK_FALL)) {
+        steering->direction = link->direction;
+        steering->jump = link->type == PCT_NAV_LINK_JUMP;
+    } else {
+        steering->direction = distance > 0 ? 1.0f : -1.0f;
+    }
+    return true;
+}
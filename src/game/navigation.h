@@ -0,0 +1,159 @@
+/**
+ * @file navigation.h
+ * Navigation for large crowds. Walkable surfaces of the map become nodes joined by fall and jump
+ * links, a flow field toward a target is shared by every agent, so steering one agent is a node
+ * lookup and a table read no matter how many agents there are.
+ */
+#if !defined(PCT_NAVIGATION)
+#define PCT_NAVIGATION
+
+#include "../structures/structures.h"
+#include "game.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PCT_NAV_NONE UINT32_MAX
+
+#ifndef PCT_NAV_COLUMN_WIDTH
+#define PCT_NAV_COLUMN_WIDTH 0.5f
+#endif
+#ifndef PCT_NAV_SEGMENT_LENGTH
+#define PCT_NAV_SEGMENT_LENGTH 0.5f
+#endif
+#define PCT_NAV_FOOT_TOLERANCE 0.0005f
+#define PCT_NAV_ARRIVE_DISTANCE 0.01f
+#define PCT_NAV_JUMP_COST 0.5f
+#define PCT_NAV_STEP_MS 16
+#define PCT_NAV_MAX_FLIGHT_MS 3000
+
+/**
+ * @brief Movement abilities links are derived from. Velocities are in units per second, gravity
+ * is negative.
+ */
+typedef struct {
+    float halfWidth;
+    float height;
+    float runSpeed;
+    float jumpVelocity;
+    float gravity;
+} PCT_NavAgent;
+
+typedef enum { PCT_NAV_LINK_FALL, PCT_NAV_LINK_JUMP } PCT_NavLinkType;
+
+/**
+ * @brief Way from one surface to another, agent leaves from at takeoffX running in direction and
+ * ends up on to around landingX. Cost is flight time in units the agent would run meanwhile.
+ */
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    float takeoffX;
+    float landingX;
+    float direction;
+    float cost;
+    PCT_NavLinkType type;
+} PCT_NavLink;
+
+/**
+ * @brief Range of agent centers at which it stands on top of one or more flush rects with nothing
+ * in its box. Split into segments so flow fields can pick a different exit along long surfaces.
+ */
+typedef struct {
+    float x1;
+    float x2;
+    float y;
+    uint32_t firstLink;
+    uint32_t linkCount;
+    uint32_t firstInLink;
+    uint32_t inLinkCount;
+    uint32_t firstSegment;
+    uint32_t segmentCount;
+} PCT_NavNode;
+
+/**
+ * @brief Immutable navigation graph of a map. Links are sorted by from node, inLinks lists them
+ * by to node. Columns bucket nodes by x for PCT_NavFindNode.
+ */
+typedef struct {
+    PCT_NavAgent agent;
+    PCT_NavNode *nodes;
+    size_t nodeCount;
+    PCT_NavLink *links;
+    size_t linkCount;
+    uint32_t *inLinks;
+    size_t segmentCount;
+    float columnOrigin;
+    size_t columnCount;
+    uint32_t *columnFirst;
+    uint32_t *columnNodes;
+} PCT_NavGraph;
+
+typedef struct {
+    float cost;
+    uint32_t link;
+} PCT_NavHeapEntry;
+
+/**
+ * @brief Route of every surface toward targetNode. linkCosts hold the cost to reach the target
+ * through each link, next holds the link to take from each segment.
+ */
+typedef struct {
+    const PCT_NavGraph *graph;
+    uint32_t targetNode;
+    float *linkCosts;
+    uint32_t *next;
+    PCT_NavHeapEntry *heap;
+    size_t heapCapacity;
+} PCT_FlowField;
+
+/**
+ * @brief What an agent should do this tick. Direction 0 keeps the current one. Cost estimates the
+ * rest of the route, 0 while agent is off every node.
+ */
+typedef struct {
+    float direction;
+    bool jump;
+    float cost;
+} PCT_NavSteering;
+
+/**
+ * @brief Builds graph of the surfaces of rects, tree has to hold the same rects. Links are found
+ * by flying agent off every edge and jumping from every segment the way enemies move, so they
+ * follow from the agent physics rather than from fixed reach rules.
+ * User should call PCT_DestroyNavGraph to free it.
+ */
+PCT_NavGraph *PCT_BuildNavGraph(const PCT_AaBb *rects, size_t rectCount, const PCT_KdTree *tree,
+                                const PCT_NavAgent *agent);
+void PCT_DestroyNavGraph(PCT_NavGraph *graph);
+
+/**
+ * @brief Finds surface feet stand on, within PCT_NAV_FOOT_TOLERANCE. Only nodes of the column
+ * of feet are scanned.
+ * @return node index or PCT_NAV_NONE when feet are in the air
+ */
+uint32_t PCT_NavFindNode(const PCT_NavGraph *graph, const PCT_Point *feet);
+
+/**
+ * @brief Creates field with no target. User should call PCT_DestroyFlowField to free it.
+ */
+PCT_FlowField *PCT_CreateFlowField(const PCT_NavGraph *graph);
+void PCT_DestroyFlowField(PCT_FlowField *field);
+
+/**
+ * @brief Points field at targetNode. Routes only depend on the target node, so this recomputes
+ * nothing while the target moves within its surface.
+ * @return true when routes were recomputed
+ */
+bool PCT_UpdateFlowField(PCT_FlowField *field, uint32_t targetNode);
+
+/**
+ * @brief Steers agent with feet at given point toward the field target, which is at targetX on
+ * the target node. Agent off every node, in the air or stepping over the end of a node, keeps its
+ * course. Constant time, a column lookup and a read of the field.
+ * @return false when agent stands on a node with no route to the target
+ */
+bool PCT_NavSteer(const PCT_FlowField *field, const PCT_Point *feet, float targetX,
+                  PCT_NavSteering *steering);
+
+#endif // PCT_NAVIGATION
@@ -0,0 +1,164 @@
+#include "physics.h"
+#include "../misc/errors.h"
+#include "../structures/structures.h"
+#include "game.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef PCT_SWEEP_CANDIDATES
+#define PCT_SWEEP_CANDIDATES 64
+#endif
+
+typedef struct {
+    const PCT_AaBb **candidates;
+    size_t capacity;
+    bool onHeap;
+} PCT_SweepScratch;
+
+static size_t PCT_GatherCandidates(const PCT_KdTree *tree, const PCT_AaBb *range,
+                                   PCT_SweepScratch *scratch) {
+    size_t count = PCT_KdTreeRangeQuery(tree, range, scratch->candidates, scratch->capacity);
+    if (count <= scratch->capacity) {
+        return count;
+    }
+
+    size_t capacity = scratch->capacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    const PCT_AaBb **candidates = scratch->onHeap
+                                      ? realloc(scratch->candidates, sizeof(PCT_AaBb *) * capacity)
+                                      : malloc(sizeof(PCT_AaBb *) * capacity);
+    if (candidates == NULL) {
+        printf("Failed to allocate sweep candidates.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    scratch->candidates = candidates;
+    scratch->capacity = capacity;
+    scratch->onHeap = true;
+    return PCT_KdTreeRangeQuery(tree, range, scratch->candidates, scratch->capacity);
+}
+
+static uint8_t PCT_ContactFromNormal(const float normalX, const float normalY) {
+    uint8_t contacts = PCT_CONTACT_NONE;
+    if (normalY > 0.0f) {
+        contacts |= PCT_CONTACT_GROUND;
+    } else if (normalY < 0.0f) {
+        contacts |= PCT_CONTACT_CEILING;
+    }
+    if (normalX > 0.0f) {
+        contacts |= PCT_CONTACT_WALL_LEFT;
+    } else if (normalX < 0.0f) {
+        contacts |= PCT_CONTACT_WALL_RIGHT;
+    }
+    return contacts;
+}
+
+static void PCT_MoveAndSlideWithScratch(const PCT_KdTree *tree, const PCT_AaBb *box,
+                                        const PCT_Vector *motion, PCT_SweepResult *result,
+                                        PCT_SweepScratch *scratch) {
+    PCT_AaBb swept = {.x1 = fminf(box->x1, box->x1 + motion->x) - PCT_SWEEP_SKIN,
+                      .y1 = fminf(box->y1, box->y1 + motion->y) - PCT_SWEEP_SKIN,
+                      .x2 = fmaxf(box->x2, box->x2 + motion->x) + PCT_SWEEP_SKIN,
+                      .y2 = fmaxf(box->y2, box->y2 + motion->y) + PCT_SWEEP_SKIN};
+    size_t candidatesCount = PCT_GatherCandidates(tree, &swept, scratch);
+    const PCT_AaBb **candidates = scratch->candidates;
+
+    PCT_AaBb current = *box;
+    PCT_Vector remaining = *motion;
+    result->contacts = PCT_CONTACT_NONE;
+
+    // Push out of overlaps left behind by previous steps, shallow ones are handled as contacts.
+    for (size_t i = 0; i < candidatesCount; i++) {
+        PCT_Collision collisionInfo = {0};
+        if (PCT_AaBbCollisionTest(&current, candidates[i], &collisionInfo) &&
+            collisionInfo.distance > PCT_SWEEP_SKIN) {
+            PCT_Vector push = {.x = collisionInfo.normal[0] * collisionInfo.distance,
+                               .y = collisionInfo.normal[1] * collisionInfo.distance};
+            current = (PCT_AaBb){current.x1 + push.x, current.y1 + push.y, current.x2 + push.x,
+                                 current.y2 + push.y};
+            result->contacts |=
+                PCT_ContactFromNormal(collisionInfo.normal[0], collisionInfo.normal[1]);
+            if (collisionInfo.normal[0] * remaining.x < 0.0f) {
+                remaining.x = 0.0f;
+            }
+            if (collisionInfo.normal[1] * remaining.y < 0.0f) {
+                remaining.y = 0.0f;
+            }
+        }
+    }
+
+    for (size_t iteration = 0;
+         iteration < PCT_SWEEP_MAX_ITERATIONS && (remaining.x != 0.0f || remaining.y != 0.0f);
+         iteration++) {
+        bool hit = false;
+        float earliest = 1.0f;
+        float blockX = 0.0f;
+        float blockY = 0.0f;
+        for (size_t i = 0; i < candidatesCount; i++) {
+            float timeOfImpact;
+            PCT_Collision collisionInfo = {0};
+            if (!PCT_AaBbSweepTest(&current, &remaining, candidates[i], &timeOfImpact,
+                                   &collisionInfo)) {
+                continue;
+            }
+            if (!hit || timeOfImpact < earliest) {
+                hit = true;
+                earliest = timeOfImpact;
+                blockX = collisionInfo.normal[0];
+                blockY = collisionInfo.normal[1];
+            } else if (timeOfImpact == earliest) {
+                // Simultaneous contacts, e.g. landing in a corner, block both axes at once.
+                blockX = collisionInfo.normal[0] != 0.0f ? collisionInfo.normal[0] : blockX;
+                blockY = collisionInfo.normal[1] != 0.0f ? collisionInfo.normal[1] : blockY;
+            }
+        }
+
+        float step = hit ? earliest : 1.0f;
+        current = (PCT_AaBb){current.x1 + remaining.x * step, current.y1 + remaining.y * step,
+                             current.x2 + remaining.x * step, current.y2 + remaining.y * step};
+        if (!hit) {
+            break;
+        }
+
+        result->contacts |= PCT_ContactFromNormal(blockX, blockY);
+        remaining.x = blockX != 0.0f ? 0.0f : remaining.x * (1.0f - earliest);
+        remaining.y = blockY != 0.0f ? 0.0f : remaining.y * (1.0f - earliest);
+    }
+
+    result->motion = (PCT_Vector){.x = current.x1 - box->x1, .y = current.y1 - box->y1};
+}
+
+void PCT_MoveAndSlide(const PCT_KdTree *tree, const PCT_AaBb *box, const PCT_Vector *motion,
+                      PCT_SweepResult *result) {
+    assert(tree != NULL);
+    assert(box != NULL);
+    assert(motion != NULL);
+    assert(result != NULL);
+
+    const PCT_AaBb *storage[PCT_SWEEP_CANDIDATES];
+    PCT_SweepScratch scratch = {.candidates = storage, .capacity = PCT_SWEEP_CANDIDATES};
+    PCT_MoveAndSlideWithScratch(tree, box, motion, result, &scratch);
+    if (scratch.onHeap) {
+        free(scratch.candidates);
+    }
+}
+
+void PCT_MoveAndSlideBatch(const PCT_KdTree *tree, const PCT_AaBb *boxes,
+                           const PCT_Vector *motions, PCT_SweepResult *results, const size_t count) {
+    assert(tree != NULL);
+    assert(boxes != NULL || count == 0);
+    assert(motions != NULL || count == 0);
+    assert(results != NULL || count == 0);
+
+    const PCT_AaBb *storage[PCT_SWEEP_CANDIDATES];
+    PCT_SweepScratch scratch = {.candidates = storage, .capacity = PCT_SWEEP_CANDIDATES};
+    for (size_t i = 0; i < count; i++) {
+        PCT_MoveAndSlideWithScratch(tree, boxes + i, motions + i, results + i, &scratch);
+    }
+    if (scratch.onHeap) {
+        free(scratch.candidates);
+    }
+}
@@ -0,0 +1,38 @@
+#if !defined(PCT_PHYSICS)
+#define PCT_PHYSICS
+
+#include "../structures/structures.h"
+#include "game.h"
+#include <stdint.h>
+
+#ifndef PCT_SWEEP_MAX_ITERATIONS
+#define PCT_SWEEP_MAX_ITERATIONS 4
+#endif
+
+#define PCT_CONTACT_NONE 0x0
+#define PCT_CONTACT_GROUND 0x1
+#define PCT_CONTACT_CEILING 0x2
+#define PCT_CONTACT_WALL_LEFT 0x4
+#define PCT_CONTACT_WALL_RIGHT 0x8
+
+typedef struct {
+    PCT_Vector motion;
+    uint8_t contacts;
+} PCT_SweepResult;
+
+/**
+ * @brief Moves box along motion through the static map, stopping at the first time of impact and
+ * sliding along the hit surface for up to PCT_SWEEP_MAX_ITERATIONS steps.
+ * Fast movers cannot tunnel through thin rects since the whole swept path is tested.
+ * @param result receives displacement that was actually applied and PCT_CONTACT_* flags
+ */
+void PCT_MoveAndSlide(const PCT_KdTree *tree, const PCT_AaBb *box, const PCT_Vector *motion,
+                      PCT_SweepResult *result);
+
+/**
+ * @brief Batched PCT_MoveAndSlide, candidate storage is shared between all movers.
+ */
+void PCT_MoveAndSlideBatch(const PCT_KdTree *tree, const PCT_AaBb *boxes,
+                           const PCT_Vector *motions, PCT_SweepResult *results, size_t count);
+
+#endif // PCT_PHYSICS
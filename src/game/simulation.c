@@ -0,0 +1,378 @@
+#include "simulation.h"
+#include "../entity.h"
+#include "../misc/errors.h"
+#include "../structures/structures.h"
+#include "game.h"
+#include "navigation.h"
+#include "physics.h"
+#include <SDL3/SDL.h>
+#include <assert.h>
+#include <cglm/cglm.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+PCT_SimState *PCT_CreateSimState(const size_t enemyCapacity, const uint64_t seed) {
+    PCT_SimState *state =
+        malloc(offsetof(PCT_SimState, enemies) + sizeof(PCT_Entity) * enemyCapacity);
+    if (state == NULL) {
+        printf("Failed to allocate simulation state.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    state->enemyCapacity = enemyCapacity;
+    PCT_SimInit(state, seed);
+    return state;
+}
+
+void PCT_DestroySimState(PCT_SimState *state) {
+    free(state);
+}
+
+void PCT_SimInit(PCT_SimState *state, const uint64_t seed) {
+    assert(state != NULL);
+
+    size_t enemyCapacity = state->enemyCapacity;
+    memset(state, 0, offsetof(PCT_SimState, enemies));
+    state->enemyCapacity = enemyCapacity;
+    // xorshift state must not be zero
+    state->rngState = seed != 0 ? seed : 0x9E3779B97F4A7C15ull;
+    state->navTarget = PCT_NAV_NONE;
+    state->player = (PCT_Player){.currentState = PCT_PLAYER_STATE_IDLE,
+                                 .direction = 1,
+                                 .locationX = 0.0f,
+                                 .locationY = 0.0f};
+}
+
+bool PCT_SimAddEnemy(PCT_SimState *state, const PCT_Entity *enemy) {
+    if (state->enemyCount >= state->enemyCapacity) {
+        return false;
+    }
+    state->enemies[state->enemyCount++] = *enemy;
+    return true;
+}
+
+size_t PCT_SimStateSize(const PCT_SimState *state) {
+    return offsetof(PCT_SimState, enemies) + sizeof(PCT_Entity) * state->enemyCount;
+}
+
+uint32_t PCT_SimRandom(PCT_SimState *state) {
+    uint64_t x = state->rngState;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    state->rngState = x;
+    return (uint32_t)((x * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+PCT_AaBb PCT_PlayerAttackBox(const PCT_Player *player) {
+    PCT_AaBb attackBox = {0.0f, 0.0f, 0.1f, 0.1f};
+    return PCT_MoveBox(&attackBox,
+                       &(PCT_Vector){.x = -0.05f + player->locationX + 0.05f +
+                                          player->direction * 0.1f,
+                                     .y = player->locationY});
+}
+
+void PCT_PlayerAttack(PCT_SimState *state, bool attack) {
+    PCT_Player *player = &state->player;
+    PCT_PlayerAttackState *attackState = &state->attack;
+    if (!player->isAttacking && attack && !attackState->inProgress) {
+        attackState->startTimeMs = state->timeMs;
+        player->isAttacking = true;
+        attackState->inProgress = true;
+    }
+
+    if (attackState->inProgress) {
+        PCT_AaBb attackBox = PCT_PlayerAttackBox(player);
+        for (size_t i = 0; i < state->enemyCount; i++) {
+            PCT_Entity *enemy = state->enemies + i;
+            PCT_AaBb enemyBox = PCT_MoveBox(&enemy->box, (PCT_Vector *)&enemy->location);
+            if (PCT_AaBbCollisionTest(&attackBox, &enemyBox, NULL)) {
+                enemy->health -= 5.0f;
+            }
+        }
+    }
+
+    if (attackState->startTimeMs + PCT_ATTACK_DURATION_MS < state->timeMs) {
+        attackState->inProgress = false;
+    }
+}
+
+static float PCT_PlayerJump(PCT_Player *player, bool jump, float deltaTimeS) {
+    float gravity = PCT_GRAVITY;
+
+    if ((jump && !player->isJumping) && (player->isOnGround || player->velocityY < 0)) {
+        player->velocityY = (2.0 * PCT_JUMP_HEIGHT_MAX * PCT_RUN_SPEED) / PCT_JUMP_DISTANCE;
+        player->locationY +=
+            (player->velocityY * deltaTimeS) + ((gravity / 2) * deltaTimeS * deltaTimeS);
+        // 1/2 * (G0 + G1) * dT
+        player->isOnGround = false;
+        player->isJumping = true;
+    }
+
+    if (player->velocityY > 0 && !jump) {
+        return (-2.0f * PCT_JUMP_HEIGHT_MIN * PCT_RUN_SPEED * PCT_RUN_SPEED) /
+               (PCT_SMALL_JUMP_DISTANCE * PCT_SMALL_JUMP_DISTANCE);
+    }
+
+    return gravity;
+}
+
+void PCT_UpdatePlayer(PCT_Player *player, float controllerX, bool jump, int64_t deltaTimeMs,
+                      const PCT_KdTree *tree) {
+    float deltaTimeS = deltaTimeMs / 1000.0f;
+    float gravity = PCT_PlayerJump(player, jump, deltaTimeS);
+
+    if (controllerX == 0) {
+        player->currentState = PCT_PLAYER_STATE_IDLE;
+    } else {
+        player->currentState = PCT_PLAYER_STATE_RUNNING;
+    }
+
+    float nextLocationX = player->locationX;
+    float nextLocationY = player->locationY;
+    float nextVelocityY = player->velocityY;
+    if (controllerX != 0) {
+        player->direction = controllerX > 0 ? 1 : -1;
+        float position = player->locationX + (controllerX * deltaTimeS * PCT_RUN_SPEED);
+        nextLocationX = position;
+    }
+
+    nextVelocityY +=
+        SDL_clamp(gravity * deltaTimeS, -PCT_TERMINAL_VELOCITY, 100.0f); // 1/2 * (G0 + G1) * dT
+    nextLocationY += (player->velocityY * deltaTimeS) + ((gravity / 2) * deltaTimeS * deltaTimeS);
+    PCT_AaBb playerBox = {.x1 = player->locationX,
+                          .y1 = player->locationY,
+                          .x2 = player->locationX + 0.1f,
+                          .y2 = player->locationY + 0.1f};
+    PCT_Vector motion = {.x = nextLocationX - player->locationX,
+                         .y = nextLocationY - player->locationY};
+    PCT_SweepResult sweep = {0};
+    PCT_MoveAndSlide(tree, &playerBox, &motion, &sweep);
+    if (sweep.contacts & PCT_CONTACT_GROUND) {
+        player->isOnGround = true;
+        nextVelocityY = 0.0f;
+    } else if (sweep.contacts & PCT_CONTACT_CEILING) {
+        nextVelocityY = glm_min(player->velocityY, -0.01f);
+    }
+
+    player->locationY += sweep.motion.y;
+    player->velocityY = nextVelocityY;
+    player->locationX += sweep.motion.x;
+}
+
+/**
+ * @brief Whether ground is within distance below from. Occupancy settles it unless the column
+ * only holds partially covered cells, those are traced through the tree.
+ */
+static bool PCT_GroundBelow(const PCT_Map *map, const PCT_Point *from, const float distance) {
+    switch (PCT_OccupancyGroundBelow(map->occupancy, from, distance, NULL)) {
+    case PCT_OCCUPANCY_EMPTY:
+        return false;
+    case PCT_OCCUPANCY_FULL:
+        return true;
+    default: {
+        PCT_Point to = {from->x, from->y - distance};
+        return PCT_KdTreeSegmentCast(map->tree, from, &to, NULL);
+    }
+    }
+}
+
+PCT_NavAgent PCT_EnemyNavAgent(void) {
+    return (PCT_NavAgent){
+        .halfWidth = 0.075f,
+        .height = 0.1f,
+        .runSpeed = PCT_ENEMY_RUN_SPEED,
+        .jumpVelocity = (2.0f * PCT_JUMP_HEIGHT_MAX * PCT_RUN_SPEED) / PCT_JUMP_DISTANCE,
+        .gravity = PCT_GRAVITY};
+}
+
+void PCT_UpdateEnemy(PCT_Entity *enemy, int64_t deltaTimeMs, const PCT_Map *map,
+                     const PCT_NavSteering *steering) {
+    float deltaTimeS = deltaTimeMs / 1000.0f;
+    float gravity = PCT_GRAVITY;
+    if (steering != NULL) {
+        if (steering->direction != 0.0f) {
+            enemy->direction = steering->direction;
+        }
+        if (steering->jump && enemy->velocity.y == 0.0f) {
+            enemy->velocity.y = (2.0f * PCT_JUMP_HEIGHT_MAX * PCT_RUN_SPEED) / PCT_JUMP_DISTANCE;
+        }
+    }
+    float nextLocationX =
+        enemy->location.x + ((enemy->direction) * PCT_ENEMY_RUN_SPEED * deltaTimeS);
+    float nextLocationY = enemy->location.y;
+    float nextVelocityY = enemy->velocity.y;
+    nextVelocityY +=
+        SDL_clamp(gravity * deltaTimeS, -PCT_TERMINAL_VELOCITY, 100.0f); // 1/2 * (G0 + G1) * dT
+    nextLocationY += ((enemy->velocity.y) * deltaTimeS) + ((gravity / 2) * deltaTimeS * deltaTimeS);
+    PCT_AaBb collisionBox = PCT_MoveBox(&enemy->box, (PCT_Vector *)&enemy->location);
+    PCT_Vector motion = {.x = nextLocationX - enemy->location.x,
+                         .y = nextLocationY - enemy->location.y};
+    PCT_SweepResult sweep = {0};
+    PCT_MoveAndSlide(map->tree, &collisionBox, &motion, &sweep);
+    if (sweep.contacts & PCT_CONTACT_GROUND) {
+        nextVelocityY = 0.0f;
+    } else if (sweep.contacts & PCT_CONTACT_CEILING) {
+        nextVelocityY = glm_min(enemy->velocity.y, -0.01f);
+    }
+    collisionBox = PCT_MoveBox(&collisionBox, &sweep.motion);
+    enemy->location.x += sweep.motion.x;
+    enemy->location.y += sweep.motion.y;
+    enemy->velocity.y = nextVelocityY;
+
+    // Following enemies walk off ledges and push against walls on purpose.
+    if (steering != NULL) {
+        return;
+    }
+    if (sweep.contacts & PCT_CONTACT_WALL_LEFT) {
+        enemy->direction = 1.0f;
+    } else if (sweep.contacts & PCT_CONTACT_WALL_RIGHT) {
+        enemy->direction = -1.0f;
+    }
+    PCT_Point leftFrom = {collisionBox.x1, collisionBox.y1 + 0.01f};
+    PCT_Point rightFrom = {collisionBox.x2, collisionBox.y1 + 0.01f};
+    if (!PCT_GroundBelow(map, &leftFrom, 0.06f)) {
+        enemy->direction = 1.0f;
+    } else if (!PCT_GroundBelow(map, &rightFrom, 0.06f)) {
+        enemy->direction = -1.0f;
+    }
+}
+
+void PCT_SimTick(PCT_SimState *state, const PCT_TickInput *input, const PCT_Map *map,
+                 PCT_FlowField *flow) {
+    assert(state != NULL);
+    assert(input != NULL);
+    assert(map != NULL);
+
+    // Held buttons latch until released, jumping and attacking again needs a new press.
+    if (!input->jump) {
+        state->player.isJumping = false;
+    }
+    if (!input->attack) {
+        state->player.isAttacking = false;
+    }
+    state->timeMs += input->deltaTimeMs;
+
+    PCT_KdTreeSite site = PCT_KdTreeProfileSetSite(PCT_KDTREE_SITE_PLAYER);
+    PCT_UpdatePlayer(&state->player, input->moveX, input->jump > 0, input->deltaTimeMs, map->tree);
+    // Target stays on the last surface the player stood on while the player is in the air.
+    PCT_Point playerFeet = {state->player.locationX + 0.05f, state->player.locationY};
+    if (flow != NULL) {
+        uint32_t playerNode = PCT_NavFindNode(flow->graph, &playerFeet);
+        if (playerNode != PCT_NAV_NONE) {
+            state->navTarget = playerNode;
+        }
+        PCT_UpdateFlowField(flow, state->navTarget);
+    }
+    PCT_KdTreeProfileSetSite(PCT_KDTREE_SITE_ENEMY);
+    for (size_t i = 0; i < state->enemyCount; i++) {
+        PCT_Entity *enemy = state->enemies + i;
+        PCT_Point feet = {enemy->location.x + (enemy->box.x1 + enemy->box.x2) / 2,
+                          enemy->location.y + enemy->box.y1};
+        PCT_NavSteering steering;
+        bool follow = flow != NULL && PCT_NavSteer(flow, &feet, playerFeet.x, &steering) &&
+                      steering.cost < PCT_NAV_CHASE_COST;
+        PCT_UpdateEnemy(enemy, input->deltaTimeMs, map, follow ? &steering : NULL);
+    }
+    PCT_KdTreeProfileSetSite(site);
+    PCT_PlayerAttack(state, input->attack > 0);
+    state->tick++;
+}
+
+PCT_SimHistory *PCT_CreateSimHistory(const size_t enemyCapacity) {
+    PCT_SimHistory *history = calloc(1, sizeof(PCT_SimHistory));
+    if (history != NULL) {
+        history->enemyCapacity = enemyCapacity;
+        history->snapshotStride =
+            offsetof(PCT_SimState, enemies) + sizeof(PCT_Entity) * enemyCapacity;
+        // Keep snapshots aligned for the state they hold.
+        history->snapshotStride = (history->snapshotStride + 15) & ~(size_t)15;
+        history->snapshots = malloc(history->snapshotStride * PCT_SIM_HISTORY_SIZE);
+    }
+    if (history == NULL || history->snapshots == NULL) {
+        printf("Failed to allocate simulation history.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    return history;
+}
+
+void PCT_DestroySimHistory(PCT_SimHistory *history) {
+    free(history->snapshots);
+    free(history);
+}
+
+static inline PCT_SimState *PCT_SimHistorySnapshot(const PCT_SimHistory *history,
+                                                   const uint64_t tick) {
+    return (PCT_SimState *)(history->snapshots +
+                            history->snapshotStride * (tick % PCT_SIM_HISTORY_SIZE));
+}
+
+static inline bool PCT_SimHistoryHas(const PCT_SimHistory *history, const uint64_t tick) {
+    return history->count > 0 && tick >= history->oldestTick &&
+           tick < history->oldestTick + history->count;
+}
+
+void PCT_SimAdvance(PCT_SimHistory *history, PCT_SimState *state, const PCT_TickInput *input,
+                    const PCT_Map *map, PCT_FlowField *flow) {
+    assert(history != NULL);
+    assert(state != NULL);
+    assert(state->enemyCapacity == history->enemyCapacity);
+
+    uint64_t tick = state->tick;
+    if (history->count == 0 || tick < history->oldestTick ||
+        tick > history->oldestTick + history->count) {
+        history->oldestTick = tick;
+        history->count = 0;
+    }
+    if (tick == history->oldestTick + history->count) {
+        if (history->count == PCT_SIM_HISTORY_SIZE) {
+            history->oldestTick++;
+        } else {
+            history->count++;
+        }
+    } else {
+        // Advancing from a rewound state starts a new timeline, later snapshots are stale.
+        history->count = tick - history->oldestTick + 1;
+    }
+
+    memcpy(PCT_SimHistorySnapshot(history, tick), state, PCT_SimStateSize(state));
+    history->inputs[tick % PCT_SIM_HISTORY_SIZE] = *input;
+    PCT_SimTick(state, input, map, flow);
+}
+
+bool PCT_SimRestore(const PCT_SimHistory *history, const uint64_t tick, PCT_SimState *state) {
+    assert(history != NULL);
+    assert(state != NULL);
+
+    if (!PCT_SimHistoryHas(history, tick) || state->enemyCapacity != history->enemyCapacity) {
+        return false;
+    }
+    const PCT_SimState *snapshot = PCT_SimHistorySnapshot(history, tick);
+    memcpy(state, snapshot, PCT_SimStateSize(snapshot));
+    return true;
+}
+
+bool PCT_SimSetInput(PCT_SimHistory *history, const uint64_t tick, const PCT_TickInput *input) {
+    if (!PCT_SimHistoryHas(history, tick)) {
+        return false;
+    }
+    history->inputs[tick % PCT_SIM_HISTORY_SIZE] = *input;
+    return true;
+}
+
+bool PCT_SimResimulate(PCT_SimHistory *history, const uint64_t tick, PCT_SimState *state,
+                       const PCT_Map *map, PCT_FlowField *flow) {
+    assert(history != NULL);
+    assert(state != NULL);
+
+    uint64_t targetTick = state->tick;
+    if (targetTick < tick || !PCT_SimRestore(history, tick, state)) {
+        return false;
+    }
+    while (state->tick < targetTick) {
+        PCT_TickInput input = history->inputs[state->tick % PCT_SIM_HISTORY_SIZE];
+        PCT_SimAdvance(history, state, &input, map, flow);
+    }
+    return true;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file simulation.h
+ * Gameplay state advanced once per tick. Everything a tick mutates lives in PCT_SimState, which
+ * holds no owning pointers, so it can be snapshotted with a single memcpy. Nothing is kept in
+ * globals, any number of states may be ticked concurrently as long as each has a single owner.
+ */
+#if !defined(PCT_SIMULATION)
+#define PCT_SIMULATION
+
+#include "../entity.h"
+#include "../structures/structures.h"
+#include "game.h"
+#include "map.h"
+#include "navigation.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef PCT_SIM_HISTORY_SIZE
+#define PCT_SIM_HISTORY_SIZE 16
+#endif
+
+#define PCT_RUN_SPEED 1.0f
+#define PCT_JUMP_HEIGHT_MAX 0.45f
+#define PCT_JUMP_HEIGHT_MIN 0.1f
+#define PCT_TERMINAL_VELOCITY 0.7f
+#define PCT_JUMP_DISTANCE 0.4f
+#define PCT_SMALL_JUMP_DISTANCE 0.1f
+#define PCT_ATTACK_DURATION_MS 200
+#define PCT_ENEMY_RUN_SPEED 0.35f
+// Gravity giving a PCT_JUMP_HEIGHT_MAX high jump over PCT_JUMP_DISTANCE at PCT_RUN_SPEED.
+#define PCT_GRAVITY                                                                                \
+    ((-2.0f * PCT_JUMP_HEIGHT_MAX * PCT_RUN_SPEED * PCT_RUN_SPEED) /                               \
+     (PCT_JUMP_DISTANCE * PCT_JUMP_DISTANCE))
+
+#ifndef PCT_NAV_CHASE_COST
+#define PCT_NAV_CHASE_COST 4.0f
+#endif
+
+typedef enum {
+    PCT_PLAYER_STATE_IDLE,
+    PCT_PLAYER_STATE_RUNNING,
+    PCT_PLAYER_STATE_JUMPING_UP,
+    PCT_PLAYER_STATE_JUMPING_TOP,
+    PCT_PLAYER_STATE_JUMPING_DOWN
+} PCT_PlayerState;
+
+typedef struct {
+    float locationX;
+    float locationY;
+    float velocityY;
+    int8_t direction;
+    PCT_PlayerState currentState;
+    bool isOnGround;
+    bool isJumping;
+    bool isAttacking;
+} PCT_Player;
+
+typedef struct {
+    int64_t startTimeMs;
+    bool inProgress;
+} PCT_PlayerAttackState;
+
+/**
+ * @brief Controls sampled for one tick, kept in history so ticks can be replayed.
+ */
+typedef struct {
+    float moveX;
+    uint8_t jump;
+    uint8_t attack;
+    int64_t deltaTimeMs;
+} PCT_TickInput;
+
+/**
+ * @brief All mutable simulation state. Enemies are stored last so only the used prefix has to be
+ * copied, see PCT_SimStateSize. Allocated with room for enemyCapacity enemies by
+ * PCT_CreateSimState.
+ */
+typedef struct {
+    uint64_t tick;
+    int64_t timeMs;
+    uint64_t rngState;
+    PCT_Player player;
+    PCT_PlayerAttackState attack;
+    uint32_t navTarget;
+    size_t enemyCapacity;
+    size_t enemyCount;
+    PCT_Entity enemies[];
+} PCT_SimState;
+
+/**
+ * @brief Ring buffer of the last PCT_SIM_HISTORY_SIZE ticks, state before the tick and its input.
+ * Snapshots are snapshotStride bytes apart, enough for a state of enemyCapacity enemies.
+ */
+typedef struct {
+    uint8_t *snapshots;
+    size_t snapshotStride;
+    size_t enemyCapacity;
+    PCT_TickInput inputs[PCT_SIM_HISTORY_SIZE];
+    uint64_t oldestTick;
+    size_t count;
+} PCT_SimHistory;
+
+/**
+ * @brief Creates state with room for enemyCapacity enemies, initialized by PCT_SimInit.
+ * User should call PCT_DestroySimState to free it.
+ */
+PCT_SimState *PCT_CreateSimState(size_t enemyCapacity, uint64_t seed);
+void PCT_DestroySimState(PCT_SimState *state);
+
+/**
+ * @brief Resets state to the start of a session, enemy capacity is kept.
+ */
+void PCT_SimInit(PCT_SimState *state, uint64_t seed);
+bool PCT_SimAddEnemy(PCT_SimState *state, const PCT_Entity *enemy);
+size_t PCT_SimStateSize(const PCT_SimState *state);
+
+/**
+ * @brief Next value of the per state random generator. Part of the state, so replays are exact.
+ */
+uint32_t PCT_SimRandom(PCT_SimState *state);
+
+void PCT_UpdatePlayer(PCT_Player *player, float controllerX, bool jump, int64_t deltaTimeMs,
+                      const PCT_KdTree *tree);
+void PCT_PlayerAttack(PCT_SimState *state, bool attack);
+PCT_AaBb PCT_PlayerAttackBox(const PCT_Player *player);
+
+/**
+ * @brief Movement abilities of enemies, the map navigation graph is built for these.
+ */
+PCT_NavAgent PCT_EnemyNavAgent(void);
+
+/**
+ * @brief Walks enemy, turning it at walls and at ledges found through map occupancy.
+ * @param steering overrides turning while enemy follows a flow field, NULL to patrol
+ */
+void PCT_UpdateEnemy(PCT_Entity *enemy, int64_t deltaTimeMs, const PCT_Map *map,
+                     const PCT_NavSteering *steering);
+
+/**
+ * @brief Advances state by one tick. Depends only on state, input and map, so replaying the same
+ * inputs from a snapshot gives the same result.
+ * @param flow field over map navigation steering enemies with a route to the player cheaper than
+ * PCT_NAV_CHASE_COST toward it, NULL to only patrol. Routes are a function of state->navTarget
+ * alone, so a field shared across ticks keeps replays exact. Enemies in the air keep their course
+ * while flow is used.
+ */
+void PCT_SimTick(PCT_SimState *state, const PCT_TickInput *input, const PCT_Map *map,
+                 PCT_FlowField *flow);
+
+/**
+ * @brief Creates history able to hold PCT_SIM_HISTORY_SIZE snapshots of states created with
+ * enemyCapacity. User should call PCT_DestroySimHistory to free it.
+ */
+PCT_SimHistory *PCT_CreateSimHistory(size_t enemyCapacity);
+void PCT_DestroySimHistory(PCT_SimHistory *history);
+
+/**
+ * @brief Snapshots state, records input for state->tick and advances state by one tick.
+ * The oldest snapshot is dropped once history is full.
+ */
+void PCT_SimAdvance(PCT_SimHistory *history, PCT_SimState *state, const PCT_TickInput *input,
+                    const PCT_Map *map, PCT_FlowField *flow);
+
+/**
+ * @brief Copies snapshot taken at the start of tick into state.
+ * @return false when tick is no longer or not yet in history
+ */
+bool PCT_SimRestore(const PCT_SimHistory *history, uint64_t tick, PCT_SimState *state);
+
+/**
+ * @brief Replaces recorded input of tick, e.g. when a late remote input arrives.
+ * @return false when tick is not in history
+ */
+bool PCT_SimSetInput(PCT_SimHistory *history, uint64_t tick, const PCT_TickInput *input);
+
+/**
+ * @brief Rolls state back to the start of tick and replays recorded inputs up to the tick state
+ * was at, refreshing the snapshots on the way.
+ * @return false when tick is not in history, state is left untouched then
+ */
+bool PCT_SimResimulate(PCT_SimHistory *history, uint64_t tick, PCT_SimState *state,
+                       const PCT_Map *map, PCT_FlowField *flow);
+
+#endif // PCT_SIMULATION
@@ -0,0 +1,185 @@
+#include "world.h"
+#include "../assets/assets.h"
+#include "../misc/errors.h"
+#include "../misc/threadPool.h"
+#include "../structures/structures.h"
+#include "simulation.h"
+#include <SDL3/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    PCT_World **worlds;
+    const PCT_TickInput *inputs;
+} PCT_TickWorldsContext;
+
+PCT_MapCache *PCT_CreateMapCache(const PCT_KdTreeBuildParams *params) {
+    PCT_MapCache *cache = calloc(1, sizeof(PCT_MapCache));
+    if (cache != NULL) {
+        cache->params = params != NULL ? *params : PCT_KdTreeDefaultBuildParams();
+        cache->lock = SDL_CreateMutex();
+    }
+    if (cache == NULL || cache->lock == NULL) {
+        printf("Failed to allocate map cache.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    return cache;
+}
+
+static void PCT_DestroyMap(PCT_Map *map) {
+    PCT_DestroyKdTree(map->tree);
+    PCT_DestroyOccupancyGrid(map->occupancy);
+    PCT_DestroyNavGraph(map->navigation);
+    free(map);
+}
+
+void PCT_DestroyMapCache(PCT_MapCache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < cache->count; i++) {
+        PCT_DestroyMap(cache->maps[i]);
+    }
+    free(cache->maps);
+    SDL_DestroyMutex(cache->lock);
+    free(cache);
+}
+
+static PCT_Map *PCT_LoadMap(const char *mapName, const PCT_KdTreeBuildParams *params) {
+    PCT_Map *map = calloc(1, sizeof(PCT_Map));
+    if (map == NULL) {
+        printf("Failed to allocate map.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    strncpy(map->name, mapName, PCT_MAP_NAME_MAX - 1);
+    size_t pointsRead = 0;
+    vec2 *mapPoints = PCT_ReadMapRaw(mapName, &pointsRead);
+    PCT_AaBb *mapRects = PCT_ParseMapRects(mapPoints, pointsRead, &map->rectCount);
+    free(mapPoints);
+    // Tree takes ownership of the rects it is built from, grid and navigation read a copy.
+    PCT_AaBb *treeRects = malloc(sizeof(PCT_AaBb) * (map->rectCount + 1));
+    if (treeRects == NULL) {
+        printf("Failed to allocate map.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    memcpy(treeRects, mapRects, sizeof(PCT_AaBb) * map->rectCount);
+    map->occupancy = PCT_BuildOccupancyGrid(mapRects, map->rectCount, PCT_OCCUPANCY_CELL_SIZE);
+    map->tree = PCT_BuildKdTreeWithParams(treeRects, map->rectCount, params);
+    PCT_NavAgent agent = PCT_EnemyNavAgent();
+    map->navigation = PCT_BuildNavGraph(mapRects, map->rectCount, map->tree, &agent);
+    free(mapRects);
+    return map;
+}
+
+const PCT_Map *PCT_MapCacheAcquire(PCT_MapCache *cache, const char *mapName) {
+    assert(cache != NULL);
+    assert(mapName != NULL);
+
+    SDL_LockMutex(cache->lock);
+    PCT_Map *map = NULL;
+    for (size_t i = 0; i < cache->count && map == NULL; i++) {
+        if (strncmp(cache->maps[i]->name, mapName, PCT_MAP_NAME_MAX - 1) == 0) {
+            map = cache->maps[i];
+        }
+    }
+    if (map == NULL) {
+        if (cache->count == cache->capacity) {
+            size_t capacity = cache->capacity > 0 ? cache->capacity * 2 : 4;
+            PCT_Map **maps = realloc(cache->maps, sizeof(PCT_Map *) * capacity);
+            if (maps == NULL) {
+                printf("Failed to grow map cache.\n");
+                exit(PCT_EXIT_CODE_MEMORY_ERROR);
+            }
+            cache->maps = maps;
+            cache->capacity = capacity;
+        }
+        map = PCT_LoadMap(mapName, &cache->params);
+        cache->maps[cache->count++] = map;
+    }
+    map->refCount++;
+    SDL_UnlockMutex(cache->lock);
+    return map;
+}
+
+void PCT_MapCacheRelease(PCT_MapCache *cache, const PCT_Map *map) {
+    assert(cache != NULL);
+
+    if (map == NULL) {
+        return;
+    }
+    SDL_LockMutex(cache->lock);
+    for (size_t i = 0; i < cache->count; i++) {
+        if (cache->maps[i] != map) {
+            continue;
+        }
+        if (--cache->maps[i]->refCount == 0) {
+            PCT_DestroyMap(cache->maps[i]);
+            cache->maps[i] = cache->maps[--cache->count];
+        }
+        break;
+    }
+    SDL_UnlockMutex(cache->lock);
+}
+
+PCT_World *PCT_CreateWorld(PCT_MapCache *cache, const char *mapName, const size_t enemyCapacity,
+                           const uint64_t seed, const bool keepHistory) {
+    PCT_World *world = calloc(1, sizeof(PCT_World));
+    if (world == NULL) {
+        printf("Failed to allocate world.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    world->mapCache = cache;
+    world->map = PCT_MapCacheAcquire(cache, mapName);
+    world->state = PCT_CreateSimState(enemyCapacity, seed);
+    world->history = keepHistory ? PCT_CreateSimHistory(enemyCapacity) : NULL;
+    world->flowField = PCT_CreateFlowField(world->map->navigation);
+    return world;
+}
+
+void PCT_DestroyWorld(PCT_World *world) {
+    if (world == NULL) {
+        return;
+    }
+    if (world->history != NULL) {
+        PCT_DestroySimHistory(world->history);
+    }
+    PCT_DestroyFlowField(world->flowField);
+    PCT_DestroySimState(world->state);
+    PCT_MapCacheRelease(world->mapCache, world->map);
+    free(world);
+}
+
+void PCT_WorldTick(PCT_World *world, const PCT_TickInput *input) {
+    assert(world != NULL);
+    assert(input != NULL);
+
+    if (world->history != NULL) {
+        PCT_SimAdvance(world->history, world->state, input, world->map, world->flowField);
+    } else {
+        PCT_SimTick(world->state, input, world->map, world->flowField);
+    }
+}
+
+void PCT_WorldBotInput(PCT_World *world, const int64_t deltaTimeMs, PCT_TickInput *input) {
+    assert(world != NULL);
+    assert(input != NULL);
+
+    uint32_t roll = PCT_SimRandom(world->state);
+    *input = (PCT_TickInput){.moveX = (float)((int32_t)(roll % 3) - 1),
+                             .jump = (roll >> 8) % 8 == 0,
+                             .attack = (roll >> 16) % 16 == 0,
+                             .deltaTimeMs = deltaTimeMs};
+}
+
+static void PCT_TickWorldTask(void *context, const size_t index) {
+    PCT_TickWorldsContext *worlds = context;
+    PCT_WorldTick(worlds->worlds[index], worlds->inputs + index);
+}
+
+void PCT_TickWorlds(PCT_ThreadPool *pool, PCT_World **worlds, const PCT_TickInput *inputs,
+                    const size_t count) {
+    PCT_TickWorldsContext context = {.worlds = worlds, .inputs = inputs};
+    PCT_ThreadPoolParallelFor(pool, count, PCT_TickWorldTask, &context);
+}
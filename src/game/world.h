@@ -0,0 +1,80 @@
+/**
+ * @file world.h
+ * Game instance context. A world owns its simulation state, random generator and timers and
+ * shares read-only map data with every other world running the same map, so a single process
+ * can host many independent sessions.
+ */
+#if !defined(PCT_WORLD)
+#define PCT_WORLD
+
+#include "../misc/threadPool.h"
+#include "../structures/structures.h"
+#include "map.h"
+#include "simulation.h"
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PCT_WORLD_DEFAULT_ENEMY_CAPACITY 64
+
+/**
+ * @brief Loads every map once and keeps it alive while some world uses it. Acquire and release
+ * are guarded, reading an acquired map needs no locking.
+ */
+typedef struct {
+    PCT_Map **maps;
+    size_t count;
+    size_t capacity;
+    PCT_KdTreeBuildParams params;
+    SDL_Mutex *lock;
+} PCT_MapCache;
+
+typedef struct {
+    PCT_MapCache *mapCache;
+    const PCT_Map *map;
+    PCT_SimState *state;
+    PCT_SimHistory *history;
+    PCT_FlowField *flowField;
+} PCT_World;
+
+/**
+ * @brief Creates empty cache building map trees with params.
+ * User should call PCT_DestroyMapCache once all worlds using it are destroyed.
+ */
+PCT_MapCache *PCT_CreateMapCache(const PCT_KdTreeBuildParams *params);
+void PCT_DestroyMapCache(PCT_MapCache *cache);
+
+/**
+ * @brief Returns map of given name, loading it on first use.
+ * Every acquire has to be matched by PCT_MapCacheRelease.
+ */
+const PCT_Map *PCT_MapCacheAcquire(PCT_MapCache *cache, const char *mapName);
+void PCT_MapCacheRelease(PCT_MapCache *cache, const PCT_Map *map);
+
+/**
+ * @brief Creates world playing mapName with room for enemyCapacity enemies.
+ * @param keepHistory whether ticks are recorded for rollback, see PCT_SimHistory
+ * User should call PCT_DestroyWorld to free it.
+ */
+PCT_World *PCT_CreateWorld(PCT_MapCache *cache, const char *mapName, size_t enemyCapacity,
+                           uint64_t seed, bool keepHistory);
+void PCT_DestroyWorld(PCT_World *world);
+
+/**
+ * @brief Advances world by one tick, recording it into history when kept.
+ */
+void PCT_WorldTick(PCT_World *world, const PCT_TickInput *input);
+
+/**
+ * @brief Fills input with a wandering bot driven by the world random generator.
+ */
+void PCT_WorldBotInput(PCT_World *world, int64_t deltaTimeMs, PCT_TickInput *input);
+
+/**
+ * @brief Ticks count worlds once each on pool, world i with inputs[i]. Worlds must be distinct.
+ */
+void PCT_TickWorlds(PCT_ThreadPool *pool, PCT_World **worlds, const PCT_TickInput *inputs,
+                    size_t count);
+
+#endif // PCT_WORLD
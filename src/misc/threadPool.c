@@ -0,0 +1,116 @@
+#include "threadPool.h"
+#include "errors.h"
+#include <SDL3/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void PCT_ThreadPoolRunTasks(PCT_ThreadPool *pool) {
+    size_t index;
+    while ((index = (size_t)SDL_AtomicAdd(&pool->nextIndex, 1)) < pool->taskCount) {
+        pool->task(pool->context, index);
+    }
+}
+
+static int PCT_ThreadPoolWorker(void *data) {
+    PCT_ThreadPool *pool = data;
+    uint64_t seenGeneration = 0;
+
+    SDL_LockMutex(pool->lock);
+    for (;;) {
+        while (!pool->shuttingDown && pool->generation == seenGeneration) {
+            SDL_WaitCondition(pool->workReady, pool->lock);
+        }
+        if (pool->shuttingDown) {
+            break;
+        }
+        seenGeneration = pool->generation;
+        SDL_UnlockMutex(pool->lock);
+
+        PCT_ThreadPoolRunTasks(pool);
+
+        SDL_LockMutex(pool->lock);
+        if (--pool->activeWorkers == 0) {
+            SDL_SignalCondition(pool->workDone);
+        }
+    }
+    SDL_UnlockMutex(pool->lock);
+    return 0;
+}
+
+PCT_ThreadPool *PCT_CreateThreadPool(size_t threadCount) {
+    if (threadCount == 0) {
+        Sint32 cpuCount = SDL_GetCPUCount();
+        threadCount = cpuCount > 1 ? (size_t)cpuCount - 1 : 0;
+    }
+    PCT_ThreadPool *pool = calloc(1, sizeof(PCT_ThreadPool));
+    if (pool != NULL) {
+        pool->threads = calloc(threadCount > 0 ? threadCount : 1, sizeof(SDL_Thread *));
+        pool->lock = SDL_CreateMutex();
+        pool->workReady = SDL_CreateCondition();
+        pool->workDone = SDL_CreateCondition();
+    }
+    if (pool == NULL || pool->threads == NULL || pool->lock == NULL || pool->workReady == NULL ||
+        pool->workDone == NULL) {
+        printf("Failed to allocate thread pool.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        pool->threads[i] = SDL_CreateThread(PCT_ThreadPoolWorker, "PCT_Worker", pool);
+        if (pool->threads[i] == NULL) {
+            SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to create worker: %s", SDL_GetError());
+            break;
+        }
+        pool->threadCount++;
+    }
+    return pool;
+}
+
+void PCT_DestroyThreadPool(PCT_ThreadPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    SDL_LockMutex(pool->lock);
+    pool->shuttingDown = true;
+    SDL_BroadcastCondition(pool->workReady);
+    SDL_UnlockMutex(pool->lock);
+    for (size_t i = 0; i < pool->threadCount; i++) {
+        SDL_WaitThread(pool->threads[i], NULL);
+    }
+    SDL_DestroyCondition(pool->workDone);
+    SDL_DestroyCondition(pool->workReady);
+    SDL_DestroyMutex(pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+void PCT_ThreadPoolParallelFor(PCT_ThreadPool *pool, const size_t count, PCT_ParallelTask task,
+                               void *context) {
+    assert(pool != NULL);
+    assert(task != NULL);
+
+    if (pool->threadCount == 0 || count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            task(context, i);
+        }
+        return;
+    }
+
+    SDL_LockMutex(pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->taskCount = count;
+    SDL_AtomicSet(&pool->nextIndex, 0);
+    pool->activeWorkers = pool->threadCount;
+    pool->generation++;
+    SDL_BroadcastCondition(pool->workReady);
+    SDL_UnlockMutex(pool->lock);
+
+    PCT_ThreadPoolRunTasks(pool);
+
+    SDL_LockMutex(pool->lock);
+    while (pool->activeWorkers > 0) {
+        SDL_WaitCondition(pool->workDone, pool->lock);
+    }
+    SDL_UnlockMutex(pool->lock);
+}
@@ -0,0 +1,48 @@
+/**
+ * @file threadPool.h
+ * Fixed set of worker threads running data parallel loops.
+ */
+#if !defined(PCT_THREAD_POOL)
+#define PCT_THREAD_POOL
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Task run once per index by PCT_ThreadPoolParallelFor.
+ */
+typedef void (*PCT_ParallelTask)(void *context, size_t index);
+
+typedef struct {
+    SDL_Thread **threads;
+    size_t threadCount;
+    SDL_Mutex *lock;
+    SDL_Condition *workReady;
+    SDL_Condition *workDone;
+    PCT_ParallelTask task;
+    void *context;
+    size_t taskCount;
+    SDL_AtomicInt nextIndex;
+    size_t activeWorkers;
+    uint64_t generation;
+    bool shuttingDown;
+} PCT_ThreadPool;
+
+/**
+ * @brief Starts threadCount workers, 0 picks one less than the number of CPUs since the calling
+ * thread helps with every loop. User should call PCT_DestroyThreadPool to stop and free them.
+ */
+PCT_ThreadPool *PCT_CreateThreadPool(size_t threadCount);
+void PCT_DestroyThreadPool(PCT_ThreadPool *pool);
+
+/**
+ * @brief Runs task for every index in [0, count) on the workers and the calling thread, returns
+ * once all of them finished. Indices are claimed one at a time, so tasks should be coarse.
+ * Must not be called concurrently or from within a task.
+ */
+void PCT_ThreadPoolParallelFor(PCT_ThreadPool *pool, size_t count, PCT_ParallelTask task,
+                               void *context);
+
+#endif // PCT_THREAD_POOL
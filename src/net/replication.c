@@ -0,0 +1,417 @@
+#include "replication.h"
+#include "../misc/errors.h"
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PCT_NET_HEADER_HAS_BASELINE 0x01
+
+typedef struct {
+    uint8_t *data;
+    size_t capacity;
+    size_t size;
+    uint64_t scratch;
+    uint32_t scratchBits;
+    bool overflow;
+} PCT_BitWriter;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t position;
+    uint64_t scratch;
+    uint32_t scratchBits;
+    bool overflow;
+} PCT_BitReader;
+
+static const PCT_NetEntity PCT_NET_ZERO_ENTITY = {0};
+
+static void PCT_BitWrite(PCT_BitWriter *writer, uint32_t value, uint32_t bits) {
+    writer->scratch |= (uint64_t)value << writer->scratchBits;
+    writer->scratchBits += bits;
+    while (writer->scratchBits >= 8) {
+        if (writer->size < writer->capacity) {
+            writer->data[writer->size++] = (uint8_t)writer->scratch;
+        } else {
+            writer->overflow = true;
+        }
+        writer->scratch >>= 8;
+        writer->scratchBits -= 8;
+    }
+}
+
+static void PCT_BitFlush(PCT_BitWriter *writer) {
+    if (writer->scratchBits > 0) {
+        PCT_BitWrite(writer, 0, 8 - writer->scratchBits);
+    }
+}
+
+static uint32_t PCT_BitRead(PCT_BitReader *reader, uint32_t bits) {
+    while (reader->scratchBits < bits) {
+        if (reader->position < reader->size) {
+            reader->scratch |= (uint64_t)reader->data[reader->position++] << reader->scratchBits;
+        } else {
+            reader->overflow = true;
+        }
+        reader->scratchBits += 8;
+    }
+    uint32_t value = (uint32_t)(reader->scratch & ((1ull << bits) - 1));
+    reader->scratch >>= bits;
+    reader->scratchBits -= bits;
+    return value;
+}
+
+/**
+ * @brief Prefix coded unsigned value, 5 bits up to 15, 10 bits up to 255, 19 bits up to 65535
+ * and 35 bits otherwise.
+ */
+static void PCT_WriteVarBits(PCT_BitWriter *writer, uint32_t value) {
+    if (value < (1u << 4)) {
+        PCT_BitWrite(writer, 0x0, 1);
+        PCT_BitWrite(writer, value, 4);
+    } else if (value < (1u << 8)) {
+        PCT_BitWrite(writer, 0x1, 2);
+        PCT_BitWrite(writer, value, 8);
+    } else if (value < (1u << 16)) {
+        PCT_BitWrite(writer, 0x3, 3);
+        PCT_BitWrite(writer, value, 16);
+    } else {
+        PCT_BitWrite(writer, 0x7, 3);
+        PCT_BitWrite(writer, value, 32);
+    }
+}
+
+static uint32_t PCT_ReadVarBits(PCT_BitReader *reader) {
+    if (PCT_BitRead(reader, 1) == 0) {
+        return PCT_BitRead(reader, 4);
+    }
+    if (PCT_BitRead(reader, 1) == 0) {
+        return PCT_BitRead(reader, 8);
+    }
+    if (PCT_BitRead(reader, 1) == 0) {
+        return PCT_BitRead(reader, 16);
+    }
+    return PCT_BitRead(reader, 32);
+}
+
+static void PCT_WriteDelta(PCT_BitWriter *writer, int32_t current, int32_t baseline) {
+    uint32_t delta = (uint32_t)current - (uint32_t)baseline;
+    PCT_WriteVarBits(writer, (delta << 1) ^ (uint32_t)(-(int32_t)(delta >> 31)));
+}
+
+static int32_t PCT_ReadDelta(PCT_BitReader *reader, int32_t baseline) {
+    uint32_t zigzag = PCT_ReadVarBits(reader);
+    uint32_t delta = (zigzag >> 1) ^ (uint32_t)(-(int32_t)(zigzag & 1));
+    return (int32_t)((uint32_t)baseline + delta);
+}
+
+static int32_t PCT_Quantize(float value, float scale) {
+    return (int32_t)floorf(value * scale + 0.5f);
+}
+
+static uint8_t PCT_NetEntityChanges(const PCT_NetEntity *current, const PCT_NetEntity *baseline) {
+    return (current->x != baseline->x ? PCT_NET_FIELD_X : 0) |
+           (current->y != baseline->y ? PCT_NET_FIELD_Y : 0) |
+           (current->velocityX != baseline->velocityX ? PCT_NET_FIELD_VELOCITY_X : 0) |
+           (current->velocityY != baseline->velocityY ? PCT_NET_FIELD_VELOCITY_Y : 0) |
+           (current->health != baseline->health ? PCT_NET_FIELD_HEALTH : 0) |
+           (current->flags != baseline->flags ? PCT_NET_FIELD_FLAGS : 0);
+}
+
+static void PCT_WriteNetEntity(PCT_BitWriter *writer, uint8_t changes,
+                               const PCT_NetEntity *current, const PCT_NetEntity *baseline) {
+    PCT_BitWrite(writer, changes, PCT_NET_FIELD_BITS);
+    if (changes & PCT_NET_FIELD_X) {
+        PCT_WriteDelta(writer, current->x, baseline->x);
+    }
+    if (changes & PCT_NET_FIELD_Y) {
+        PCT_WriteDelta(writer, current->y, baseline->y);
+    }
+    if (changes & PCT_NET_FIELD_VELOCITY_X) {
+        PCT_WriteDelta(writer, current->velocityX, baseline->velocityX);
+    }
+    if (changes & PCT_NET_FIELD_VELOCITY_Y) {
+        PCT_WriteDelta(writer, current->velocityY, baseline->velocityY);
+    }
+    if (changes & PCT_NET_FIELD_HEALTH) {
+        PCT_WriteDelta(writer, current->health, baseline->health);
+    }
+    if (changes & PCT_NET_FIELD_FLAGS) {
+        PCT_BitWrite(writer, current->flags, 8);
+    }
+}
+
+static void PCT_ReadNetEntity(PCT_BitReader *reader, PCT_NetEntity *entity) {
+    uint8_t changes = (uint8_t)PCT_BitRead(reader, PCT_NET_FIELD_BITS);
+    if (changes & PCT_NET_FIELD_X) {
+        entity->x = PCT_ReadDelta(reader, entity->x);
+    }
+    if (changes & PCT_NET_FIELD_Y) {
+        entity->y = PCT_ReadDelta(reader, entity->y);
+    }
+    if (changes & PCT_NET_FIELD_VELOCITY_X) {
+        entity->velocityX = PCT_ReadDelta(reader, entity->velocityX);
+    }
+    if (changes & PCT_NET_FIELD_VELOCITY_Y) {
+        entity->velocityY = PCT_ReadDelta(reader, entity->velocityY);
+    }
+    if (changes & PCT_NET_FIELD_HEALTH) {
+        entity->health = PCT_ReadDelta(reader, entity->health);
+    }
+    if (changes & PCT_NET_FIELD_FLAGS) {
+        entity->flags = (uint8_t)PCT_BitRead(reader, 8);
+    }
+}
+
+PCT_NetSnapshot *PCT_CreateNetSnapshot(size_t capacity) {
+    PCT_NetSnapshot *snapshot = calloc(1, sizeof(PCT_NetSnapshot));
+    if (snapshot != NULL) {
+        snapshot->capacity = capacity;
+        snapshot->entities = calloc(capacity > 0 ? capacity : 1, sizeof(PCT_NetEntity));
+    }
+    if (snapshot == NULL || snapshot->entities == NULL) {
+        printf("Failed to allocate net snapshot.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    return snapshot;
+}
+
+void PCT_DestroyNetSnapshot(PCT_NetSnapshot *snapshot) {
+    if (snapshot == NULL) {
+        return;
+    }
+    free(snapshot->entities);
+    free(snapshot);
+}
+
+void PCT_NetQuantizeEntity(const PCT_Entity *entity, PCT_NetEntity *result) {
+    result->x = PCT_Quantize(entity->location.x, PCT_NET_POSITION_SCALE);
+    result->y = PCT_Quantize(entity->location.y, PCT_NET_POSITION_SCALE);
+    result->velocityX = PCT_Quantize(entity->velocity.x, PCT_NET_VELOCITY_SCALE);
+    result->velocityY = PCT_Quantize(entity->velocity.y, PCT_NET_VELOCITY_SCALE);
+    result->health = PCT_Quantize(entity->health, PCT_NET_HEALTH_SCALE);
+    result->flags = entity->direction < 0.0f ? PCT_NET_FLAG_FACING_LEFT : 0;
+}
+
+void PCT_NetQuantizePlayer(const PCT_Player *player, PCT_NetEntity *result) {
+    result->x = PCT_Quantize(player->locationX, PCT_NET_POSITION_SCALE);
+    result->y = PCT_Quantize(player->locationY, PCT_NET_POSITION_SCALE);
+    result->velocityX = 0;
+    result->velocityY = PCT_Quantize(player->velocityY, PCT_NET_VELOCITY_SCALE);
+    result->health = 0;
+    result->flags = (player->direction < 0 ? PCT_NET_FLAG_FACING_LEFT : 0) |
+                    (player->isOnGround ? PCT_NET_FLAG_ON_GROUND : 0) |
+                    (player->isJumping ? PCT_NET_FLAG_JUMPING : 0) |
+                    (player->isAttacking ? PCT_NET_FLAG_ATTACKING : 0) |
+                    (uint8_t)(player->currentState << PCT_NET_FLAG_STATE_SHIFT);
+}
+
+void PCT_NetCaptureSnapshot(const PCT_SimState *state, PCT_NetSnapshot *snapshot) {
+    snapshot->tick = state->tick;
+    PCT_NetQuantizePlayer(&state->player, &snapshot->player);
+    snapshot->entityCount =
+        state->enemyCount < snapshot->capacity ? state->enemyCount : snapshot->capacity;
+    for (size_t i = 0; i < snapshot->entityCount; i++) {
+        PCT_NetQuantizeEntity(state->enemies + i, snapshot->entities + i);
+    }
+}
+
+void PCT_NetApplySnapshot(const PCT_NetSnapshot *snapshot, PCT_SimState *state) {
+    const PCT_NetEntity *player = &snapshot->player;
+    state->tick = snapshot->tick;
+    state->player.locationX = player->x / PCT_NET_POSITION_SCALE;
+    state->player.locationY = player->y / PCT_NET_POSITION_SCALE;
+    state->player.velocityY = player->velocityY / PCT_NET_VELOCITY_SCALE;
+    state->player.direction = (player->flags & PCT_NET_FLAG_FACING_LEFT) ? -1 : 1;
+    state->player.isOnGround = (player->flags & PCT_NET_FLAG_ON_GROUND) != 0;
+    state->player.isJumping = (player->flags & PCT_NET_FLAG_JUMPING) != 0;
+    state->player.isAttacking = (player->flags & PCT_NET_FLAG_ATTACKING) != 0;
+    state->player.currentState = (PCT_PlayerState)(player->flags >> PCT_NET_FLAG_STATE_SHIFT);
+
+    size_t count = snapshot->entityCount < state->enemyCapacity ? snapshot->entityCount
+                                                                : state->enemyCapacity;
+    for (size_t i = state->enemyCount; i < count; i++) {
+        state->enemies[i] = (PCT_Entity){0};
+    }
+    for (size_t i = 0; i < count; i++) {
+        const PCT_NetEntity *source = snapshot->entities + i;
+        PCT_Entity *enemy = state->enemies + i;
+        enemy->location.x = source->x / PCT_NET_POSITION_SCALE;
+        enemy->location.y = source->y / PCT_NET_POSITION_SCALE;
+        enemy->velocity.x = source->velocityX / PCT_NET_VELOCITY_SCALE;
+        enemy->velocity.y = source->velocityY / PCT_NET_VELOCITY_SCALE;
+        enemy->health = source->health / PCT_NET_HEALTH_SCALE;
+        enemy->direction = (source->flags & PCT_NET_FLAG_FACING_LEFT) ? -1.0f : 1.0f;
+    }
+    state->enemyCount = count;
+}
+
+size_t PCT_NetEncodeDelta(const PCT_NetSnapshot *baseline, const PCT_NetSnapshot *current,
+                          uint8_t *buffer, size_t capacity) {
+    PCT_BitWriter writer = {.data = buffer, .capacity = capacity};
+    PCT_BitWrite(&writer, baseline != NULL ? PCT_NET_HEADER_HAS_BASELINE : 0, 8);
+    PCT_BitWrite(&writer, (uint32_t)current->tick, 32);
+    PCT_BitWrite(&writer, (uint32_t)(current->tick >> 32), 32);
+    if (baseline != NULL) {
+        PCT_WriteVarBits(&writer, (uint32_t)(current->tick - baseline->tick));
+    }
+    PCT_WriteVarBits(&writer, (uint32_t)current->entityCount);
+
+    const PCT_NetEntity *basePlayer = baseline != NULL ? &baseline->player : &PCT_NET_ZERO_ENTITY;
+    PCT_WriteNetEntity(&writer, PCT_NetEntityChanges(&current->player, basePlayer),
+                       &current->player, basePlayer);
+
+    // Unchanged entities are skipped in runs, each changed entity is preceded by the run length
+    // and the stream ends with the run reaching entityCount.
+    size_t baseCount = baseline != NULL ? baseline->entityCount : 0;
+    uint32_t skipped = 0;
+    for (size_t i = 0; i < current->entityCount; i++) {
+        const PCT_NetEntity *base = i < baseCount ? baseline->entities + i : &PCT_NET_ZERO_ENTITY;
+        uint8_t changes = PCT_NetEntityChanges(current->entities + i, base);
+        if (changes == 0) {
+            skipped++;
+            continue;
+        }
+        PCT_WriteVarBits(&writer, skipped);
+        PCT_WriteNetEntity(&writer, changes, current->entities + i, base);
+        skipped = 0;
+    }
+    PCT_WriteVarBits(&writer, skipped);
+    PCT_BitFlush(&writer);
+    return writer.overflow ? 0 : writer.size;
+}
+
+bool PCT_NetDecodeDelta(const uint8_t *buffer, size_t size, PCT_NetSnapshot *snapshot) {
+    PCT_BitReader reader = {.data = buffer, .size = size};
+    uint8_t header = (uint8_t)PCT_BitRead(&reader, 8);
+    uint64_t tick = PCT_BitRead(&reader, 32);
+    tick |= (uint64_t)PCT_BitRead(&reader, 32) << 32;
+    bool hasBaseline = (header & PCT_NET_HEADER_HAS_BASELINE) != 0;
+    if (hasBaseline && tick - PCT_ReadVarBits(&reader) != snapshot->tick) {
+        return false;
+    }
+    size_t entityCount = PCT_ReadVarBits(&reader);
+    if (reader.overflow || entityCount > snapshot->capacity) {
+        return false;
+    }
+
+    if (!hasBaseline) {
+        snapshot->player = PCT_NET_ZERO_ENTITY;
+        snapshot->entityCount = 0;
+    }
+    if (entityCount > snapshot->entityCount) {
+        memset(snapshot->entities + snapshot->entityCount, 0,
+               sizeof(PCT_NetEntity) * (entityCount - snapshot->entityCount));
+    }
+    snapshot->entityCount = entityCount;
+    snapshot->tick = tick;
+
+    PCT_ReadNetEntity(&reader, &snapshot->player);
+    size_t index = 0;
+    while (!reader.overflow) {
+        index += PCT_ReadVarBits(&reader);
+        if (index >= entityCount) {
+            break;
+        }
+        PCT_ReadNetEntity(&reader, snapshot->entities + index);
+        index++;
+    }
+    return !reader.overflow && index == entityCount;
+}
+
+static bool PCT_NetSnapshotsEqual(const PCT_NetSnapshot *first, const PCT_NetSnapshot *second) {
+    if (first->tick != second->tick || first->entityCount != second->entityCount ||
+        PCT_NetEntityChanges(&first->player, &second->player) != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < first->entityCount; i++) {
+        if (PCT_NetEntityChanges(first->entities + i, second->entities + i) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PCT_NetRunLoopback(size_t entityCount, size_t ticks, FILE *out) {
+    PCT_Entity *entities = malloc(sizeof(PCT_Entity) * (entityCount > 0 ? entityCount : 1));
+    // Worst case every field changes and uses the widest code.
+    size_t bufferSize = 32 + (entityCount + 1) * 28;
+    uint8_t *buffer = malloc(bufferSize);
+    if (entities == NULL || buffer == NULL) {
+        printf("Failed to allocate loopback buffers.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    PCT_NetSnapshot *baseline = PCT_CreateNetSnapshot(entityCount);
+    PCT_NetSnapshot *current = PCT_CreateNetSnapshot(entityCount);
+    PCT_NetSnapshot *client = PCT_CreateNetSnapshot(entityCount);
+
+    for (size_t i = 0; i < entityCount; i++) {
+        entities[i] = (PCT_Entity){.location = {.x = (float)(i % 512) * 0.2f,
+                                                .y = (float)(i / 512) * 0.2f},
+                                   .velocity = {.x = (i % 10 == 0) ? 0.0f : 0.35f},
+                                   .health = 10.0f,
+                                   .direction = (i & 1) ? -1.0f : 1.0f};
+    }
+
+    const float deltaTimeS = 1.0f / 60.0f;
+    size_t fullBytes = 0;
+    size_t deltaBytes = 0;
+    Uint64 encodeTicks = 0;
+    Uint64 decodeTicks = 0;
+    bool inSync = true;
+    for (size_t tick = 0; tick <= ticks && inSync; tick++) {
+        // Every tenth entity idles, the rest patrol, turn around now and then and take damage.
+        for (size_t i = 0; i < entityCount; i++) {
+            PCT_Entity *entity = entities + i;
+            entity->location.x += entity->direction * entity->velocity.x * deltaTimeS;
+            if ((i + tick) % 120 == 0) {
+                entity->direction = -entity->direction;
+            }
+            if ((i + tick) % 997 == 0) {
+                entity->health -= 5.0f;
+            }
+        }
+        current->tick = tick;
+        current->entityCount = entityCount;
+        for (size_t i = 0; i < entityCount; i++) {
+            PCT_NetQuantizeEntity(entities + i, current->entities + i);
+        }
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        size_t bytes =
+            PCT_NetEncodeDelta(tick == 0 ? NULL : baseline, current, buffer, bufferSize);
+        Uint64 encoded = SDL_GetPerformanceCounter();
+        inSync = bytes > 0 && PCT_NetDecodeDelta(buffer, bytes, client);
+        Uint64 decoded = SDL_GetPerformanceCounter();
+        inSync = inSync && PCT_NetSnapshotsEqual(client, current);
+
+        if (tick == 0) {
+            fullBytes = bytes;
+        } else {
+            deltaBytes += bytes;
+            encodeTicks += encoded - start;
+            decodeTicks += decoded - encoded;
+        }
+        // Client acknowledges immediately, so the next delta is against this tick.
+        PCT_NetSnapshot *swap = baseline;
+        baseline = current;
+        current = swap;
+    }
+
+    double samples = (double)(ticks > 0 ? ticks : 1);
+    double nsPerEntity = 1e9 / (double)SDL_GetPerformanceFrequency() / samples /
+                         (double)(entityCount > 0 ? entityCount : 1);
+    fprintf(out,
+            "loopback %zu entities: full %zu B, delta %.1f B/tick, encode %.1f ns/entity, "
+            "decode %.1f ns/entity%s\n",
+            entityCount, fullBytes, deltaBytes / samples, encodeTicks * nsPerEntity,
+            decodeTicks * nsPerEntity, inSync ? "" : ", DESYNC");
+
+    PCT_DestroyNetSnapshot(client);
+    PCT_DestroyNetSnapshot(current);
+    PCT_DestroyNetSnapshot(baseline);
+    free(buffer);
+    free(entities);
+    return inSync;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file replication.h
+ * Compact binary snapshots of simulation state for replication. Positions and velocities are
+ * quantized, only fields that changed since a baseline acknowledged by the client are sent and the
+ * result is bit-packed.
+ */
+#if !defined(PCT_REPLICATION)
+#define PCT_REPLICATION
+
+#include "../entity.h"
+#include "../game/simulation.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PCT_NET_POSITION_SCALE 4096.0f
+#define PCT_NET_VELOCITY_SCALE 1024.0f
+#define PCT_NET_HEALTH_SCALE 16.0f
+
+#define PCT_NET_FIELD_X 0x01
+#define PCT_NET_FIELD_Y 0x02
+#define PCT_NET_FIELD_VELOCITY_X 0x04
+#define PCT_NET_FIELD_VELOCITY_Y 0x08
+#define PCT_NET_FIELD_HEALTH 0x10
+#define PCT_NET_FIELD_FLAGS 0x20
+#define PCT_NET_FIELD_BITS 6
+
+#define PCT_NET_FLAG_FACING_LEFT 0x01
+#define PCT_NET_FLAG_ON_GROUND 0x02
+#define PCT_NET_FLAG_JUMPING 0x04
+#define PCT_NET_FLAG_ATTACKING 0x08
+#define PCT_NET_FLAG_STATE_SHIFT 4
+
+/**
+ * @brief Quantized replicated state of a single entity, fixed point in units of 1/SCALE.
+ */
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t velocityX;
+    int32_t velocityY;
+    int32_t health;
+    uint8_t flags;
+} PCT_NetEntity;
+
+/**
+ * @brief Quantized state of one tick. Kept per client as the acknowledged baseline.
+ */
+typedef struct {
+    uint64_t tick;
+    PCT_NetEntity player;
+    size_t entityCount;
+    size_t capacity;
+    PCT_NetEntity *entities;
+} PCT_NetSnapshot;
+
+/**
+ * @brief Creates snapshot able to hold capacity entities.
+ * User should call PCT_DestroyNetSnapshot to free it.
+ */
+PCT_NetSnapshot *PCT_CreateNetSnapshot(size_t capacity);
+void PCT_DestroyNetSnapshot(PCT_NetSnapshot *snapshot);
+
+void PCT_NetQuantizeEntity(const PCT_Entity *entity, PCT_NetEntity *result);
+void PCT_NetQuantizePlayer(const PCT_Player *player, PCT_NetEntity *result);
+
+/**
+ * @brief Quantizes simulation state into snapshot, entities beyond its capacity are dropped.
+ */
+void PCT_NetCaptureSnapshot(const PCT_SimState *state, PCT_NetSnapshot *snapshot);
+
+/**
+ * @brief Writes dequantized snapshot back into simulation state. Only replicated fields of the
+ * player and enemies are touched.
+ */
+void PCT_NetApplySnapshot(const PCT_NetSnapshot *snapshot, PCT_SimState *state);
+
+/**
+ * @brief Encodes current as a delta against baseline in a single pass over both entity arrays.
+ * @param baseline last snapshot acknowledged by the receiver, NULL to send full state
+ * @return number of bytes written, 0 when buffer is too small
+ */
+size_t PCT_NetEncodeDelta(const PCT_NetSnapshot *baseline, const PCT_NetSnapshot *current,
+                          uint8_t *buffer, size_t capacity);
+
+/**
+ * @brief Applies delta in place. Snapshot has to hold the baseline the delta was encoded against,
+ * on success it holds the encoded snapshot.
+ * @return false when the delta is malformed, was encoded against a different baseline or does not
+ * fit snapshot capacity, snapshot may be partially updated then
+ */
+bool PCT_NetDecodeDelta(const uint8_t *buffer, size_t size, PCT_NetSnapshot *snapshot);
+
+/**
+ * @brief Runs server and client encoders over a loopback for ticks ticks with entityCount moving
+ * entities and prints bytes per tick and encode/decode time per entity to out.
+ * @return false when the client state diverged from the server
+ */
+bool PCT_NetRunLoopback(size_t entityCount, size_t ticks, FILE *out);
+
+#endif // PCT_REPLICATION
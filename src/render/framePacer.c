@@ -0,0 +1,135 @@
+#include "framePacer.h"
+#include <SDL3/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+void PCT_InitFramePacer(PCT_FramePacer *pacer, const float refreshRate) {
+    assert(pacer != NULL);
+
+    memset(pacer, 0, sizeof(PCT_FramePacer));
+    pacer->periodNs = (Uint64)(SDL_NS_PER_SECOND / (refreshRate > 0.0f ? refreshRate : 60.0f));
+}
+
+static Uint64 PCT_PredictFrameCost(const PCT_FramePacer *pacer) {
+    size_t count = SDL_min(pacer->costCount, (size_t)PCT_FRAME_PACER_HISTORY);
+    Uint64 cost = 0;
+    for (size_t i = 0; i < count; i++) {
+        cost = SDL_max(cost, pacer->costs[i]);
+    }
+    return cost + PCT_FRAME_PACER_MARGIN_NS;
+}
+
+void PCT_FramePacerWait(PCT_FramePacer *pacer) {
+    assert(pacer != NULL);
+
+    Uint64 nowNs = SDL_GetTicksNS();
+    // Present returns once the refresh it made happened, so the next one is a period later.
+    Uint64 deadlineNs =
+        pacer->lastPresentNs > 0 ? pacer->lastPresentNs + pacer->periodNs : nowNs + pacer->periodNs;
+    while (deadlineNs <= nowNs) {
+        deadlineNs += pacer->periodNs;
+    }
+    Uint64 costNs = PCT_PredictFrameCost(pacer);
+    Uint64 wakeNs = deadlineNs > costNs ? deadlineNs - costNs : 0;
+    if (nowNs < wakeNs) {
+        if (wakeNs - nowNs > PCT_FRAME_PACER_SPIN_NS) {
+            SDL_DelayNS(wakeNs - nowNs - PCT_FRAME_PACER_SPIN_NS);
+        }
+        while (SDL_GetTicksNS() < wakeNs) {
+        }
+        // Measured from the planned wake up, so oversleeping shows up in the prediction.
+        pacer->frameStartNs = wakeNs;
+    } else {
+        pacer->frameStartNs = nowNs;
+    }
+    pacer->deadlineNs = deadlineNs;
+}
+
+void PCT_FramePacerPresenting(PCT_FramePacer *pacer) {
+    assert(pacer != NULL);
+
+    if (pacer->frameStartNs == 0) {
+        return;
+    }
+    pacer->costs[pacer->costCount++ % PCT_FRAME_PACER_HISTORY] =
+        SDL_GetTicksNS() - pacer->frameStartNs;
+    pacer->frameStartNs = 0;
+}
+
+void PCT_FramePacerPresented(PCT_FramePacer *pacer, const Uint64 inputNs) {
+    assert(pacer != NULL);
+
+    Uint64 presentNs = SDL_GetTicksNS();
+    bool missed;
+    if (pacer->deadlineNs > 0) {
+        missed = presentNs > pacer->deadlineNs + pacer->periodNs / 2;
+    } else {
+        missed = pacer->lastPresentNs > 0 &&
+                 presentNs - pacer->lastPresentNs > pacer->periodNs + pacer->periodNs / 2;
+    }
+    pacer->deadlineNs = 0;
+    pacer->lastPresentNs = presentNs;
+
+    uint64_t latencyNs = presentNs > inputNs ? presentNs - inputNs : 0;
+    uint8_t bucket = (uint8_t)SDL_min(latencyNs / PCT_LATENCY_BUCKET_NS,
+                                      (uint64_t)PCT_LATENCY_BUCKETS - 1);
+    size_t slot = pacer->frameCount % PCT_LATENCY_FRAMES;
+    if (pacer->frameCount >= PCT_LATENCY_FRAMES) {
+        pacer->buckets[pacer->frameBuckets[slot]]--;
+        pacer->recentMissed -= pacer->frameMissed[slot];
+    }
+    pacer->frameBuckets[slot] = bucket;
+    pacer->frameMissed[slot] = missed;
+    pacer->buckets[bucket]++;
+    pacer->recentMissed += missed;
+
+    pacer->frameCount++;
+    pacer->missed += missed;
+    pacer->latencyNs += latencyNs;
+    pacer->maxLatencyNs = SDL_max(pacer->maxLatencyNs, latencyNs);
+}
+
+uint8_t PCT_FramePacerRecentBucket(const PCT_FramePacer *pacer, const size_t frame,
+                                   bool *missed) {
+    assert(pacer != NULL);
+    assert(frame < PCT_LATENCY_FRAMES);
+
+    size_t recent = (size_t)SDL_min(pacer->frameCount, (uint64_t)PCT_LATENCY_FRAMES);
+    if (frame >= recent) {
+        *missed = false;
+        return 0;
+    }
+    size_t slot = (size_t)((pacer->frameCount - recent + frame) % PCT_LATENCY_FRAMES);
+    *missed = pacer->frameMissed[slot];
+    return pacer->frameBuckets[slot];
+}
+
+void PCT_PrintFramePacer(const PCT_FramePacer *pacer, FILE *stream) {
+    if (pacer->frameCount == 0) {
+        return;
+    }
+    // Median and 99th percentile of the recent frames, to bucket precision.
+    size_t recent = (size_t)SDL_min(pacer->frameCount, (uint64_t)PCT_LATENCY_FRAMES);
+    size_t median = PCT_LATENCY_BUCKETS - 1, high = PCT_LATENCY_BUCKETS - 1;
+    size_t seen = 0;
+    for (size_t i = 0; i < PCT_LATENCY_BUCKETS; i++) {
+        size_t before = seen;
+        seen += pacer->buckets[i];
+        if (before * 2 < recent && seen * 2 >= recent) {
+            median = i;
+        }
+        if (before * 100 < recent * 99 && seen * 100 >= recent * 99) {
+            high = i;
+        }
+    }
+    fprintf(stream,
+            "latency: %llu frames, %.2f ms avg %.2f max, recent median under %.0f ms 99%% under "
+            "%.0f ms, %llu missed refreshes (%.1f%%) at %.2f ms\n",
+            (unsigned long long)pacer->frameCount,
+            (double)pacer->latencyNs / (double)pacer->frameCount / 1e6,
+            (double)pacer->maxLatencyNs / 1e6, (double)((median + 1) * PCT_LATENCY_BUCKET_NS) / 1e6,
+            (double)((high + 1) * PCT_LATENCY_BUCKET_NS) / 1e6, (unsigned long long)pacer->missed,
+            100.0 * (double)pacer->missed / (double)pacer->frameCount,
+            (double)pacer->periodNs / 1e6);
+}
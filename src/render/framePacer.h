@@ -0,0 +1,80 @@
+/**
+ * @file framePacer.h
+ * Frame pacing for low input latency. Instead of sampling input right after the previous present
+ * and then waiting on vsync, the pacer sleeps until the latest moment the frame can still start
+ * and make the next refresh, predicted from the cost of recent frames. Also records input to
+ * present latency and missed refreshes of every frame, paced or not.
+ */
+#if !defined(PCT_FRAME_PACER)
+#define PCT_FRAME_PACER
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Frames the cost prediction looks back on, the most expensive one of them is expected next.
+#define PCT_FRAME_PACER_HISTORY 16
+// Headroom on top of the prediction for present itself.
+#define PCT_FRAME_PACER_MARGIN_NS SDL_MS_TO_NS(1)
+// Sleeps overshoot by up to a scheduler tick, the end of the wait spins instead.
+#define PCT_FRAME_PACER_SPIN_NS SDL_MS_TO_NS(1)
+#define PCT_LATENCY_BUCKET_NS SDL_MS_TO_NS(1)
+#define PCT_LATENCY_BUCKETS 48
+// Frames the latency histogram covers, older ones drop out of it as new ones come.
+#define PCT_LATENCY_FRAMES 240
+
+/**
+ * @brief Pacing state and latency records. Latency is bucketed by PCT_LATENCY_BUCKET_NS, the
+ * last bucket also holds everything slower. Buckets and recentMissed cover the last
+ * PCT_LATENCY_FRAMES frames, the remaining counters every frame.
+ */
+typedef struct {
+    Uint64 periodNs;
+    Uint64 lastPresentNs;
+    Uint64 deadlineNs;
+    Uint64 frameStartNs;
+    Uint64 costs[PCT_FRAME_PACER_HISTORY];
+    size_t costCount;
+    uint8_t frameBuckets[PCT_LATENCY_FRAMES];
+    bool frameMissed[PCT_LATENCY_FRAMES];
+    uint32_t buckets[PCT_LATENCY_BUCKETS];
+    uint32_t recentMissed;
+    uint64_t frameCount;
+    uint64_t missed;
+    uint64_t latencyNs;
+    uint64_t maxLatencyNs;
+} PCT_FramePacer;
+
+/**
+ * @brief Resets pacer for a display refreshing refreshRate times a second, 0 assumes 60.
+ */
+void PCT_InitFramePacer(PCT_FramePacer *pacer, float refreshRate);
+
+/**
+ * @brief Sleeps until the predicted latest start of a frame that still presents before the next
+ * refresh. Input should be sampled right after it returns.
+ */
+void PCT_FramePacerWait(PCT_FramePacer *pacer);
+
+/**
+ * @brief Records cost of the frame started by PCT_FramePacerWait, call right before present.
+ */
+void PCT_FramePacerPresenting(PCT_FramePacer *pacer);
+
+/**
+ * @brief Records latency from inputNs, the SDL_GetTicksNS time input of the presented frame was
+ * sampled, to now. A paced frame misses when present returns over half a refresh after its
+ * deadline, an unpaced one when it returns over one and a half refreshes after the previous one.
+ */
+void PCT_FramePacerPresented(PCT_FramePacer *pacer, Uint64 inputNs);
+
+/**
+ * @brief Bucket holding latency of frame, 0 for the oldest of the last PCT_LATENCY_FRAMES.
+ */
+uint8_t PCT_FramePacerRecentBucket(const PCT_FramePacer *pacer, size_t frame, bool *missed);
+
+void PCT_PrintFramePacer(const PCT_FramePacer *pacer, FILE *stream);
+
+#endif // PCT_FRAME_PACER
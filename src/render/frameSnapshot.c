@@ -0,0 +1,161 @@
+#include "frameSnapshot.h"
+#include "../misc/errors.h"
+#include <SDL3/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PCT_FRAME_SNAPSHOT_FRESH 0x4
+#define PCT_FRAME_SNAPSHOT_INDEX 0x3
+
+PCT_FrameSnapshotBuffer *PCT_CreateFrameSnapshotBuffer(const size_t enemyCapacity) {
+    PCT_FrameSnapshotBuffer *buffer = calloc(1, sizeof(PCT_FrameSnapshotBuffer));
+    if (buffer == NULL) {
+        printf("Failed to allocate frame snapshots.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    for (size_t i = 0; i < PCT_FRAME_SNAPSHOT_COUNT; i++) {
+        buffer->snapshots[i].state = PCT_CreateSimState(enemyCapacity, 0);
+    }
+    buffer->writing = 0;
+    SDL_AtomicSet(&buffer->ready, 1);
+    buffer->reading = 2;
+    return buffer;
+}
+
+void PCT_DestroyFrameSnapshotBuffer(PCT_FrameSnapshotBuffer *buffer) {
+    if (buffer == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < PCT_FRAME_SNAPSHOT_COUNT; i++) {
+        PCT_DestroySimState(buffer->snapshots[i].state);
+        free(buffer->snapshots[i].mapBoxes);
+    }
+    free(buffer);
+}
+
+void PCT_ReserveSnapshotMapBoxes(PCT_FrameSnapshot *snapshot, const size_t count) {
+    if (count <= snapshot->mapBoxCapacity) {
+        return;
+    }
+    size_t capacity = snapshot->mapBoxCapacity > 0 ? snapshot->mapBoxCapacity : 256;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    PCT_LodBox *boxes = realloc(snapshot->mapBoxes, sizeof(PCT_LodBox) * capacity);
+    if (boxes == NULL) {
+        printf("Failed to grow frame snapshot.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    snapshot->mapBoxes = boxes;
+    snapshot->mapBoxCapacity = capacity;
+}
+
+PCT_FrameSnapshot *PCT_FrameSnapshotWriting(PCT_FrameSnapshotBuffer *buffer) {
+    assert(buffer != NULL);
+    return buffer->snapshots + buffer->writing;
+}
+
+void PCT_PublishFrameSnapshot(PCT_FrameSnapshotBuffer *buffer) {
+    assert(buffer != NULL);
+
+    PCT_FrameSnapshot *snapshot = buffer->snapshots + buffer->writing;
+    snapshot->sequence = ++buffer->sequence;
+    snapshot->publishNs = SDL_GetTicksNS();
+    // Contents have to be visible before the index is.
+    SDL_MemoryBarrierRelease();
+    Sint32 previous = SDL_AtomicSet(&buffer->ready, buffer->writing | PCT_FRAME_SNAPSHOT_FRESH);
+    buffer->writing = previous & PCT_FRAME_SNAPSHOT_INDEX;
+}
+
+const PCT_FrameSnapshot *PCT_AcquireFrameSnapshot(PCT_FrameSnapshotBuffer *buffer) {
+    assert(buffer != NULL);
+
+    PCT_FrameMetrics *metrics = &buffer->metrics;
+    metrics->frames++;
+    // Only the reader clears the fresh flag, so it is still set when the exchange happens.
+    if ((SDL_AtomicGet(&buffer->ready) & PCT_FRAME_SNAPSHOT_FRESH) == 0) {
+        buffer->acquireNs = SDL_GetTicksNS();
+        metrics->repeated++;
+    } else {
+        Sint32 previous = SDL_AtomicSet(&buffer->ready, buffer->reading);
+        SDL_MemoryBarrierAcquire();
+        buffer->acquireNs = SDL_GetTicksNS();
+        buffer->reading = previous & PCT_FRAME_SNAPSHOT_INDEX;
+        const PCT_FrameSnapshot *snapshot = buffer->snapshots + buffer->reading;
+        uint64_t depth = snapshot->sequence - buffer->drawnSequence;
+        buffer->drawnSequence = snapshot->sequence;
+        metrics->depth += depth;
+        metrics->maxDepth = SDL_max(metrics->maxDepth, depth);
+        metrics->dropped += depth - 1;
+        uint64_t ageNs = buffer->acquireNs - snapshot->publishNs;
+        metrics->ageNs += ageNs;
+        metrics->maxAgeNs = SDL_max(metrics->maxAgeNs, ageNs);
+        metrics->simNs += snapshot->simNs;
+        metrics->maxSimNs = SDL_max(metrics->maxSimNs, snapshot->simNs);
+    }
+    const PCT_FrameSnapshot *snapshot = buffer->snapshots + buffer->reading;
+    return snapshot->sequence > 0 ? snapshot : NULL;
+}
+
+void PCT_FrameSnapshotPresented(PCT_FrameSnapshotBuffer *buffer,
+                                const PCT_FrameSnapshot *snapshot) {
+    assert(buffer != NULL);
+    assert(snapshot != NULL);
+
+    PCT_FrameMetrics *metrics = &buffer->metrics;
+    Uint64 presentNs = SDL_GetTicksNS();
+    // Repeated frames count too, their latency is how stale the picture on screen is.
+    uint64_t latencyNs = presentNs - snapshot->inputNs;
+    metrics->latencyNs += latencyNs;
+    metrics->maxLatencyNs = SDL_max(metrics->maxLatencyNs, latencyNs);
+    uint64_t renderNs = presentNs - buffer->acquireNs;
+    metrics->renderNs += renderNs;
+    metrics->maxRenderNs = SDL_max(metrics->maxRenderNs, renderNs);
+}
+
+void PCT_RollFrameMetrics(PCT_FrameSnapshotBuffer *buffer, PCT_FrameMetrics *window,
+                          PCT_FrameMetrics *total) {
+    assert(buffer != NULL);
+
+    const PCT_FrameMetrics *metrics = &buffer->metrics;
+    if (window != NULL) {
+        *window = *metrics;
+    }
+    if (total != NULL) {
+        total->frames += metrics->frames;
+        total->repeated += metrics->repeated;
+        total->dropped += metrics->dropped;
+        total->depth += metrics->depth;
+        total->maxDepth = SDL_max(total->maxDepth, metrics->maxDepth);
+        total->ageNs += metrics->ageNs;
+        total->maxAgeNs = SDL_max(total->maxAgeNs, metrics->maxAgeNs);
+        total->latencyNs += metrics->latencyNs;
+        total->maxLatencyNs = SDL_max(total->maxLatencyNs, metrics->maxLatencyNs);
+        total->simNs += metrics->simNs;
+        total->maxSimNs = SDL_max(total->maxSimNs, metrics->maxSimNs);
+        total->renderNs += metrics->renderNs;
+        total->maxRenderNs = SDL_max(total->maxRenderNs, metrics->maxRenderNs);
+    }
+    buffer->metrics = (PCT_FrameMetrics){0};
+}
+
+void PCT_PrintFrameMetrics(const PCT_FrameMetrics *metrics, FILE *stream) {
+    if (metrics->frames == 0) {
+        return;
+    }
+    double frames = (double)metrics->frames;
+    uint64_t drawn = metrics->frames - metrics->repeated;
+    double snapshots = drawn > 0 ? (double)drawn : 1.0;
+    fprintf(stream,
+            "frames: %llu, %llu repeated, %llu snapshots dropped, depth %.2f avg %llu max, age "
+            "%.2f ms avg %.2f max, latency %.2f ms avg %.2f max, sim %.2f ms avg %.2f max, render "
+            "%.2f ms avg %.2f max\n",
+            (unsigned long long)metrics->frames, (unsigned long long)metrics->repeated,
+            (unsigned long long)metrics->dropped, (double)metrics->depth / snapshots,
+            (unsigned long long)metrics->maxDepth, (double)metrics->ageNs / snapshots / 1e6,
+            (double)metrics->maxAgeNs / 1e6, (double)metrics->latencyNs / frames / 1e6,
+            (double)metrics->maxLatencyNs / 1e6, (double)metrics->simNs / snapshots / 1e6,
+            (double)metrics->maxSimNs / 1e6, (double)metrics->renderNs / frames / 1e6,
+            (double)metrics->maxRenderNs / 1e6);
+}
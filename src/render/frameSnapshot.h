@@ -0,0 +1,120 @@
+/**
+ * @file frameSnapshot.h
+ * Hand off of simulated frames to the renderer. The simulation thread copies everything a frame
+ * draws into a snapshot and publishes it, the render thread draws the newest published one.
+ * Three snapshots rotate between writer, reader and the newest published, so neither side ever
+ * waits for the other.
+ */
+#if !defined(PCT_FRAME_SNAPSHOT)
+#define PCT_FRAME_SNAPSHOT
+
+#include "../game/simulation.h"
+#include "../structures/structures.h"
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PCT_FRAME_SNAPSHOT_COUNT 3
+
+/**
+ * @brief Immutable once published. State is a full copy of the simulation, map boxes are the
+ * result of the LOD query of the camera view. Times are SDL_GetTicksNS values, inputNs is when
+ * the main thread sampled the input the tick read.
+ */
+typedef struct {
+    uint64_t sequence;
+    Uint64 inputNs;
+    Uint64 publishNs;
+    Uint64 simNs;
+    float cameraX;
+    float cameraY;
+    PCT_SimState *state;
+    PCT_LodBox *mapBoxes;
+    size_t mapBoxCount;
+    size_t mapBoxCapacity;
+} PCT_FrameSnapshot;
+
+/**
+ * @brief Counters of drawn frames. Depth is the number of snapshots published since the previous
+ * drawn one, so every frame with depth above 1 dropped snapshots the renderer was too slow for and
+ * repeated frames had none to draw. Age is from publish to draw, latency from sampling the
+ * input to present returning, render time from picking the snapshot up to present returning.
+ */
+typedef struct {
+    uint64_t frames;
+    uint64_t repeated;
+    uint64_t dropped;
+    uint64_t depth;
+    uint64_t maxDepth;
+    uint64_t ageNs;
+    uint64_t maxAgeNs;
+    uint64_t latencyNs;
+    uint64_t maxLatencyNs;
+    uint64_t simNs;
+    uint64_t maxSimNs;
+    uint64_t renderNs;
+    uint64_t maxRenderNs;
+} PCT_FrameMetrics;
+
+/**
+ * @brief Triple buffer of snapshots with a single writer and a single reader. Ready holds the
+ * index of the newest published snapshot and PCT_FRAME_SNAPSHOT_FRESH while the reader has not
+ * taken it yet, writing is owned by the writer, reading and metrics by the reader.
+ */
+typedef struct {
+    PCT_FrameSnapshot snapshots[PCT_FRAME_SNAPSHOT_COUNT];
+    SDL_AtomicInt ready;
+    int32_t writing;
+    uint64_t sequence;
+    int32_t reading;
+    uint64_t drawnSequence;
+    Uint64 acquireNs;
+    PCT_FrameMetrics metrics;
+} PCT_FrameSnapshotBuffer;
+
+/**
+ * @brief Creates buffer of snapshots holding states of enemyCapacity enemies.
+ * User should call PCT_DestroyFrameSnapshotBuffer to free it.
+ */
+PCT_FrameSnapshotBuffer *PCT_CreateFrameSnapshotBuffer(size_t enemyCapacity);
+void PCT_DestroyFrameSnapshotBuffer(PCT_FrameSnapshotBuffer *buffer);
+
+/**
+ * @brief Grows map boxes of snapshot to hold at least count boxes, writer side only.
+ */
+void PCT_ReserveSnapshotMapBoxes(PCT_FrameSnapshot *snapshot, size_t count);
+
+/**
+ * @brief Snapshot the writer fills next. It is not seen by the reader until published.
+ */
+PCT_FrameSnapshot *PCT_FrameSnapshotWriting(PCT_FrameSnapshotBuffer *buffer);
+
+/**
+ * @brief Makes the snapshot being written the newest one and hands the writer the snapshot it
+ * replaced, or the one the reader just released. Never blocks.
+ */
+void PCT_PublishFrameSnapshot(PCT_FrameSnapshotBuffer *buffer);
+
+/**
+ * @brief Takes the newest published snapshot, keeps the current one when nothing was published
+ * since. The snapshot stays valid until the next acquire. Never blocks.
+ * @return NULL before the first publish
+ */
+const PCT_FrameSnapshot *PCT_AcquireFrameSnapshot(PCT_FrameSnapshotBuffer *buffer);
+
+/**
+ * @brief Records latency and render time of snapshot, call once present returned.
+ */
+void PCT_FrameSnapshotPresented(PCT_FrameSnapshotBuffer *buffer,
+                                const PCT_FrameSnapshot *snapshot);
+
+/**
+ * @brief Moves metrics gathered since the previous roll into window and adds them to total.
+ */
+void PCT_RollFrameMetrics(PCT_FrameSnapshotBuffer *buffer, PCT_FrameMetrics *window,
+                          PCT_FrameMetrics *total);
+void PCT_PrintFrameMetrics(const PCT_FrameMetrics *metrics, FILE *stream);
+
+#endif // PCT_FRAME_SNAPSHOT
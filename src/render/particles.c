@@ -0,0 +1,346 @@
+#include "particles.h"
+#include "../game/simulation.h"
+#include "../misc/errors.h"
+#include "../structures/structures.h"
+#include <SDL3/SDL.h>
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(PCT_PARTICLES_SSE)
+#include <xmmintrin.h>
+#endif
+
+#define PCT_PARTICLE_ARRAYS 6
+#define PCT_PARTICLE_GROUND_FRICTION 0.6f
+// Bounce speed below which a particle landing on ground stops moving.
+#define PCT_PARTICLE_REST_SPEED 0.05f
+
+static float PCT_ParticleRandom(PCT_ParticleSystem *system, const float min, const float max) {
+    uint64_t x = system->rngState;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    system->rngState = x;
+    float unit = (float)((x * 0x2545F4914F6CDD1Dull) >> 40) / (float)(1u << 24);
+    return min + (max - min) * unit;
+}
+
+static inline void PCT_MoveParticle(PCT_ParticleEmitter *emitter, const size_t to,
+                                    const size_t from) {
+    emitter->x[to] = emitter->x[from];
+    emitter->y[to] = emitter->y[from];
+    emitter->velocityX[to] = emitter->velocityX[from];
+    emitter->velocityY[to] = emitter->velocityY[from];
+    emitter->life[to] = emitter->life[from];
+    emitter->inverseLifetime[to] = emitter->inverseLifetime[from];
+}
+
+static void PCT_ParticleGeometryReserve(PCT_ParticleSystem *system, const size_t capacity) {
+    if (capacity <= system->quadCapacity) {
+        return;
+    }
+    SDL_Vertex *vertices = realloc(system->vertices, sizeof(SDL_Vertex) * 4 * capacity);
+    system->vertices = vertices != NULL ? vertices : system->vertices;
+    Sint32 *indices = realloc(system->indices, sizeof(Sint32) * 6 * capacity);
+    system->indices = indices != NULL ? indices : system->indices;
+    if (vertices == NULL || indices == NULL) {
+        printf("Failed to grow particle geometry.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    for (size_t i = system->quadCapacity; i < capacity; i++) {
+        Sint32 first = (Sint32)(i * 4);
+        Sint32 *quad = system->indices + i * 6;
+        quad[0] = first;
+        quad[1] = first + 1;
+        quad[2] = first + 2;
+        quad[3] = first + 2;
+        quad[4] = first + 3;
+        quad[5] = first;
+    }
+    system->quadCapacity = capacity;
+}
+
+PCT_ParticleSystem *PCT_CreateParticleSystem(const PCT_OccupancyGrid *occupancy,
+                                             const uint64_t seed) {
+    PCT_ParticleSystem *system = calloc(1, sizeof(PCT_ParticleSystem));
+    if (system == NULL) {
+        printf("Failed to allocate particle system.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    system->occupancy = occupancy;
+    system->rngState = seed != 0 ? seed : 0x9E3779B97F4A7C15ull;
+    return system;
+}
+
+void PCT_DestroyParticleSystem(PCT_ParticleSystem *system) {
+    if (system == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < system->emitterCount; i++) {
+        free(system->emitters[i].storage);
+    }
+    free(system->emitters);
+    free(system->vertices);
+    free(system->indices);
+    free(system);
+}
+
+size_t PCT_AddParticleEmitter(PCT_ParticleSystem *system, const PCT_ParticleEmitterDesc *desc) {
+    assert(system != NULL);
+    assert(desc != NULL);
+
+    if (system->emitterCount == system->emitterCapacity) {
+        size_t capacity = system->emitterCapacity > 0 ? system->emitterCapacity * 2 : 4;
+        PCT_ParticleEmitter *emitters =
+            realloc(system->emitters, sizeof(PCT_ParticleEmitter) * capacity);
+        if (emitters == NULL) {
+            printf("Failed to grow particle emitters.\n");
+            exit(PCT_EXIT_CODE_MEMORY_ERROR);
+        }
+        system->emitters = emitters;
+        system->emitterCapacity = capacity;
+    }
+
+    // One zeroed block holds all arrays, each padded to whole groups and aligned for vector
+    // loads. Lanes past count then always hold finite values.
+    size_t padded = (desc->capacity + PCT_PARTICLE_LANES - 1) / PCT_PARTICLE_LANES *
+                    PCT_PARTICLE_LANES;
+    void *storage =
+        calloc(sizeof(float) * padded * PCT_PARTICLE_ARRAYS + PCT_PARTICLE_ALIGNMENT, 1);
+    if (storage == NULL) {
+        printf("Failed to allocate particle pool.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    uintptr_t aligned = ((uintptr_t)storage + PCT_PARTICLE_ALIGNMENT - 1) &
+                        ~(uintptr_t)(PCT_PARTICLE_ALIGNMENT - 1);
+    float *arrays = (float *)aligned;
+    PCT_ParticleEmitter *emitter = system->emitters + system->emitterCount;
+    *emitter = (PCT_ParticleEmitter){.desc = *desc,
+                                     .x = arrays,
+                                     .y = arrays + padded,
+                                     .velocityX = arrays + padded * 2,
+                                     .velocityY = arrays + padded * 3,
+                                     .life = arrays + padded * 4,
+                                     .inverseLifetime = arrays + padded * 5,
+                                     .storage = storage};
+
+    size_t quadCapacity = 0;
+    for (size_t i = 0; i <= system->emitterCount; i++) {
+        quadCapacity += system->emitters[i].desc.capacity;
+    }
+    PCT_ParticleGeometryReserve(system, quadCapacity);
+    return system->emitterCount++;
+}
+
+size_t PCT_EmitParticles(PCT_ParticleSystem *system, const size_t emitter, const PCT_Point *origin,
+                         const float direction, const size_t count) {
+    assert(system != NULL);
+    assert(emitter < system->emitterCount);
+    assert(origin != NULL);
+
+    PCT_ParticleEmitter *pool = system->emitters + emitter;
+    const PCT_ParticleEmitterDesc *desc = &pool->desc;
+    size_t spawned = SDL_min(count, desc->capacity - pool->count);
+    float angle = direction < 0.0f ? GLM_PIf - desc->angle : desc->angle;
+    for (size_t n = 0; n < spawned; n++) {
+        // New particles move, the resting one in their place goes to the end.
+        size_t i = pool->movingCount++;
+        PCT_MoveParticle(pool, pool->count++, i);
+        float heading =
+            angle + PCT_ParticleRandom(system, -desc->spread * 0.5f, desc->spread * 0.5f);
+        float speed = PCT_ParticleRandom(system, desc->speedMin, desc->speedMax);
+        float lifetime = PCT_ParticleRandom(system, desc->lifetimeMin, desc->lifetimeMax);
+        pool->x[i] = origin->x;
+        pool->y[i] = origin->y;
+        pool->velocityX[i] = cosf(heading) * speed;
+        pool->velocityY[i] = sinf(heading) * speed;
+        pool->life[i] = lifetime;
+        pool->inverseLifetime[i] = lifetime > 0.0f ? 1.0f / lifetime : 0.0f;
+    }
+    return spawned;
+}
+
+/*
+ * Only moving particles are integrated, in whole groups and a scalar tail so resting ones right
+ * after them are not touched. Life runs out for all of them.
+ */
+static void PCT_IntegrateParticles(PCT_ParticleEmitter *emitter, const float deltaTimeS) {
+    size_t end = (emitter->count + PCT_PARTICLE_LANES - 1) / PCT_PARTICLE_LANES *
+                 PCT_PARTICLE_LANES;
+    float gravityStep = PCT_GRAVITY * emitter->desc.gravityScale * deltaTimeS;
+    float damping = fmaxf(1.0f - emitter->desc.drag * deltaTimeS, 0.0f);
+    size_t i = 0;
+#if defined(PCT_PARTICLES_SSE)
+    __m128 time = _mm_set1_ps(deltaTimeS);
+    __m128 gravity = _mm_set1_ps(gravityStep);
+    __m128 drag = _mm_set1_ps(damping);
+    size_t groups = emitter->movingCount / PCT_PARTICLE_LANES * PCT_PARTICLE_LANES;
+    for (; i < groups; i += PCT_PARTICLE_LANES) {
+        __m128 velocityX = _mm_mul_ps(_mm_load_ps(emitter->velocityX + i), drag);
+        __m128 velocityY =
+            _mm_mul_ps(_mm_add_ps(_mm_load_ps(emitter->velocityY + i), gravity), drag);
+        _mm_store_ps(emitter->velocityX + i, velocityX);
+        _mm_store_ps(emitter->velocityY + i, velocityY);
+        _mm_store_ps(emitter->x + i,
+                     _mm_add_ps(_mm_load_ps(emitter->x + i), _mm_mul_ps(velocityX, time)));
+        _mm_store_ps(emitter->y + i,
+                     _mm_add_ps(_mm_load_ps(emitter->y + i), _mm_mul_ps(velocityY, time)));
+    }
+    for (size_t j = 0; j < end; j += PCT_PARTICLE_LANES) {
+        _mm_store_ps(emitter->life + j, _mm_sub_ps(_mm_load_ps(emitter->life + j), time));
+    }
+#else
+    for (size_t j = 0; j < end; j++) {
+        emitter->life[j] -= deltaTimeS;
+    }
+#endif
+    for (; i < emitter->movingCount; i++) {
+        emitter->velocityX[i] *= damping;
+        emitter->velocityY[i] = (emitter->velocityY[i] + gravityStep) * damping;
+        emitter->x[i] += emitter->velocityX[i] * deltaTimeS;
+        emitter->y[i] += emitter->velocityY[i] * deltaTimeS;
+    }
+}
+
+/*
+ * Partial cells count as solid, which is close enough for effects. Reads the bitmap directly,
+ * this runs for every live particle each frame.
+ */
+static inline bool PCT_ParticleSolid(const PCT_OccupancyGrid *occupancy, const float x,
+                                     const float y) {
+    float cellX = (x - occupancy->origin.x) * occupancy->inverseCellSize;
+    float cellY = (y - occupancy->origin.y) * occupancy->inverseCellSize;
+    if (cellX < 0.0f || cellY < 0.0f || cellX >= (float)occupancy->width ||
+        cellY >= (float)occupancy->height) {
+        return false;
+    }
+    uint32_t column = (uint32_t)(int32_t)cellX;
+    const uint64_t *row =
+        occupancy->levels[0].rows + (uint32_t)(int32_t)cellY * occupancy->wordsPerRow;
+    return (row[column / 64] >> (column % 64)) & 1;
+}
+
+/*
+ * Steps particle back out of the cell it moved into along the axis that entered it and reflects
+ * that velocity component.
+ * Returns true when the particle landed too slowly to bounce and should rest.
+ */
+static bool PCT_CollideParticle(const PCT_OccupancyGrid *occupancy, PCT_ParticleEmitter *emitter,
+                                const size_t i, const float deltaTimeS) {
+    if (!PCT_ParticleSolid(occupancy, emitter->x[i], emitter->y[i])) {
+        return false;
+    }
+    float bounce = emitter->desc.bounce;
+    float previousX = emitter->x[i] - emitter->velocityX[i] * deltaTimeS;
+    float previousY = emitter->y[i] - emitter->velocityY[i] * deltaTimeS;
+    if (!PCT_ParticleSolid(occupancy, emitter->x[i], previousY)) {
+        emitter->y[i] = previousY;
+        if (emitter->velocityY[i] < 0.0f &&
+            -emitter->velocityY[i] * bounce < PCT_PARTICLE_REST_SPEED) {
+            return true;
+        }
+        emitter->velocityY[i] *= -bounce;
+        emitter->velocityX[i] *= PCT_PARTICLE_GROUND_FRICTION;
+    } else if (!PCT_ParticleSolid(occupancy, previousX, emitter->y[i])) {
+        emitter->x[i] = previousX;
+        emitter->velocityX[i] *= -bounce;
+    } else {
+        emitter->x[i] = previousX;
+        emitter->y[i] = previousY;
+        emitter->velocityX[i] *= -bounce;
+        emitter->velocityY[i] *= -bounce;
+    }
+    return false;
+}
+
+void PCT_UpdateParticles(PCT_ParticleSystem *system, const float deltaTimeS) {
+    assert(system != NULL);
+
+    for (size_t e = 0; e < system->emitterCount; e++) {
+        PCT_ParticleEmitter *emitter = system->emitters + e;
+        PCT_IntegrateParticles(emitter, deltaTimeS);
+        bool collide = emitter->desc.collide && system->occupancy != NULL;
+        // Moving particles come first and resting ones after them, a dead or resting particle
+        // is replaced by the last one of its range and the next range shifts down.
+        size_t i = 0;
+        while (i < emitter->movingCount) {
+            if (emitter->life[i] <= 0.0f) {
+                PCT_MoveParticle(emitter, i, --emitter->movingCount);
+                PCT_MoveParticle(emitter, emitter->movingCount, --emitter->count);
+            } else if (collide && PCT_CollideParticle(system->occupancy, emitter, i, deltaTimeS)) {
+                float x = emitter->x[i];
+                float y = emitter->y[i];
+                float life = emitter->life[i];
+                float inverseLifetime = emitter->inverseLifetime[i];
+                size_t last = --emitter->movingCount;
+                PCT_MoveParticle(emitter, i, last);
+                emitter->x[last] = x;
+                emitter->y[last] = y;
+                emitter->velocityX[last] = 0.0f;
+                emitter->velocityY[last] = 0.0f;
+                emitter->life[last] = life;
+                emitter->inverseLifetime[last] = inverseLifetime;
+            } else {
+                i++;
+            }
+        }
+        while (i < emitter->count) {
+            if (emitter->life[i] <= 0.0f) {
+                PCT_MoveParticle(emitter, i, --emitter->count);
+            } else {
+                i++;
+            }
+        }
+    }
+}
+
+size_t PCT_BuildParticleGeometry(PCT_ParticleSystem *system, const PCT_AaBb *view,
+                                 const float screenWidth, const float screenHeight) {
+    assert(system != NULL);
+    assert(view != NULL);
+
+    float scaleX = screenWidth / (view->x2 - view->x1);
+    float scaleY = screenHeight / (view->y2 - view->y1);
+    size_t quads = 0;
+    for (size_t e = 0; e < system->emitterCount; e++) {
+        const PCT_ParticleEmitter *emitter = system->emitters + e;
+        float half = emitter->desc.size * 0.5f;
+        float halfX = half * scaleX;
+        float halfY = half * scaleY;
+        SDL_FColor color = emitter->desc.color;
+        float alpha = color.a;
+        for (size_t i = 0; i < emitter->count; i++) {
+            float x = emitter->x[i];
+            float y = emitter->y[i];
+            if (x + half < view->x1 || x - half > view->x2 || y + half < view->y1 ||
+                y - half > view->y2) {
+                continue;
+            }
+            float screenX = (x - view->x1) * scaleX;
+            float screenY = (view->y2 - y) * scaleY;
+            float fade = emitter->life[i] * emitter->inverseLifetime[i];
+            color.a = alpha * SDL_clamp(fade, 0.0f, 1.0f);
+            SDL_Vertex *quad = system->vertices + quads * 4;
+            quad[0] = (SDL_Vertex){{screenX - halfX, screenY - halfY}, color, {0.0f, 0.0f}};
+            quad[1] = (SDL_Vertex){{screenX + halfX, screenY - halfY}, color, {0.0f, 0.0f}};
+            quad[2] = (SDL_Vertex){{screenX + halfX, screenY + halfY}, color, {0.0f, 0.0f}};
+            quad[3] = (SDL_Vertex){{screenX - halfX, screenY + halfY}, color, {0.0f, 0.0f}};
+            quads++;
+        }
+    }
+    system->quadCount = quads;
+    return quads;
+}
+
+void PCT_DrawParticles(PCT_ParticleSystem *system, SDL_Renderer *renderer, const PCT_AaBb *view,
+                       const float screenWidth, const float screenHeight) {
+    if (PCT_BuildParticleGeometry(system, view, screenWidth, screenHeight) == 0) {
+        return;
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderGeometry(renderer, NULL, system->vertices, (Sint32)(system->quadCount * 4),
+                       system->indices, (Sint32)(system->quadCount * 6));
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+}
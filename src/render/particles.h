@@ -0,0 +1,121 @@
+/**
+ * @file particles.h
+ * Cosmetic particles such as hit sparks, dust and debris. They live outside of PCT_SimState, are
+ * not replicated and are not rolled back.
+ */
+#if !defined(PCT_PARTICLES)
+#define PCT_PARTICLES
+
+#include "../game/game.h"
+#include "../structures/structures.h"
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(PCT_PARTICLES_NO_SIMD) &&                                                             \
+    (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define PCT_PARTICLES_SSE
+#endif
+
+// Particles are updated in groups of 4, pools are padded and aligned for whole groups.
+#define PCT_PARTICLE_LANES 4
+#define PCT_PARTICLE_ALIGNMENT 16
+
+/**
+ * @brief Look and behaviour shared by every particle of an emitter. Speed and lifetime are picked
+ * per particle between min and max, direction within spread radians around angle. Gravity scale
+ * multiplies PCT_GRAVITY, drag is the fraction of velocity lost per second.
+ */
+typedef struct {
+    size_t capacity;
+    float angle;
+    float spread;
+    float speedMin;
+    float speedMax;
+    float lifetimeMin;
+    float lifetimeMax;
+    float gravityScale;
+    float drag;
+    float size;
+    SDL_FColor color;
+    bool collide;
+    float bounce;
+} PCT_ParticleEmitterDesc;
+
+/**
+ * @brief Fixed size pool of particles stored as parallel arrays. Dead particles are replaced by
+ * the last live one, so live particles are always the first count entries. The first movingCount
+ * of them move, the rest came to rest on the map and are no longer integrated.
+ */
+typedef struct {
+    PCT_ParticleEmitterDesc desc;
+    float *x;
+    float *y;
+    float *velocityX;
+    float *velocityY;
+    float *life;
+    float *inverseLifetime;
+    size_t count;
+    size_t movingCount;
+    void *storage;
+} PCT_ParticleEmitter;
+
+/**
+ * @brief Emitters drawn together with a single geometry call. Collision uses occupancy when set,
+ * cells touched by any map rect stop particles.
+ */
+typedef struct {
+    PCT_ParticleEmitter *emitters;
+    size_t emitterCount;
+    size_t emitterCapacity;
+    const PCT_OccupancyGrid *occupancy;
+    uint64_t rngState;
+    SDL_Vertex *vertices;
+    Sint32 *indices;
+    size_t quadCount;
+    size_t quadCapacity;
+} PCT_ParticleSystem;
+
+/**
+ * @brief Creates system without emitters. User should call PCT_DestroyParticleSystem to free it.
+ * @param occupancy grid of the map particles collide with, may be NULL
+ */
+PCT_ParticleSystem *PCT_CreateParticleSystem(const PCT_OccupancyGrid *occupancy, uint64_t seed);
+void PCT_DestroyParticleSystem(PCT_ParticleSystem *system);
+
+/**
+ * @brief Adds emitter with its pool allocated up front, nothing is allocated while emitting.
+ * @return emitter index
+ */
+size_t PCT_AddParticleEmitter(PCT_ParticleSystem *system, const PCT_ParticleEmitterDesc *desc);
+
+/**
+ * @brief Spawns count particles at origin. Particles that do not fit in the pool are dropped.
+ * @param direction -1 or 1 mirrors the emitter angle horizontally
+ * @return number of particles spawned
+ */
+size_t PCT_EmitParticles(PCT_ParticleSystem *system, size_t emitter, const PCT_Point *origin,
+                         float direction, size_t count);
+
+/**
+ * @brief Integrates gravity, drag and velocity of all particles, then removes dead ones and
+ * bounces colliding ones off the occupancy grid.
+ */
+void PCT_UpdateParticles(PCT_ParticleSystem *system, float deltaTimeS);
+
+/**
+ * @brief Writes quads of particles inside view, which is mapped to a screen of given size with
+ * y pointing down. Used by PCT_DrawParticles.
+ * @return number of quads written
+ */
+size_t PCT_BuildParticleGeometry(PCT_ParticleSystem *system, const PCT_AaBb *view,
+                                 float screenWidth, float screenHeight);
+
+/**
+ * @brief Draws all particles inside view as untextured quads fading out with their life.
+ */
+void PCT_DrawParticles(PCT_ParticleSystem *system, SDL_Renderer *renderer, const PCT_AaBb *view,
+                       float screenWidth, float screenHeight);
+
+#endif // PCT_PARTICLES
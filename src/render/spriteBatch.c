@@ -0,0 +1,118 @@
+#include "spriteBatch.h"
+#include "../misc/errors.h"
+#include <SDL3/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void PCT_SpriteBatchReserve(PCT_SpriteBatch *batch, const size_t capacity) {
+    if (capacity <= batch->capacity) {
+        return;
+    }
+    SDL_FRect *sources = realloc(batch->sources, sizeof(SDL_FRect) * capacity);
+    batch->sources = sources != NULL ? sources : batch->sources;
+    SDL_FRect *destinations = realloc(batch->destinations, sizeof(SDL_FRect) * capacity);
+    batch->destinations = destinations != NULL ? destinations : batch->destinations;
+    bool *flipped = realloc(batch->flipped, sizeof(bool) * capacity);
+    batch->flipped = flipped != NULL ? flipped : batch->flipped;
+    SDL_Vertex *vertices = realloc(batch->vertices, sizeof(SDL_Vertex) * 4 * capacity);
+    batch->vertices = vertices != NULL ? vertices : batch->vertices;
+    Sint32 *indices = realloc(batch->indices, sizeof(Sint32) * 6 * capacity);
+    batch->indices = indices != NULL ? indices : batch->indices;
+    if (sources == NULL || destinations == NULL || flipped == NULL || vertices == NULL ||
+        indices == NULL) {
+        printf("Failed to grow sprite batch.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    // Quad topology never changes, so indices are only written for the new sprites.
+    for (size_t i = batch->capacity; i < capacity; i++) {
+        Sint32 first = (Sint32)(i * 4);
+        Sint32 *quad = batch->indices + i * 6;
+        quad[0] = first;
+        quad[1] = first + 1;
+        quad[2] = first + 2;
+        quad[3] = first + 2;
+        quad[4] = first + 3;
+        quad[5] = first;
+    }
+    batch->capacity = capacity;
+}
+
+PCT_SpriteBatch *PCT_CreateSpriteBatch(const size_t capacity) {
+    PCT_SpriteBatch *batch = calloc(1, sizeof(PCT_SpriteBatch));
+    if (batch == NULL) {
+        printf("Failed to allocate sprite batch.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    PCT_SpriteBatchReserve(batch, capacity > 0 ? capacity : 1);
+    return batch;
+}
+
+void PCT_DestroySpriteBatch(PCT_SpriteBatch *batch) {
+    if (batch == NULL) {
+        return;
+    }
+    free(batch->sources);
+    free(batch->destinations);
+    free(batch->flipped);
+    free(batch->vertices);
+    free(batch->indices);
+    free(batch);
+}
+
+void PCT_SpriteBatchClear(PCT_SpriteBatch *batch) {
+    batch->count = 0;
+}
+
+size_t PCT_SpriteBatchAppend(PCT_SpriteBatch *batch, const size_t count) {
+    assert(batch != NULL);
+
+    size_t first = batch->count;
+    if (first + count > batch->capacity) {
+        size_t capacity = batch->capacity * 2;
+        while (capacity < first + count) {
+            capacity *= 2;
+        }
+        PCT_SpriteBatchReserve(batch, capacity);
+    }
+    batch->count += count;
+    return first;
+}
+
+void PCT_DrawSpriteBatch(PCT_SpriteBatch *batch, SDL_Renderer *renderer, SDL_Texture *texture) {
+    assert(batch != NULL);
+
+    Sint32 textureWidth = 0, textureHeight = 0;
+    if (batch->count == 0 ||
+        SDL_QueryTexture(texture, NULL, NULL, &textureWidth, &textureHeight) != 0 ||
+        textureWidth == 0 || textureHeight == 0) {
+        return;
+    }
+    float scaleU = 1.0f / (float)textureWidth;
+    float scaleV = 1.0f / (float)textureHeight;
+    const SDL_FColor white = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (size_t i = 0; i < batch->count; i++) {
+        const SDL_FRect *source = batch->sources + i;
+        const SDL_FRect *destination = batch->destinations + i;
+        // Clamped so sources outside a smaller stand-in texture, like a loading placeholder,
+        // still sample inside it.
+        float u1 = SDL_clamp(source->x * scaleU, 0.0f, 1.0f);
+        float u2 = SDL_clamp((source->x + source->w) * scaleU, 0.0f, 1.0f);
+        float v1 = SDL_clamp(source->y * scaleV, 0.0f, 1.0f);
+        float v2 = SDL_clamp((source->y + source->h) * scaleV, 0.0f, 1.0f);
+        if (batch->flipped[i]) {
+            float swap = u1;
+            u1 = u2;
+            u2 = swap;
+        }
+        float x2 = destination->x + destination->w;
+        float y2 = destination->y + destination->h;
+        SDL_Vertex *quad = batch->vertices + i * 4;
+        quad[0] = (SDL_Vertex){{destination->x, destination->y}, white, {u1, v1}};
+        quad[1] = (SDL_Vertex){{x2, destination->y}, white, {u2, v1}};
+        quad[2] = (SDL_Vertex){{x2, y2}, white, {u2, v2}};
+        quad[3] = (SDL_Vertex){{destination->x, y2}, white, {u1, v2}};
+    }
+    SDL_RenderGeometry(renderer, texture, batch->vertices, (Sint32)(batch->count * 4),
+                       batch->indices, (Sint32)(batch->count * 6));
+}
@@ -0,0 +1,46 @@
+/**
+ * @file spriteBatch.h
+ * Sprites sharing one texture, drawn with a single geometry call.
+ */
+#if !defined(PCT_SPRITE_BATCH)
+#define PCT_SPRITE_BATCH
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Sprite attributes stored as parallel arrays so producers such as PCT_AdvanceAnimators
+ * can write a whole range of sources at once.
+ */
+typedef struct {
+    SDL_FRect *sources;
+    SDL_FRect *destinations;
+    bool *flipped;
+    SDL_Vertex *vertices;
+    Sint32 *indices;
+    size_t count;
+    size_t capacity;
+} PCT_SpriteBatch;
+
+/**
+ * @brief Creates empty batch. User should call PCT_DestroySpriteBatch to free it.
+ */
+PCT_SpriteBatch *PCT_CreateSpriteBatch(size_t capacity);
+void PCT_DestroySpriteBatch(PCT_SpriteBatch *batch);
+void PCT_SpriteBatchClear(PCT_SpriteBatch *batch);
+
+/**
+ * @brief Appends count sprites, growing the batch when needed. Their attributes are left for the
+ * caller to fill.
+ * @return index of the first appended sprite
+ */
+size_t PCT_SpriteBatchAppend(PCT_SpriteBatch *batch, size_t count);
+
+/**
+ * @brief Draws all sprites with texture, flipped sprites are mirrored horizontally.
+ */
+void PCT_DrawSpriteBatch(PCT_SpriteBatch *batch, SDL_Renderer *renderer, SDL_Texture *texture);
+
+#endif // PCT_SPRITE_BATCH
@@ -0,0 +1,441 @@
+#include "../game/game.h"
+#include "../misc/errors.h"
+#include "structures.h"
+#include <assert.h>
+#include <cglm/cglm.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PCT_COMPACT_LEAF_RECORDS 4
+
+typedef struct {
+    PCT_AaBb box;
+    uint32_t index;
+} PCT_SortedBox;
+
+typedef struct {
+    PCT_CompactKdTree *tree;
+    const PCT_SortedBox *sorted;
+    size_t sortedCount;
+    uint32_t *remap;
+    size_t nodeCount;
+    size_t entryCount;
+} PCT_CompactBuilder;
+
+typedef struct {
+    uint32_t node;
+    float timeMin;
+    float timeMax;
+} PCT_CompactRayStackEntry;
+
+/**
+ * @brief Frame of a leaf and the scale mapping it onto [0, levels]. Build and queries derive it
+ * the same way from the stored corners, which keeps their rounding consistent.
+ */
+typedef struct {
+    PCT_AaBb box;
+    float scaleX;
+    float scaleY;
+    float levels;
+} PCT_LeafFrame;
+
+static inline PCT_LeafFrame PCT_GetLeafFrame(const PCT_CompactKdTree *tree, const uint32_t node) {
+    const PCT_CompactKdNode *min = tree->nodes + node + 2;
+    const PCT_CompactKdNode *max = tree->nodes + node + 3;
+    PCT_LeafFrame frame = {
+        .box = {min->corner.x, min->corner.y, max->corner.x, max->corner.y},
+        .levels = (float)((1u << tree->quantizationBits) - 1)};
+    float width = frame.box.x2 - frame.box.x1;
+    float height = frame.box.y2 - frame.box.y1;
+    frame.scaleX = width > 0.0f ? frame.levels / width : 0.0f;
+    frame.scaleY = height > 0.0f ? frame.levels / height : 0.0f;
+    return frame;
+}
+
+// Both round outward and are monotonic, so x <= y still holds for the quantized values and the
+// integer overlap test never rejects a box the float test would accept.
+static inline uint32_t PCT_QuantizeDown(const float value, const float origin, const float scale,
+                                        const float levels) {
+    return (uint32_t)glm_clamp(floorf((value - origin) * scale), 0.0f, levels);
+}
+
+static inline uint32_t PCT_QuantizeUp(const float value, const float origin, const float scale,
+                                      const float levels) {
+    return (uint32_t)glm_clamp(ceilf((value - origin) * scale), 0.0f, levels);
+}
+
+static inline void PCT_LoadQuantized(const PCT_CompactKdTree *tree, const size_t entry,
+                                     uint32_t quantized[4]) {
+    if (tree->quantizationBits == 8) {
+        const uint8_t *values = tree->quantized + entry * 4;
+        for (size_t i = 0; i < 4; i++) {
+            quantized[i] = values[i];
+        }
+    } else {
+        const uint16_t *values = (const uint16_t *)tree->quantized + entry * 4;
+        for (size_t i = 0; i < 4; i++) {
+            quantized[i] = values[i];
+        }
+    }
+}
+
+static inline const PCT_AaBb *PCT_CompactEntryBox(const PCT_CompactKdTree *tree,
+                                                   const uint32_t node, const size_t entry) {
+    size_t boxFirst = tree->nodes[node + 1].leaf.first;
+    size_t homeCount = tree->nodes[node + 1].leaf.info;
+    size_t offset = entry - tree->nodes[node].leaf.first;
+    if (offset < homeCount) {
+        return tree->boxes + boxFirst + offset;
+    }
+    return tree->boxes + tree->boxIndices[entry - boxFirst - homeCount];
+}
+
+static int32_t PCT_CompareSortedBoxes(const void *first, const void *second) {
+    const PCT_AaBb *a = &((const PCT_SortedBox *)first)->box;
+    const PCT_AaBb *b = &((const PCT_SortedBox *)second)->box;
+    const float left[4] = {a->x1, a->y1, a->x2, a->y2};
+    const float right[4] = {b->x1, b->y1, b->x2, b->y2};
+    for (size_t i = 0; i < 4; i++) {
+        if (left[i] != right[i]) {
+            return left[i] < right[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static void PCT_CountCompactRecords(const PCT_KdTree *node, size_t *nodeCount,
+                                    size_t *entryCount) {
+    if (node == NULL || node->axis == PCT_KDTREE_AXIS_NONE) {
+        *nodeCount += PCT_COMPACT_LEAF_RECORDS;
+        *entryCount += node != NULL ? node->data.leaf.elementCount : 0;
+        return;
+    }
+    (*nodeCount)++;
+    PCT_CountCompactRecords(node->data.node.nodes[0], nodeCount, entryCount);
+    PCT_CountCompactRecords(node->data.node.nodes[1], nodeCount, entryCount);
+}
+
+static uint32_t *PCT_CompactBoxSlot(PCT_CompactBuilder *builder, const PCT_AaBb *box) {
+    PCT_SortedBox key = {.box = *box};
+    const PCT_SortedBox *found = bsearch(&key, builder->sorted, builder->sortedCount,
+                                         sizeof(PCT_SortedBox), PCT_CompareSortedBoxes);
+    assert(found != NULL);
+    return builder->remap + found->index;
+}
+
+static void PCT_WriteCompactEntry(PCT_CompactKdTree *tree, const size_t entry,
+                                  const PCT_LeafFrame *frame, const PCT_AaBb *box) {
+    uint32_t quantized[4] = {
+        PCT_QuantizeDown(box->x1, frame->box.x1, frame->scaleX, frame->levels),
+        PCT_QuantizeDown(box->y1, frame->box.y1, frame->scaleY, frame->levels),
+        PCT_QuantizeUp(box->x2, frame->box.x1, frame->scaleX, frame->levels),
+        PCT_QuantizeUp(box->y2, frame->box.y1, frame->scaleY, frame->levels)};
+    for (size_t i = 0; i < 4; i++) {
+        if (tree->quantizationBits == 8) {
+            tree->quantized[entry * 4 + i] = (uint8_t)quantized[i];
+        } else {
+            ((uint16_t *)tree->quantized)[entry * 4 + i] = (uint16_t)quantized[i];
+        }
+    }
+}
+
+static void PCT_FlattenKdTree(PCT_CompactBuilder *builder, const PCT_KdTree *node,
+                              const PCT_AaBb region) {
+    PCT_CompactKdTree *tree = builder->tree;
+    uint32_t index = (uint32_t)builder->nodeCount;
+    if (node != NULL && node->axis != PCT_KDTREE_AXIS_NONE) {
+        builder->nodeCount++;
+        tree->nodes[index].split.boundary = node->data.node.boundary;
+        PCT_AaBb left = region;
+        PCT_AaBb right = region;
+        if (node->axis == PCT_KDTREE_AXIS_X) {
+            left.x2 = fminf(left.x2, node->data.node.boundary);
+            right.x1 = fmaxf(right.x1, node->data.node.boundary);
+        } else {
+            left.y2 = fminf(left.y2, node->data.node.boundary);
+            right.y1 = fmaxf(right.y1, node->data.node.boundary);
+        }
+        PCT_FlattenKdTree(builder, node->data.node.nodes[0], left);
+        tree->nodes[index].split.info =
+            ((uint32_t)node->axis << PCT_COMPACT_KDTREE_AXIS_SHIFT) | (uint32_t)builder->nodeCount;
+        PCT_FlattenKdTree(builder, node->data.node.nodes[1], right);
+        return;
+    }
+
+    size_t count = node != NULL ? node->data.leaf.elementCount : 0;
+    builder->nodeCount += PCT_COMPACT_LEAF_RECORDS;
+    // Entries are clipped to the leaf region, a part outside it is found through its own leaf.
+    PCT_AaBb bounds = node != NULL ? node->bounds : region;
+    float x1 = fmaxf(bounds.x1, region.x1);
+    float y1 = fmaxf(bounds.y1, region.y1);
+    tree->nodes[index + 2].corner.x = x1;
+    tree->nodes[index + 2].corner.y = y1;
+    tree->nodes[index + 3].corner.x = fmaxf(fminf(bounds.x2, region.x2), x1);
+    tree->nodes[index + 3].corner.y = fmaxf(fminf(bounds.y2, region.y2), y1);
+    PCT_LeafFrame frame = PCT_GetLeafFrame(tree, index);
+
+    // Boxes seen first in this leaf are stored next to each other in leaf order and need no
+    // index, only entries of boxes stored by an earlier leaf keep one.
+    size_t first = builder->entryCount;
+    uint32_t boxFirst = (uint32_t)tree->boxCount;
+    for (size_t i = 0; i < count; i++) {
+        const PCT_AaBb *box = node->data.leaf.bucket + i;
+        uint32_t *slot = PCT_CompactBoxSlot(builder, box);
+        if (*slot == UINT32_MAX) {
+            *slot = (uint32_t)tree->boxCount++;
+            tree->boxes[*slot] = *box;
+            PCT_WriteCompactEntry(tree, builder->entryCount++, &frame, box);
+        }
+    }
+    uint32_t homeCount = (uint32_t)tree->boxCount - boxFirst;
+    for (size_t i = 0; i < count; i++) {
+        const PCT_AaBb *box = node->data.leaf.bucket + i;
+        uint32_t *slot = PCT_CompactBoxSlot(builder, box);
+        // Identical rects resolve to one slot, a copy already stored by this leaf is dropped.
+        if (*slot < boxFirst) {
+            tree->boxIndices[builder->entryCount - tree->boxCount] = *slot;
+            PCT_WriteCompactEntry(tree, builder->entryCount++, &frame, box);
+        }
+    }
+    tree->nodes[index].leaf.first = (uint32_t)first;
+    tree->nodes[index].leaf.info =
+        ((uint32_t)PCT_KDTREE_AXIS_NONE << PCT_COMPACT_KDTREE_AXIS_SHIFT) |
+        (uint32_t)(builder->entryCount - first);
+    tree->nodes[index + 1].leaf.first = boxFirst;
+    tree->nodes[index + 1].leaf.info = homeCount;
+}
+
+PCT_CompactKdTree *PCT_BuildCompactKdTree(const PCT_AaBb *boxes, const size_t boxesCount,
+                                          const PCT_KdTreeBuildParams *params,
+                                          const uint8_t quantizationBits) {
+    assert(boxes != NULL);
+    assert(boxesCount > 0);
+    assert(quantizationBits == 8 || quantizationBits == 16);
+
+    PCT_AaBb *treeBoxes = malloc(sizeof(PCT_AaBb) * boxesCount);
+    PCT_SortedBox *sorted = malloc(sizeof(PCT_SortedBox) * boxesCount);
+    uint32_t *remap = malloc(sizeof(uint32_t) * boxesCount);
+    PCT_CompactKdTree *tree = calloc(1, sizeof(PCT_CompactKdTree));
+    if (treeBoxes == NULL || sorted == NULL || remap == NULL || tree == NULL) {
+        printf("Failed to allocate compact kdTree.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    memcpy(treeBoxes, boxes, sizeof(PCT_AaBb) * boxesCount);
+    PCT_KdTree *source = PCT_BuildKdTreeWithParams(treeBoxes, boxesCount, params);
+    for (size_t i = 0; i < boxesCount; i++) {
+        sorted[i] = (PCT_SortedBox){boxes[i], (uint32_t)i};
+        remap[i] = UINT32_MAX;
+    }
+    qsort(sorted, boxesCount, sizeof(PCT_SortedBox), PCT_CompareSortedBoxes);
+
+    size_t nodeCount = 0, entryCount = 0;
+    PCT_CountCompactRecords(source, &nodeCount, &entryCount);
+    size_t entrySize = quantizationBits / 8 * 4;
+    tree->quantizationBits = quantizationBits;
+    tree->nodes = malloc(sizeof(PCT_CompactKdNode) * nodeCount);
+    tree->quantized = malloc(entrySize * (entryCount > 0 ? entryCount : 1));
+    tree->boxIndices = malloc(sizeof(uint32_t) * (entryCount > 0 ? entryCount : 1));
+    tree->boxes = malloc(sizeof(PCT_AaBb) * boxesCount);
+    if (tree->nodes == NULL || tree->quantized == NULL || tree->boxIndices == NULL ||
+        tree->boxes == NULL) {
+        printf("Failed to allocate compact kdTree.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+
+    PCT_CompactBuilder builder = {.tree = tree,
+                                  .sorted = sorted,
+                                  .sortedCount = boxesCount,
+                                  .remap = remap};
+    PCT_FlattenKdTree(&builder, source, source->bounds);
+    assert(builder.nodeCount == nodeCount);
+    assert(builder.entryCount <= entryCount);
+    tree->nodeCount = nodeCount;
+    tree->entryCount = builder.entryCount;
+    size_t indexCount = tree->entryCount - tree->boxCount;
+    uint32_t *boxIndices = realloc(tree->boxIndices, sizeof(uint32_t) * (indexCount + 1));
+    tree->boxIndices = boxIndices != NULL ? boxIndices : tree->boxIndices;
+    tree->memoryBytes = sizeof(PCT_CompactKdTree) + sizeof(PCT_CompactKdNode) * nodeCount +
+                        entrySize * tree->entryCount + sizeof(uint32_t) * indexCount +
+                        sizeof(PCT_AaBb) * tree->boxCount;
+
+    PCT_DestroyKdTree(source);
+    free(remap);
+    free(sorted);
+    return tree;
+}
+
+void PCT_DestroyCompactKdTree(PCT_CompactKdTree *tree) {
+    if (tree == NULL) {
+        return;
+    }
+    free(tree->nodes);
+    free(tree->quantized);
+    free(tree->boxIndices);
+    free(tree->boxes);
+    free(tree);
+}
+
+size_t PCT_CompactKdTreeRangeQuery(const PCT_CompactKdTree *tree, const PCT_AaBb *range,
+                                   const PCT_AaBb **boxes, const size_t capacity) {
+    assert(tree != NULL);
+    assert(range != NULL);
+    assert(boxes != NULL || capacity == 0);
+
+    uint32_t stack[PCT_KDTREE_MAX_DEPTH];
+    size_t stackSize = 0;
+    size_t found = 0;
+    uint32_t node = 0;
+    for (;;) {
+        const PCT_CompactKdNode *record = tree->nodes + node;
+        uint32_t axis = record->split.info >> PCT_COMPACT_KDTREE_AXIS_SHIFT;
+        uint32_t value = record->split.info & PCT_COMPACT_KDTREE_VALUE_MASK;
+        if (axis == PCT_KDTREE_AXIS_NONE) {
+            if (value > 0) {
+                PCT_LeafFrame frame = PCT_GetLeafFrame(tree, node);
+                uint32_t x1 = PCT_QuantizeDown(range->x1, frame.box.x1, frame.scaleX, frame.levels);
+                uint32_t y1 = PCT_QuantizeDown(range->y1, frame.box.y1, frame.scaleY, frame.levels);
+                uint32_t x2 = PCT_QuantizeUp(range->x2, frame.box.x1, frame.scaleX, frame.levels);
+                uint32_t y2 = PCT_QuantizeUp(range->y2, frame.box.y1, frame.scaleY, frame.levels);
+                for (size_t entry = record->leaf.first; entry < record->leaf.first + value;
+                     entry++) {
+                    uint32_t quantized[4];
+                    PCT_LoadQuantized(tree, entry, quantized);
+                    if (quantized[0] > x2 || quantized[2] < x1 || quantized[1] > y2 ||
+                        quantized[3] < y1) {
+                        continue;
+                    }
+                    const PCT_AaBb *box = PCT_CompactEntryBox(tree, node, entry);
+                    if (PCT_AaBbCollisionTest(range, box, NULL)) {
+                        if (found < capacity) {
+                            boxes[found] = box;
+                        }
+                        found++;
+                    }
+                }
+            }
+            if (stackSize == 0) {
+                break;
+            }
+            node = stack[--stackSize];
+            continue;
+        }
+
+        float min = axis == PCT_KDTREE_AXIS_X ? range->x1 : range->y1;
+        float max = axis == PCT_KDTREE_AXIS_X ? range->x2 : range->y2;
+        bool left = min < record->split.boundary;
+        bool right = max > record->split.boundary;
+        if (left && right) {
+            assert(stackSize < PCT_KDTREE_MAX_DEPTH);
+            stack[stackSize++] = value;
+            node++;
+        } else if (left || right) {
+            node = left ? node + 1 : value;
+        } else if (stackSize > 0) {
+            node = stack[--stackSize];
+        } else {
+            break;
+        }
+    }
+    return found;
+}
+
+bool PCT_CompactKdTreeRaycast(const PCT_CompactKdTree *tree, const PCT_Point *origin,
+                              const PCT_Vector *direction, const float maxTime, PCT_RayHit *hit) {
+    assert(tree != NULL);
+    assert(origin != NULL);
+    assert(direction != NULL);
+
+    PCT_CompactRayStackEntry stack[PCT_KDTREE_MAX_DEPTH];
+    size_t stackSize = 0;
+    PCT_CompactRayStackEntry current = {.node = 0, .timeMin = 0.0f, .timeMax = maxTime};
+    PCT_RayHit best = {.box = NULL, .time = maxTime};
+    bool visiting = true;
+
+    while (visiting) {
+        const PCT_CompactKdNode *record = tree->nodes + current.node;
+        uint32_t axis = record->split.info >> PCT_COMPACT_KDTREE_AXIS_SHIFT;
+        uint32_t value = record->split.info & PCT_COMPACT_KDTREE_VALUE_MASK;
+        if (axis == PCT_KDTREE_AXIS_NONE) {
+            // Entries are tested against the bounds of what is left of the ray, both quantized
+            // and widened by a step against rounding, which rejects most of them cheaply.
+            PCT_LeafFrame frame = PCT_GetLeafFrame(tree, current.node);
+            float endX = origin->x + direction->x * best.time;
+            float endY = origin->y + direction->y * best.time;
+            uint32_t x1 = PCT_QuantizeDown(fminf(origin->x, endX), frame.box.x1, frame.scaleX,
+                                           frame.levels);
+            uint32_t y1 = PCT_QuantizeDown(fminf(origin->y, endY), frame.box.y1, frame.scaleY,
+                                           frame.levels);
+            uint32_t x2 = PCT_QuantizeUp(fmaxf(origin->x, endX), frame.box.x1, frame.scaleX,
+                                         frame.levels);
+            uint32_t y2 = PCT_QuantizeUp(fmaxf(origin->y, endY), frame.box.y1, frame.scaleY,
+                                         frame.levels);
+            x1 = x1 > 0 ? x1 - 1 : 0;
+            y1 = y1 > 0 ? y1 - 1 : 0;
+            x2++;
+            y2++;
+            for (size_t entry = record->leaf.first; entry < record->leaf.first + value; entry++) {
+                uint32_t quantized[4];
+                PCT_LoadQuantized(tree, entry, quantized);
+                if (quantized[0] > x2 || quantized[2] < x1 || quantized[1] > y2 ||
+                    quantized[3] < y1) {
+                    continue;
+                }
+                float time;
+                vec2 normal;
+                const PCT_AaBb *box = PCT_CompactEntryBox(tree, current.node, entry);
+                if (PCT_RayBoxTest(origin, direction, box, best.time, &time, normal) &&
+                    (best.box == NULL || time < best.time)) {
+                    best.box = box;
+                    best.time = time;
+                    best.normal[0] = normal[0];
+                    best.normal[1] = normal[1];
+                }
+            }
+            // Same pruning as PCT_KdTreeRaycast, straddling boxes are stored on both sides.
+            visiting = false;
+        } else {
+            float boundary = record->split.boundary;
+            float start = axis == PCT_KDTREE_AXIS_X ? origin->x : origin->y;
+            float delta = axis == PCT_KDTREE_AXIS_X ? direction->x : direction->y;
+            bool nearIsLeft = start < boundary || (start == boundary && delta > 0.0f);
+            uint32_t near = nearIsLeft ? current.node + 1 : value;
+            uint32_t far = nearIsLeft ? value : current.node + 1;
+            float timeSplit = delta != 0.0f ? (boundary - start) / delta : INFINITY;
+
+            if (delta == 0.0f && start == boundary) {
+                assert(stackSize < PCT_KDTREE_MAX_DEPTH);
+                stack[stackSize++] =
+                    (PCT_CompactRayStackEntry){far, current.timeMin, current.timeMax};
+                current.node = near;
+            } else if (timeSplit > current.timeMax || timeSplit < 0.0f) {
+                current.node = near;
+            } else if (timeSplit < current.timeMin) {
+                current.node = far;
+            } else {
+                assert(stackSize < PCT_KDTREE_MAX_DEPTH);
+                stack[stackSize++] = (PCT_CompactRayStackEntry){far, timeSplit, current.timeMax};
+                current.node = near;
+                current.timeMax = timeSplit;
+            }
+        }
+
+        while (!visiting && stackSize > 0) {
+            current = stack[--stackSize];
+            visiting = best.box == NULL || current.timeMin < best.time;
+        }
+    }
+
+    if (hit != NULL) {
+        *hit = best;
+    }
+    return best.box != NULL;
+}
+
+bool PCT_CompactKdTreeSegmentCast(const PCT_CompactKdTree *tree, const PCT_Point *from,
+                                  const PCT_Point *to, PCT_RayHit *hit) {
+    PCT_Vector direction = {.x = to->x - from->x, .y = to->y - from->y};
+    return PCT_CompactKdTreeRaycast(tree, from, &direction, 1.0f, hit);
+}
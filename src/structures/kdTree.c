@@ -3,6 +3,7 @@
 #include "structures.h"
 #include <assert.h>
 #include <cglm/cglm.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -39,24 +40,8 @@ static int32_t PCT_CompareFloats(const void *l, const void *r) {
     return (a > b) - (a < b);
 }
 
-#ifndef PCT_KDTREE_LEAF_SIZE
-#define PCT_KDTREE_LEAF_SIZE 128
-#endif
-
-PCT_KdTree *PCT_BuildKdTree(PCT_AaBb *boxes, const size_t boxesCount) {
-    assert(boxes != NULL);
-    assert(boxesCount > 0);
-
-    if (boxesCount < PCT_KDTREE_LEAF_SIZE) {
-        PCT_KdTree *leaf = malloc(sizeof(PCT_KdTree));
-        leaf->axis = PCT_KDTREE_AXIS_NONE;
-        leaf->data.leaf.bucket = malloc(sizeof(PCT_AaBb) * boxesCount);
-        memcpy(leaf->data.leaf.bucket, boxes, sizeof(PCT_AaBb) * boxesCount);
-        leaf->data.leaf.elementCount = boxesCount;
-        free(boxes);
-        return leaf;
-    }
-
+static void PCT_ChooseMedianSplit(const PCT_AaBb *boxes, const size_t boxesCount, uint8_t *axis,
+                                  float *boundary) {
     float *centerXs = malloc(sizeof(float) * boxesCount);
     float *centerYs = malloc(sizeof(float) * boxesCount);
     for (size_t i = 0; i < boxesCount; i++) {
@@ -66,24 +51,164 @@ PCT_KdTree *PCT_BuildKdTree(PCT_AaBb *boxes, const size_t boxesCount) {
     float varianceX = PCT_variance(centerXs, boxesCount);
     float varianceY = PCT_variance(centerYs, boxesCount);
 
-    uint8_t axis;
     float *centers;
     if (varianceX > varianceY) {
-        axis = PCT_KDTREE_AXIS_X;
+        *axis = PCT_KDTREE_AXIS_X;
         centers = centerXs;
     } else {
-        axis = PCT_KDTREE_AXIS_Y;
+        *axis = PCT_KDTREE_AXIS_Y;
         centers = centerYs;
     }
     qsort(centers, boxesCount, sizeof(float), PCT_CompareFloats);
-    float median = PCT_median(centers, boxesCount);
+    *boundary = PCT_median(centers, boxesCount);
     free(centerXs);
     free(centerYs);
+}
+
+static inline void PCT_BoxExtent(const PCT_AaBb *box, const uint8_t axis, float *start,
+                                 float *end) {
+    switch (axis) {
+    case PCT_KDTREE_AXIS_X:
+        *start = box->x1;
+        *end = box->x2;
+        break;
+    case PCT_KDTREE_AXIS_Y:
+        *start = box->y1;
+        *end = box->y2;
+        break;
+    default:
+        printf("Failed while building kdTree.\n");
+        exit(PCT_EXIT_CODE_INVALID_OPERATION);
+        break;
+    }
+}
+
+/*
+ * Binned surface area heuristic, in 2D the surface area of a cell is its perimeter. Boxes crossing
+ * a plane are counted on both sides since they are duplicated into both children.
+ * Returns false when no plane is cheaper than keeping the node as a leaf.
+ */
+static bool PCT_ChooseSahSplit(const PCT_AaBb *boxes, const size_t boxesCount,
+                               const PCT_AaBb bounds, const PCT_KdTreeBuildParams *params,
+                               uint8_t *axis, float *boundary) {
+    float width = bounds.x2 - bounds.x1;
+    float height = bounds.y2 - bounds.y1;
+    float perimeter = width + height;
+    if (perimeter <= 0.0f) {
+        return false;
+    }
+
+    size_t binCount = params->binCount < 2 ? 2 : params->binCount;
+    binCount = binCount > PCT_KDTREE_SAH_MAX_BINS ? PCT_KDTREE_SAH_MAX_BINS : binCount;
+    size_t starts[PCT_KDTREE_SAH_MAX_BINS];
+    size_t ends[PCT_KDTREE_SAH_MAX_BINS];
+    float bestCost = params->intersectionCost * (float)boxesCount;
+    bool found = false;
+
+    for (uint8_t candidateAxis = PCT_KDTREE_AXIS_X; candidateAxis <= PCT_KDTREE_AXIS_Y;
+         candidateAxis++) {
+        float min = candidateAxis == PCT_KDTREE_AXIS_X ? bounds.x1 : bounds.y1;
+        float extent = candidateAxis == PCT_KDTREE_AXIS_X ? width : height;
+        float otherExtent = candidateAxis == PCT_KDTREE_AXIS_X ? height : width;
+        if (extent <= 0.0f) {
+            continue;
+        }
+        float binWidth = extent / (float)binCount;
+        memset(starts, 0, sizeof(size_t) * binCount);
+        memset(ends, 0, sizeof(size_t) * binCount);
+        for (size_t i = 0; i < boxesCount; i++) {
+            float start, end;
+            PCT_BoxExtent(boxes + i, candidateAxis, &start, &end);
+            // start bin j means edge j <= start < edge j+1, end bin j means edge j < end <= edge j+1
+            size_t startBin = (size_t)glm_clamp(floorf((start - min) / binWidth), 0.0f,
+                                                (float)(binCount - 1));
+            size_t endBin = (size_t)glm_clamp(ceilf((end - min) / binWidth) - 1.0f, 0.0f,
+                                              (float)(binCount - 1));
+            starts[startBin]++;
+            ends[endBin]++;
+        }
+
+        size_t leftCount = starts[0];
+        size_t rightCount = boxesCount - ends[0];
+        for (size_t plane = 1; plane < binCount; plane++) {
+            float leftExtent = binWidth * (float)plane;
+            float cost = params->traversalCost +
+                         params->intersectionCost *
+                             (((leftExtent + otherExtent) * (float)leftCount +
+                               (extent - leftExtent + otherExtent) * (float)rightCount) /
+                              perimeter);
+            if (cost < bestCost && leftCount < boxesCount && rightCount < boxesCount) {
+                bestCost = cost;
+                *axis = candidateAxis;
+                *boundary = min + leftExtent;
+                found = true;
+            }
+            leftCount += starts[plane];
+            rightCount -= ends[plane];
+        }
+    }
+    return found;
+}
+
+static PCT_KdTree *PCT_BuildKdTreeNode(PCT_AaBb *boxes, const size_t boxesCount,
+                                       const PCT_KdTreeBuildParams *params, const size_t depth) {
+    assert(boxes != NULL);
+    assert(boxesCount > 0);
+
+    // Bounds and coverage let renderers draw a whole subtree as one rect once it gets small.
+    PCT_AaBb bounds = boxes[0];
+    float area = 0.0f;
+    for (size_t i = 0; i < boxesCount; i++) {
+        bounds.x1 = fminf(bounds.x1, boxes[i].x1);
+        bounds.y1 = fminf(bounds.y1, boxes[i].y1);
+        bounds.x2 = fmaxf(bounds.x2, boxes[i].x2);
+        bounds.y2 = fmaxf(bounds.y2, boxes[i].y2);
+        area += (boxes[i].x2 - boxes[i].x1) * (boxes[i].y2 - boxes[i].y1);
+    }
+    float boundsArea = (bounds.x2 - bounds.x1) * (bounds.y2 - bounds.y1);
+    float coverage = boundsArea > 0.0f ? fminf(area / boundsArea, 1.0f) : 1.0f;
+
+    uint8_t axis = PCT_KDTREE_AXIS_NONE;
+    float boundary = 0.0f;
+    PCT_KdTreeBuildCounters counters = {0};
+    if (boxesCount >= params->leafSize && depth + 1 < params->maxDepth) {
+        if (params->splitMode == PCT_KDTREE_SPLIT_SAH) {
+            counters.sahEvaluations++;
+            if (!PCT_ChooseSahSplit(boxes, boxesCount, bounds, params, &axis, &boundary)) {
+                axis = PCT_KDTREE_AXIS_NONE;
+                counters.sahLeaves++;
+            }
+        } else {
+            PCT_ChooseMedianSplit(boxes, boxesCount, &axis, &boundary);
+        }
+    } else if (boxesCount >= params->leafSize) {
+        counters.depthLeaves++;
+    }
+
+    if (axis == PCT_KDTREE_AXIS_NONE) {
+        PCT_KdTree *leaf = malloc(sizeof(PCT_KdTree));
+        leaf->axis = PCT_KDTREE_AXIS_NONE;
+        leaf->bounds = bounds;
+        leaf->coverage = coverage;
+#if defined(PCT_KDTREE_PROFILE)
+        SDL_AtomicSet(&leaf->queryCount, 0);
+        leaf->heat = 0;
+#endif
+        leaf->data.leaf.bucket = malloc(sizeof(PCT_AaBb) * boxesCount);
+        memcpy(leaf->data.leaf.bucket, boxes, sizeof(PCT_AaBb) * boxesCount);
+        leaf->data.leaf.elementCount = boxesCount;
+        free(boxes);
+        counters.leaves++;
+        PCT_KDTREE_PROFILE_BUILD(&counters);
+        return leaf;
+    }
 
     PCT_KdTree *tree = malloc(sizeof(PCT_KdTree));
 
     tree->axis = axis;
-    tree->data.node.boundary = median;
+    tree->bounds = bounds;
+    tree->coverage = coverage;
+    tree->data.node.boundary = boundary;
     tree->data.node.nodes = malloc(sizeof(PCT_KdTree *) * 2);
     tree->data.node.nodes[0] = (PCT_KdTree *)NULL;
     tree->data.node.nodes[1] = (PCT_KdTree *)NULL;
@@ -92,45 +217,73 @@ PCT_KdTree *PCT_BuildKdTree(PCT_AaBb *boxes, const size_t boxesCount) {
     PCT_AaBb *rightBoxes = malloc(sizeof(PCT_AaBb) * boxesCount);
     for (size_t i = 0; i < boxesCount; i++) {
         float start, end;
-        switch (axis) {
-        case PCT_KDTREE_AXIS_X:
-            start = boxes[i].x1;
-            end = boxes[i].x2;
-            break;
-        case PCT_KDTREE_AXIS_Y:
-            start = boxes[i].y1;
-            end = boxes[i].y2;
-            break;
-        default:
-            printf("Failed while building kdTree.\n");
-            exit(PCT_EXIT_CODE_INVALID_OPERATION);
-            break;
-        }
-        if (end <= median || (end > median && start < median)) {
+        PCT_BoxExtent(boxes + i, axis, &start, &end);
+        if (end <= boundary || (end > boundary && start < boundary)) {
             memmove(leftBoxes + leftBoxesCount, boxes + i, sizeof(PCT_AaBb));
             leftBoxesCount++;
         }
-        if (start > median || (start <= median && end > median)) {
+        if (start > boundary || (start <= boundary && end > boundary)) {
             memmove(rightBoxes + rightBoxesCount, boxes + i, sizeof(PCT_AaBb));
             rightBoxesCount++;
         }
     }
     free(boxes);
+    counters.splits++;
+    counters.straddlingCopies = leftBoxesCount + rightBoxesCount - boxesCount;
+    PCT_KDTREE_PROFILE_BUILD(&counters);
 
     if (leftBoxesCount > 0) {
-        tree->data.node.nodes[0] = PCT_BuildKdTree(leftBoxes, leftBoxesCount);
+        tree->data.node.nodes[0] =
+            PCT_BuildKdTreeNode(leftBoxes, leftBoxesCount, params, depth + 1);
+    } else {
+        free(leftBoxes);
     }
     if (rightBoxesCount > 0) {
-        tree->data.node.nodes[1] = PCT_BuildKdTree(rightBoxes, rightBoxesCount);
+        tree->data.node.nodes[1] =
+            PCT_BuildKdTreeNode(rightBoxes, rightBoxesCount, params, depth + 1);
+    } else {
+        free(rightBoxes);
     }
     return tree;
 }
 
-PCT_AaBb **PCT_KdTreeRangeSearch(const PCT_KdTree *tree, const PCT_AaBb *range, size_t *numBoxes) {
+PCT_KdTreeBuildParams PCT_KdTreeDefaultBuildParams(void) {
+    return (PCT_KdTreeBuildParams){.splitMode = PCT_KDTREE_SPLIT_MEDIAN,
+                                   .leafSize = PCT_KDTREE_LEAF_SIZE,
+                                   .maxDepth = PCT_KDTREE_MAX_DEPTH,
+                                   .binCount = PCT_KDTREE_SAH_BINS,
+                                   .traversalCost = PCT_KDTREE_SAH_TRAVERSAL_COST,
+                                   .intersectionCost = PCT_KDTREE_SAH_INTERSECTION_COST};
+}
+
+PCT_KdTree *PCT_BuildKdTree(PCT_AaBb *boxes, const size_t boxesCount) {
+    PCT_KdTreeBuildParams params = PCT_KdTreeDefaultBuildParams();
+    return PCT_BuildKdTreeWithParams(boxes, boxesCount, &params);
+}
 
+PCT_KdTree *PCT_BuildKdTreeWithParams(PCT_AaBb *boxes, const size_t boxesCount,
+                                      const PCT_KdTreeBuildParams *params) {
+    assert(params != NULL);
+
+    PCT_KdTreeBuildParams clamped = *params;
+    clamped.leafSize = clamped.leafSize > 0 ? clamped.leafSize : 1;
+    clamped.maxDepth = clamped.maxDepth > 0 ? clamped.maxDepth : 1;
+    clamped.maxDepth =
+        clamped.maxDepth > PCT_KDTREE_MAX_DEPTH ? PCT_KDTREE_MAX_DEPTH : clamped.maxDepth;
+    PCT_KdTreeBuildCounters counters = {.builds = 1};
+    PCT_KDTREE_PROFILE_BUILD(&counters);
+    return PCT_BuildKdTreeNode(boxes, boxesCount, &clamped, 0);
+}
+
+static PCT_AaBb **PCT_RangeSearchNode(const PCT_KdTree *tree, const PCT_AaBb *range,
+                                      size_t *numBoxes, PCT_KdTreeQueryCounters *counters) {
+    counters->nodesVisited++;
     if (tree->axis == PCT_KDTREE_AXIS_NONE) {
+        counters->leavesScanned++;
+        counters->boxesTested += tree->data.leaf.elementCount;
+        PCT_KDTREE_PROFILE_LEAF(tree);
         size_t collidedBoxes = 0;
-        PCT_AaBb **boxesInRange = malloc(sizeof(PCT_AaBb *) * PCT_KDTREE_LEAF_SIZE);
+        PCT_AaBb **boxesInRange = malloc(sizeof(PCT_AaBb *) * tree->data.leaf.elementCount);
         for (size_t i = 0; i < tree->data.leaf.elementCount; i++) {
             if (PCT_AaBbCollisionTest(range, &tree->data.leaf.bucket[i], NULL)) {
                 boxesInRange[collidedBoxes] = tree->data.leaf.bucket + i;
@@ -163,11 +316,13 @@ PCT_AaBb **PCT_KdTreeRangeSearch(const PCT_KdTree *tree, const PCT_AaBb *range,
     size_t rightBoxesCount = 0;
     if (tree->data.node.nodes[0] != NULL &&
         (max <= tree->data.node.boundary || min < tree->data.node.boundary && max > tree->data.node.boundary)) {
-        leftBoxes = PCT_KdTreeRangeSearch(tree->data.node.nodes[0], range, &leftBoxesCount);
+        leftBoxes =
+            PCT_RangeSearchNode(tree->data.node.nodes[0], range, &leftBoxesCount, counters);
     }
     if (tree->data.node.nodes[0] != NULL &&
         (min > tree->data.node.boundary || min < tree->data.node.boundary && max > tree->data.node.boundary)) {
-        rightBoxes = PCT_KdTreeRangeSearch(tree->data.node.nodes[1], range, &rightBoxesCount);
+        rightBoxes =
+            PCT_RangeSearchNode(tree->data.node.nodes[1], range, &rightBoxesCount, counters);
     }
 
     if (leftBoxes == NULL && rightBoxes == NULL) {
@@ -188,4 +343,237 @@ PCT_AaBb **PCT_KdTreeRangeSearch(const PCT_KdTree *tree, const PCT_AaBb *range,
     return boxesInRange;
 }
 
-void PCT_DestroyKdTree(PCT_KdTree *tree) { free(tree); }
\ No newline at end of file
+#if defined(PCT_KDTREE_PROFILE)
+static size_t PCT_CountDuplicateBoxes(const PCT_AaBb *const *boxes, const size_t count) {
+    // Straddling boxes are copied into every leaf they touch, compare by value.
+    size_t duplicates = 0;
+    for (size_t i = 1; i < count; i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (memcmp(boxes[i], boxes[j], sizeof(PCT_AaBb)) == 0) {
+                duplicates++;
+                break;
+            }
+        }
+    }
+    return duplicates;
+}
+#endif
+
+PCT_AaBb **PCT_KdTreeRangeSearch(const PCT_KdTree *tree, const PCT_AaBb *range, size_t *numBoxes) {
+    PCT_KdTreeQueryCounters counters = {.queries = 1};
+    PCT_AaBb **boxes = PCT_RangeSearchNode(tree, range, numBoxes, &counters);
+    counters.boxesHit = *numBoxes;
+#if defined(PCT_KDTREE_PROFILE)
+    counters.duplicateHits = PCT_CountDuplicateBoxes((const PCT_AaBb *const *)boxes, *numBoxes);
+#endif
+    PCT_KDTREE_PROFILE_QUERY(&counters);
+    return boxes;
+}
+
+size_t PCT_KdTreeRangeQuery(const PCT_KdTree *tree, const PCT_AaBb *range, const PCT_AaBb **boxes,
+                            const size_t capacity) {
+    assert(tree != NULL);
+    assert(range != NULL);
+    assert(boxes != NULL || capacity == 0);
+
+    const PCT_KdTree *stack[PCT_KDTREE_MAX_DEPTH];
+    size_t stackSize = 0;
+    size_t found = 0;
+    PCT_KdTreeQueryCounters counters = {.queries = 1};
+    const PCT_KdTree *node = tree;
+    while (node != NULL) {
+        counters.nodesVisited++;
+        if (node->axis == PCT_KDTREE_AXIS_NONE) {
+            counters.leavesScanned++;
+            counters.boxesTested += node->data.leaf.elementCount;
+            PCT_KDTREE_PROFILE_LEAF(node);
+            for (size_t i = 0; i < node->data.leaf.elementCount; i++) {
+                if (PCT_AaBbCollisionTest(range, &node->data.leaf.bucket[i], NULL)) {
+                    if (found < capacity) {
+                        boxes[found] = node->data.leaf.bucket + i;
+                    }
+                    found++;
+                }
+            }
+            node = stackSize > 0 ? stack[--stackSize] : NULL;
+            continue;
+        }
+
+        float min = node->axis == PCT_KDTREE_AXIS_X ? range->x1 : range->y1;
+        float max = node->axis == PCT_KDTREE_AXIS_X ? range->x2 : range->y2;
+        const PCT_KdTree *left = min < node->data.node.boundary ? node->data.node.nodes[0] : NULL;
+        const PCT_KdTree *right = max > node->data.node.boundary ? node->data.node.nodes[1] : NULL;
+        if (left != NULL && right != NULL) {
+            assert(stackSize < PCT_KDTREE_MAX_DEPTH);
+            stack[stackSize++] = right;
+            node = left;
+        } else if (left != NULL || right != NULL) {
+            node = left != NULL ? left : right;
+        } else {
+            node = stackSize > 0 ? stack[--stackSize] : NULL;
+        }
+    }
+    counters.boxesHit = found;
+#if defined(PCT_KDTREE_PROFILE)
+    counters.duplicateHits = PCT_CountDuplicateBoxes(boxes, found < capacity ? found : capacity);
+#endif
+    PCT_KDTREE_PROFILE_QUERY(&counters);
+    return found;
+}
+
+static inline void PCT_EmitLodBox(PCT_LodBox *boxes, const size_t capacity, size_t *found,
+                                  const PCT_AaBb *box, const float coveredArea) {
+    if (*found < capacity) {
+        float area = (box->x2 - box->x1) * (box->y2 - box->y1);
+        boxes[*found] = (PCT_LodBox){.box = *box,
+                                     .coverage = area > 0.0f ? fminf(coveredArea / area, 1.0f)
+                                                             : 1.0f};
+    }
+    (*found)++;
+}
+
+size_t PCT_KdTreeLodQuery(const PCT_KdTree *tree, const PCT_AaBb *view, const float minExtent,
+                          PCT_LodBox *boxes, const size_t capacity) {
+    assert(tree != NULL);
+    assert(view != NULL);
+    assert(boxes != NULL || capacity == 0);
+
+    const PCT_KdTree *stack[PCT_KDTREE_MAX_DEPTH];
+    size_t stackSize = 0;
+    size_t found = 0;
+    PCT_KdTreeQueryCounters counters = {.queries = 1};
+    const PCT_KdTree *node = tree;
+    while (node != NULL) {
+        counters.nodesVisited++;
+        const PCT_AaBb *bounds = &node->bounds;
+        float boundsWidth = bounds->x2 - bounds->x1;
+        float boundsHeight = bounds->y2 - bounds->y1;
+        if (!PCT_AaBbCollisionTest(view, bounds, NULL)) {
+            // Outside of the view, nothing to draw.
+        } else if (boundsWidth <= minExtent && boundsHeight <= minExtent) {
+            PCT_EmitLodBox(boxes, capacity, &found, bounds,
+                           node->coverage * boundsWidth * boundsHeight);
+        } else if (node->axis == PCT_KDTREE_AXIS_NONE) {
+            // Boxes below minExtent are merged into runs that stay within minExtent.
+            counters.leavesScanned++;
+            counters.boxesTested += node->data.leaf.elementCount;
+            PCT_KDTREE_PROFILE_LEAF(node);
+            PCT_AaBb merged = {0};
+            float mergedArea = 0.0f;
+            for (size_t i = 0; i < node->data.leaf.elementCount; i++) {
+                const PCT_AaBb *box = node->data.leaf.bucket + i;
+                if (!PCT_AaBbCollisionTest(view, box, NULL)) {
+                    continue;
+                }
+                float width = box->x2 - box->x1;
+                float height = box->y2 - box->y1;
+                if (width > minExtent || height > minExtent) {
+                    PCT_EmitLodBox(boxes, capacity, &found, box, width * height);
+                    continue;
+                }
+                PCT_AaBb grown = {fminf(merged.x1, box->x1), fminf(merged.y1, box->y1),
+                                  fmaxf(merged.x2, box->x2), fmaxf(merged.y2, box->y2)};
+                if (mergedArea > 0.0f && grown.x2 - grown.x1 <= minExtent &&
+                    grown.y2 - grown.y1 <= minExtent) {
+                    merged = grown;
+                    mergedArea += width * height;
+                    continue;
+                }
+                if (mergedArea > 0.0f) {
+                    PCT_EmitLodBox(boxes, capacity, &found, &merged, mergedArea);
+                }
+                merged = *box;
+                mergedArea = width * height;
+            }
+            if (mergedArea > 0.0f) {
+                PCT_EmitLodBox(boxes, capacity, &found, &merged, mergedArea);
+            }
+        } else {
+            const PCT_KdTree *left = node->data.node.nodes[0];
+            const PCT_KdTree *right = node->data.node.nodes[1];
+            if (left != NULL && right != NULL) {
+                assert(stackSize < PCT_KDTREE_MAX_DEPTH);
+                stack[stackSize++] = right;
+            }
+            if (left != NULL || right != NULL) {
+                node = left != NULL ? left : right;
+                continue;
+            }
+        }
+        node = stackSize > 0 ? stack[--stackSize] : NULL;
+    }
+    counters.boxesHit = found;
+    PCT_KDTREE_PROFILE_QUERY(&counters);
+    return found;
+}
+
+static void PCT_CollectStats(const PCT_KdTree *node, const size_t depth, PCT_KdTreeStats *stats) {
+    stats->memoryBytes += sizeof(PCT_KdTree);
+    stats->depth = depth > stats->depth ? depth : stats->depth;
+    if (node->axis == PCT_KDTREE_AXIS_NONE) {
+        size_t occupancy = node->data.leaf.elementCount;
+        size_t bucket = 0;
+        while (bucket + 1 < PCT_KDTREE_STATS_BUCKETS && occupancy >= ((size_t)1 << bucket)) {
+            bucket++;
+        }
+        stats->leafCount++;
+        stats->leafHistogram[bucket]++;
+        stats->storedBoxes += occupancy;
+        stats->maxLeafOccupancy =
+            occupancy > stats->maxLeafOccupancy ? occupancy : stats->maxLeafOccupancy;
+        stats->memoryBytes += sizeof(PCT_AaBb) * occupancy;
+        return;
+    }
+
+    stats->nodeCount++;
+    stats->memoryBytes += sizeof(PCT_KdTree *) * 2;
+    for (size_t i = 0; i < 2; i++) {
+        if (node->data.node.nodes[i] != NULL) {
+            PCT_CollectStats(node->data.node.nodes[i], depth + 1, stats);
+        }
+    }
+}
+
+void PCT_KdTreeComputeStats(const PCT_KdTree *tree, const size_t sourceBoxesCount,
+                            PCT_KdTreeStats *stats) {
+    assert(tree != NULL);
+    assert(stats != NULL);
+
+    memset(stats, 0, sizeof(PCT_KdTreeStats));
+    stats->sourceBoxes = sourceBoxesCount;
+    PCT_CollectStats(tree, 0, stats);
+    stats->duplicationFactor =
+        sourceBoxesCount > 0 ? (float)stats->storedBoxes / (float)sourceBoxesCount : 0.0f;
+}
+
+void PCT_KdTreePrintStats(const PCT_KdTreeStats *stats, FILE *stream) {
+    fprintf(stream, "kdTree: depth %zu, %zu nodes, %zu leaves, %zu KiB\n", stats->depth,
+            stats->nodeCount, stats->leafCount, stats->memoryBytes / 1024);
+    fprintf(stream, "kdTree: %zu boxes stored for %zu source boxes, duplication %.2f\n",
+            stats->storedBoxes, stats->sourceBoxes, stats->duplicationFactor);
+    fprintf(stream, "kdTree: leaf occupancy, max %zu\n", stats->maxLeafOccupancy);
+    for (size_t i = 0; i < PCT_KDTREE_STATS_BUCKETS; i++) {
+        if (i == 0) {
+            fprintf(stream, "    %5s %8zu\n", "0", stats->leafHistogram[i]);
+        } else if (i + 1 == PCT_KDTREE_STATS_BUCKETS) {
+            fprintf(stream, "    %4zu+ %8zu\n", (size_t)1 << (i - 1), stats->leafHistogram[i]);
+        } else {
+            fprintf(stream, "    %5zu %8zu  (< %zu)\n", (size_t)1 << (i - 1),
+                    stats->leafHistogram[i], (size_t)1 << i);
+        }
+    }
+}
+
+void PCT_DestroyKdTree(PCT_KdTree *tree) {
+    if (tree == NULL) {
+        return;
+    }
+    if (tree->axis == PCT_KDTREE_AXIS_NONE) {
+        free(tree->data.leaf.bucket);
+    } else {
+        PCT_DestroyKdTree(tree->data.node.nodes[0]);
+        PCT_DestroyKdTree(tree->data.node.nodes[1]);
+        free(tree->data.node.nodes);
+    }
+    free(tree);
+}
\ No newline at end of file
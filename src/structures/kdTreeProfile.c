@@ -0,0 +1,146 @@
+#include "../game/game.h"
+#include "structures.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PCT_QUERY_COUNTER_COUNT (sizeof(PCT_KdTreeQueryCounters) / sizeof(uint64_t))
+#define PCT_BUILD_COUNTER_COUNT (sizeof(PCT_KdTreeBuildCounters) / sizeof(uint64_t))
+
+static const char *PCT_SiteNames[PCT_KDTREE_SITE_COUNT] = {"other", "player", "enemy", "draw"};
+
+#if defined(PCT_KDTREE_PROFILE)
+
+// Queries keep their counters on the stack and add them here once, so pool threads only meet
+// on a handful of atomics per query. A window is short enough for 32 bit counters.
+static SDL_AtomicInt PCT_QueryCounters[PCT_KDTREE_SITE_COUNT][PCT_QUERY_COUNTER_COUNT];
+static SDL_AtomicInt PCT_BuildCounters[PCT_BUILD_COUNTER_COUNT];
+static _Thread_local PCT_KdTreeSite PCT_CurrentSite = PCT_KDTREE_SITE_OTHER;
+
+bool PCT_KdTreeProfileEnabled(void) { return true; }
+
+PCT_KdTreeSite PCT_KdTreeProfileSetSite(const PCT_KdTreeSite site) {
+    assert(site < PCT_KDTREE_SITE_COUNT);
+    PCT_KdTreeSite previous = PCT_CurrentSite;
+    PCT_CurrentSite = site;
+    return previous;
+}
+
+void PCT_KdTreeProfileAddQuery(const PCT_KdTreeQueryCounters *counters) {
+    const uint64_t *values = (const uint64_t *)counters;
+    for (size_t i = 0; i < PCT_QUERY_COUNTER_COUNT; i++) {
+        if (values[i] > 0) {
+            SDL_AtomicAdd(&PCT_QueryCounters[PCT_CurrentSite][i], (int)values[i]);
+        }
+    }
+}
+
+void PCT_KdTreeProfileAddBuild(const PCT_KdTreeBuildCounters *counters) {
+    const uint64_t *values = (const uint64_t *)counters;
+    for (size_t i = 0; i < PCT_BUILD_COUNTER_COUNT; i++) {
+        if (values[i] > 0) {
+            SDL_AtomicAdd(&PCT_BuildCounters[i], (int)values[i]);
+        }
+    }
+}
+
+void PCT_KdTreeProfileAddLeaf(const PCT_KdTree *leaf) {
+    // Counters are the only part of a shared tree queries write to.
+    SDL_AtomicAdd(&((PCT_KdTree *)leaf)->queryCount, 1);
+}
+
+static void PCT_RollHeat(const PCT_KdTree *node, uint32_t *maxHeat) {
+    if (node->axis == PCT_KDTREE_AXIS_NONE) {
+        PCT_KdTree *leaf = (PCT_KdTree *)node;
+        leaf->heat = (uint32_t)SDL_AtomicSet(&leaf->queryCount, 0);
+        *maxHeat = leaf->heat > *maxHeat ? leaf->heat : *maxHeat;
+        return;
+    }
+    for (size_t i = 0; i < 2; i++) {
+        if (node->data.node.nodes[i] != NULL) {
+            PCT_RollHeat(node->data.node.nodes[i], maxHeat);
+        }
+    }
+}
+
+void PCT_KdTreeProfileRoll(const PCT_KdTree *tree, PCT_KdTreeProfile *profile) {
+    assert(profile != NULL);
+
+    for (size_t site = 0; site < PCT_KDTREE_SITE_COUNT; site++) {
+        uint64_t *window = (uint64_t *)&profile->window[site];
+        uint64_t *total = (uint64_t *)&profile->total[site];
+        for (size_t i = 0; i < PCT_QUERY_COUNTER_COUNT; i++) {
+            window[i] = (uint32_t)SDL_AtomicSet(&PCT_QueryCounters[site][i], 0);
+            total[i] += window[i];
+        }
+    }
+    uint64_t *build = (uint64_t *)&profile->build;
+    for (size_t i = 0; i < PCT_BUILD_COUNTER_COUNT; i++) {
+        build[i] += (uint32_t)SDL_AtomicSet(&PCT_BuildCounters[i], 0);
+    }
+    profile->windowCount++;
+    profile->maxHeat = 0;
+    if (tree != NULL) {
+        PCT_RollHeat(tree, &profile->maxHeat);
+    }
+}
+
+uint32_t PCT_KdTreeLeafHeat(const PCT_KdTree *leaf) { return leaf->heat; }
+
+#else
+
+bool PCT_KdTreeProfileEnabled(void) { return false; }
+
+PCT_KdTreeSite PCT_KdTreeProfileSetSite(const PCT_KdTreeSite site) {
+    (void)site;
+    return PCT_KDTREE_SITE_OTHER;
+}
+
+void PCT_KdTreeProfileAddQuery(const PCT_KdTreeQueryCounters *counters) { (void)counters; }
+
+void PCT_KdTreeProfileAddBuild(const PCT_KdTreeBuildCounters *counters) { (void)counters; }
+
+void PCT_KdTreeProfileAddLeaf(const PCT_KdTree *leaf) { (void)leaf; }
+
+void PCT_KdTreeProfileRoll(const PCT_KdTree *tree, PCT_KdTreeProfile *profile) {
+    (void)tree;
+    assert(profile != NULL);
+    memset(profile->window, 0, sizeof(profile->window));
+    profile->windowCount++;
+}
+
+uint32_t PCT_KdTreeLeafHeat(const PCT_KdTree *leaf) {
+    (void)leaf;
+    return 0;
+}
+
+#endif
+
+void PCT_KdTreePrintProfile(const PCT_KdTreeProfile *profile, FILE *stream) {
+    const PCT_KdTreeBuildCounters *build = &profile->build;
+    fprintf(stream,
+            "kdTree build: %llu builds, %llu splits, %llu leaves (%llu kept by SAH, %llu at depth "
+            "limit), %llu straddling copies, %llu SAH evaluations\n",
+            (unsigned long long)build->builds, (unsigned long long)build->splits,
+            (unsigned long long)build->leaves, (unsigned long long)build->sahLeaves,
+            (unsigned long long)build->depthLeaves, (unsigned long long)build->straddlingCopies,
+            (unsigned long long)build->sahEvaluations);
+    for (size_t site = 0; site < PCT_KDTREE_SITE_COUNT; site++) {
+        const PCT_KdTreeQueryCounters *total = &profile->total[site];
+        if (total->queries == 0) {
+            continue;
+        }
+        double queries = (double)total->queries;
+        fprintf(stream,
+                "kdTree %-6s: %llu queries, per query %.1f nodes, %.1f leaves, %.1f tested, "
+                "%.2f hit, %.1f tested per hit, %.1f%% duplicate hits\n",
+                PCT_SiteNames[site], (unsigned long long)total->queries,
+                (double)total->nodesVisited / queries, (double)total->leavesScanned / queries,
+                (double)total->boxesTested / queries, (double)total->boxesHit / queries,
+                total->boxesHit > 0 ? (double)total->boxesTested / (double)total->boxesHit : 0.0,
+                total->boxesHit > 0
+                    ? 100.0 * (double)total->duplicateHits / (double)total->boxesHit
+                    : 0.0);
+    }
+}
@@ -0,0 +1,442 @@
+#include "../game/game.h"
+#include "structures.h"
+#include <assert.h>
+#include <cglm/cglm.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if PCT_RAY_PACKET_SIZE > 32
+#error "PCT_RAY_PACKET_SIZE must fit in the 32 bit ray mask"
+#endif
+
+typedef struct {
+    const PCT_KdTree *node;
+    float timeMin;
+    float timeMax;
+} PCT_RayStackEntry;
+
+typedef struct {
+    const PCT_KdTree *node;
+    uint32_t mask;
+} PCT_PacketStackEntry;
+
+typedef struct {
+    const PCT_KdTree *node;
+    float lowerBound;
+} PCT_NearestStackEntry;
+
+static inline float PCT_AxisValue(const uint8_t axis, const float x, const float y) {
+    return axis == PCT_KDTREE_AXIS_X ? x : y;
+}
+
+bool PCT_RayBoxTest(const PCT_Point *origin, const PCT_Vector *direction, const PCT_AaBb *box,
+                    const float maxTime, float *time, vec2 normal) {
+    float timeEnter = 0.0f;
+    float timeExit = maxTime;
+    float normalX = 0.0f;
+    float normalY = 0.0f;
+
+    if (direction->x == 0.0f) {
+        if (origin->x < box->x1 || origin->x > box->x2) {
+            return false;
+        }
+    } else {
+        float near = ((direction->x > 0.0f ? box->x1 : box->x2) - origin->x) / direction->x;
+        float far = ((direction->x > 0.0f ? box->x2 : box->x1) - origin->x) / direction->x;
+        if (near > timeEnter) {
+            timeEnter = near;
+            normalX = direction->x > 0.0f ? -1.0f : 1.0f;
+        }
+        timeExit = fminf(timeExit, far);
+        if (timeEnter > timeExit) {
+            return false;
+        }
+    }
+
+    if (direction->y == 0.0f) {
+        if (origin->y < box->y1 || origin->y > box->y2) {
+            return false;
+        }
+    } else {
+        float near = ((direction->y > 0.0f ? box->y1 : box->y2) - origin->y) / direction->y;
+        float far = ((direction->y > 0.0f ? box->y2 : box->y1) - origin->y) / direction->y;
+        if (near > timeEnter) {
+            timeEnter = near;
+            normalX = 0.0f;
+            normalY = direction->y > 0.0f ? -1.0f : 1.0f;
+        }
+        timeExit = fminf(timeExit, far);
+        if (timeEnter > timeExit) {
+            return false;
+        }
+    }
+
+    *time = timeEnter;
+    normal[0] = normalX;
+    normal[1] = normalY;
+    return true;
+}
+
+bool PCT_KdTreeRaycast(const PCT_KdTree *tree, const PCT_Point *origin, const PCT_Vector *direction,
+                       const float maxTime, PCT_RayHit *hit) {
+    assert(tree != NULL);
+    assert(origin != NULL);
+    assert(direction != NULL);
+
+    PCT_RayStackEntry stack[PCT_KDTREE_MAX_DEPTH];
+    size_t stackSize = 0;
+    PCT_RayStackEntry current = {.node = tree, .timeMin = 0.0f, .timeMax = maxTime};
+    PCT_RayHit best = {.box = NULL, .time = maxTime};
+    PCT_KdTreeQueryCounters counters = {.queries = 1};
+
+    while (current.node != NULL) {
+        const PCT_KdTree *node = current.node;
+        counters.nodesVisited++;
+        if (node->axis == PCT_KDTREE_AXIS_NONE) {
+            counters.leavesScanned++;
+            counters.boxesTested += node->data.leaf.elementCount;
+            PCT_KDTREE_PROFILE_LEAF(node);
+            for (size_t i = 0; i < node->data.leaf.elementCount; i++) {
+                float time;
+                vec2 normal;
+                if (PCT_RayBoxTest(origin, direction, node->data.leaf.bucket + i, best.time, &time,
+                                   normal) &&
+                    (best.box == NULL || time < best.time)) {
+                    best.box = node->data.leaf.bucket + i;
+                    best.time = time;
+                    best.normal[0] = normal[0];
+                    best.normal[1] = normal[1];
+                }
+            }
+            // Boxes straddling a split live on both sides, so a hit inside this cell's interval
+            // cannot be beaten by any cell further along the ray, those are pruned below.
+            current.node = NULL;
+        } else {
+            float boundary = node->data.node.boundary;
+            float start = PCT_AxisValue(node->axis, origin->x, origin->y);
+            float delta = PCT_AxisValue(node->axis, direction->x, direction->y);
+            // Near is the side the ray comes from, for an origin on the split that is the side
+            // it points away from.
+            bool nearIsLeft = start < boundary || (start == boundary && delta > 0.0f);
+            const PCT_KdTree *near = node->data.node.nodes[nearIsLeft ? 0 : 1];
+            const PCT_KdTree *far = node->data.node.nodes[nearIsLeft ? 1 : 0];
+            float timeSplit = delta != 0.0f ? (boundary - start) / delta : INFINITY;
+
+            if (delta == 0.0f && start == boundary) {
+                // Along the split, boxes starting on it are only stored on the right.
+                if (far != NULL) {
+                    assert(stackSize < PCT_KDTREE_MAX_DEPTH);
+                    stack[stackSize++] =
+                        (PCT_RayStackEntry){far, current.timeMin, current.timeMax};
+                }
+                current.node = near;
+            } else if (timeSplit > current.timeMax || timeSplit < 0.0f) {
+                current.node = near;
+            } else if (timeSplit < current.timeMin) {
+                current.node = far;
+            } else {
+                if (far != NULL) {
+                    assert(stackSize < PCT_KDTREE_MAX_DEPTH);
+                    stack[stackSize++] = (PCT_RayStackEntry){far, timeSplit, current.timeMax};
+                }
+                current.node = near;
+                current.timeMax = timeSplit;
+            }
+        }
+
+        while (current.node == NULL && stackSize > 0) {
+            current = stack[--stackSize];
+            if (best.box != NULL && current.timeMin >= best.time) {
+                current.node = NULL;
+            }
+        }
+    }
+
+    counters.boxesHit = best.box != NULL;
+    PCT_KDTREE_PROFILE_QUERY(&counters);
+    if (hit != NULL) {
+        *hit = best;
+    }
+    return best.box != NULL;
+}
+
+bool PCT_KdTreeSegmentCast(const PCT_KdTree *tree, const PCT_Point *from, const PCT_Point *to,
+                           PCT_RayHit *hit) {
+    PCT_Vector direction = {.x = to->x - from->x, .y = to->y - from->y};
+    return PCT_KdTreeRaycast(tree, from, &direction, 1.0f, hit);
+}
+
+static void PCT_RaycastPacket(const PCT_KdTree *tree, const PCT_Point *origins,
+                              const PCT_Vector *directions, const size_t count, PCT_RayHit *hits,
+                              PCT_KdTreeQueryCounters *counters) {
+    PCT_PacketStackEntry stack[PCT_KDTREE_MAX_DEPTH];
+    size_t stackSize = 0;
+    PCT_PacketStackEntry current = {.node = tree,
+                                    .mask = count >= 32 ? UINT32_MAX : (1u << count) - 1u};
+
+    while (current.node != NULL) {
+        const PCT_KdTree *node = current.node;
+        counters->nodesVisited++;
+        if (node->axis == PCT_KDTREE_AXIS_NONE) {
+            counters->leavesScanned++;
+            PCT_KDTREE_PROFILE_LEAF(node);
+            for (size_t ray = 0; ray < count; ray++) {
+                if (!(current.mask & (1u << ray))) {
+                    continue;
+                }
+                counters->boxesTested += node->data.leaf.elementCount;
+                for (size_t i = 0; i < node->data.leaf.elementCount; i++) {
+                    float time;
+                    vec2 normal;
+                    if (PCT_RayBoxTest(origins + ray, directions + ray,
+                                       node->data.leaf.bucket + i, hits[ray].time, &time, normal) &&
+                        (hits[ray].box == NULL || time < hits[ray].time)) {
+                        hits[ray].box = node->data.leaf.bucket + i;
+                        hits[ray].time = time;
+                        hits[ray].normal[0] = normal[0];
+                        hits[ray].normal[1] = normal[1];
+                    }
+                }
+            }
+        } else {
+            // Rays are clipped to their best hit so far, so finished rays drop out of the mask.
+            float boundary = node->data.node.boundary;
+            uint32_t leftMask = 0;
+            uint32_t rightMask = 0;
+            size_t activeRays = 0;
+            size_t originsLeft = 0;
+            for (size_t ray = 0; ray < count; ray++) {
+                if (!(current.mask & (1u << ray))) {
+                    continue;
+                }
+                float start = PCT_AxisValue(node->axis, origins[ray].x, origins[ray].y);
+                float delta = PCT_AxisValue(node->axis, directions[ray].x, directions[ray].y);
+                float end = start + delta * hits[ray].time;
+                leftMask |= (fminf(start, end) <= boundary) ? (1u << ray) : 0u;
+                rightMask |= (fmaxf(start, end) >= boundary) ? (1u << ray) : 0u;
+                activeRays++;
+                originsLeft += start < boundary;
+            }
+            bool nearIsLeft = originsLeft * 2 >= activeRays;
+            PCT_PacketStackEntry left = {node->data.node.nodes[0], leftMask};
+            PCT_PacketStackEntry right = {node->data.node.nodes[1], rightMask};
+            PCT_PacketStackEntry near = nearIsLeft ? left : right;
+            PCT_PacketStackEntry far = nearIsLeft ? right : left;
+            if (far.node != NULL && far.mask != 0) {
+                assert(stackSize < PCT_KDTREE_MAX_DEPTH);
+                stack[stackSize++] = far;
+            }
+            if (near.node != NULL && near.mask != 0) {
+                current = near;
+                continue;
+            }
+        }
+        current = stackSize > 0 ? stack[--stackSize] : (PCT_PacketStackEntry){NULL, 0};
+    }
+}
+
+size_t PCT_KdTreeRaycastPacket(const PCT_KdTree *tree, const PCT_Point *origins,
+                               const PCT_Vector *directions, const float *maxTimes,
+                               const size_t count, PCT_RayHit *hits) {
+    assert(tree != NULL);
+    assert(origins != NULL || count == 0);
+    assert(directions != NULL || count == 0);
+    assert(hits != NULL || count == 0);
+
+    for (size_t i = 0; i < count; i++) {
+        hits[i] = (PCT_RayHit){.box = NULL, .time = maxTimes != NULL ? maxTimes[i] : 1.0f};
+    }
+    PCT_KdTreeQueryCounters counters = {.queries = count};
+    for (size_t first = 0; first < count; first += PCT_RAY_PACKET_SIZE) {
+        size_t packetSize = count - first < PCT_RAY_PACKET_SIZE ? count - first : PCT_RAY_PACKET_SIZE;
+        PCT_RaycastPacket(tree, origins + first, directions + first, packetSize, hits + first,
+                          &counters);
+    }
+
+    size_t hitCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        hitCount += hits[i].box != NULL;
+    }
+    counters.boxesHit = hitCount;
+    PCT_KDTREE_PROFILE_QUERY(&counters);
+    return hitCount;
+}
+
+static inline float PCT_PointBoxDistanceSquared(const PCT_Point *point, const PCT_AaBb *box) {
+    float dx = fmaxf(fmaxf(box->x1 - point->x, point->x - box->x2), 0.0f);
+    float dy = fmaxf(fmaxf(box->y1 - point->y, point->y - box->y2), 0.0f);
+    return dx * dx + dy * dy;
+}
+
+static void PCT_HeapSiftDown(const PCT_AaBb **boxes, float *keys, const size_t count, size_t i) {
+    for (;;) {
+        size_t largest = i;
+        size_t left = 2 * i + 1;
+        size_t right = 2 * i + 2;
+        if (left < count && keys[left] > keys[largest]) {
+            largest = left;
+        }
+        if (right < count && keys[right] > keys[largest]) {
+            largest = right;
+        }
+        if (largest == i) {
+            return;
+        }
+        float key = keys[i];
+        const PCT_AaBb *box = boxes[i];
+        keys[i] = keys[largest];
+        boxes[i] = boxes[largest];
+        keys[largest] = key;
+        boxes[largest] = box;
+        i = largest;
+    }
+}
+
+static void PCT_HeapSiftUp(const PCT_AaBb **boxes, float *keys, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (keys[parent] >= keys[i]) {
+            return;
+        }
+        float key = keys[i];
+        const PCT_AaBb *box = boxes[i];
+        keys[i] = keys[parent];
+        boxes[i] = boxes[parent];
+        keys[parent] = key;
+        boxes[parent] = box;
+        i = parent;
+    }
+}
+
+static bool PCT_HeapContains(const PCT_AaBb **boxes, const size_t count, const PCT_AaBb *box) {
+    // Straddling boxes are copied into every leaf they touch, compare by value.
+    for (size_t i = 0; i < count; i++) {
+        if (memcmp(boxes[i], box, sizeof(PCT_AaBb)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t PCT_KdTreeNearest(const PCT_KdTree *tree, const PCT_Point *point, const size_t k,
+                         const PCT_AaBb **boxes, float *distances) {
+    assert(tree != NULL);
+    assert(point != NULL);
+    assert(boxes != NULL || k == 0);
+    assert(distances != NULL || k == 0);
+
+    if (k == 0) {
+        return 0;
+    }
+
+    PCT_NearestStackEntry stack[PCT_KDTREE_MAX_DEPTH];
+    size_t stackSize = 0;
+    PCT_NearestStackEntry current = {.node = tree, .lowerBound = 0.0f};
+    size_t found = 0;
+    PCT_KdTreeQueryCounters counters = {.queries = 1};
+
+    while (current.node != NULL) {
+        const PCT_KdTree *node = current.node;
+        counters.nodesVisited++;
+        if (node->axis == PCT_KDTREE_AXIS_NONE) {
+            counters.leavesScanned++;
+            counters.boxesTested += node->data.leaf.elementCount;
+            PCT_KDTREE_PROFILE_LEAF(node);
+            for (size_t i = 0; i < node->data.leaf.elementCount; i++) {
+                const PCT_AaBb *box = node->data.leaf.bucket + i;
+                float distance = PCT_PointBoxDistanceSquared(point, box);
+                if (found == k && distance >= distances[0]) {
+                    continue;
+                }
+                if (PCT_HeapContains(boxes, found, box)) {
+                    continue;
+                }
+                if (found < k) {
+                    boxes[found] = box;
+                    distances[found] = distance;
+                    PCT_HeapSiftUp(boxes, distances, found);
+                    found++;
+                } else {
+                    boxes[0] = box;
+                    distances[0] = distance;
+                    PCT_HeapSiftDown(boxes, distances, found, 0);
+                }
+            }
+            current.node = NULL;
+        } else {
+            float offset = PCT_AxisValue(node->axis, point->x, point->y) - node->data.node.boundary;
+            const PCT_KdTree *near = node->data.node.nodes[offset < 0.0f ? 0 : 1];
+            const PCT_KdTree *far = node->data.node.nodes[offset < 0.0f ? 1 : 0];
+            if (far != NULL) {
+                assert(stackSize < PCT_KDTREE_MAX_DEPTH);
+                stack[stackSize++] =
+                    (PCT_NearestStackEntry){far, fmaxf(current.lowerBound, offset * offset)};
+            }
+            current.node = near;
+        }
+
+        while (current.node == NULL && stackSize > 0) {
+            current = stack[--stackSize];
+            if (found == k && current.lowerBound >= distances[0]) {
+                current.node = NULL;
+            }
+        }
+    }
+
+    // Heap sort in place leaves results ordered from nearest to farthest.
+    for (size_t end = found; end > 1; end--) {
+        float key = distances[0];
+        const PCT_AaBb *box = boxes[0];
+        distances[0] = distances[end - 1];
+        boxes[0] = boxes[end - 1];
+        distances[end - 1] = key;
+        boxes[end - 1] = box;
+        PCT_HeapSiftDown(boxes, distances, end - 1, 0);
+    }
+    for (size_t i = 0; i < found; i++) {
+        distances[i] = sqrtf(distances[i]);
+    }
+    counters.boxesHit = found;
+    PCT_KDTREE_PROFILE_QUERY(&counters);
+    return found;
+}
+
+size_t PCT_KdTreePointQuery(const PCT_KdTree *tree, const PCT_Point *point, const PCT_AaBb **boxes,
+                            const size_t capacity) {
+    assert(tree != NULL);
+    assert(point != NULL);
+    assert(boxes != NULL || capacity == 0);
+
+    PCT_KdTreeQueryCounters counters = {.queries = 1};
+    const PCT_KdTree *node = tree;
+    while (node != NULL && node->axis != PCT_KDTREE_AXIS_NONE) {
+        counters.nodesVisited++;
+        float value = PCT_AxisValue(node->axis, point->x, point->y);
+        node = node->data.node.nodes[value < node->data.node.boundary ? 0 : 1];
+    }
+    if (node == NULL) {
+        PCT_KDTREE_PROFILE_QUERY(&counters);
+        return 0;
+    }
+
+    counters.nodesVisited++;
+    counters.leavesScanned++;
+    counters.boxesTested += node->data.leaf.elementCount;
+    PCT_KDTREE_PROFILE_LEAF(node);
+    size_t found = 0;
+    for (size_t i = 0; i < node->data.leaf.elementCount; i++) {
+        const PCT_AaBb *box = node->data.leaf.bucket + i;
+        if (point->x >= box->x1 && point->x < box->x2 && point->y >= box->y1 &&
+            point->y < box->y2) {
+            if (found < capacity) {
+                boxes[found] = box;
+            }
+            found++;
+        }
+    }
+    counters.boxesHit = found;
+    PCT_KDTREE_PROFILE_QUERY(&counters);
+    return found;
+}
@@ -0,0 +1,404 @@
+#include "../game/game.h"
+#include "../misc/errors.h"
+#include "structures.h"
+#include <assert.h>
+#include <cglm/cglm.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Rounding slack in cell units, touched cells are widened by it so float error cannot leave a
+// cell empty that a box reaches.
+#define PCT_OCCUPANCY_EPSILON 1e-3f
+
+static inline int64_t PCT_LowestBit(const uint64_t word) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int64_t)index;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+static inline int64_t PCT_HighestBit(const uint64_t word) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, word);
+    return (int64_t)index;
+#else
+    return 63 - __builtin_clzll(word);
+#endif
+}
+
+static uint64_t *PCT_AllocateBits(const size_t words) {
+    uint64_t *bits = calloc(words > 0 ? words : 1, sizeof(uint64_t));
+    if (bits == NULL) {
+        printf("Failed to allocate occupancy grid.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    return bits;
+}
+
+static void PCT_SetBits(uint64_t *line, const size_t first, const size_t last) {
+    size_t firstWord = first / 64;
+    size_t lastWord = last / 64;
+    uint64_t firstMask = UINT64_MAX << (first % 64);
+    uint64_t lastMask = UINT64_MAX >> (63 - last % 64);
+    if (firstWord == lastWord) {
+        line[firstWord] |= firstMask & lastMask;
+        return;
+    }
+    line[firstWord] |= firstMask;
+    for (size_t i = firstWord + 1; i < lastWord; i++) {
+        line[i] = UINT64_MAX;
+    }
+    line[lastWord] |= lastMask;
+}
+
+static bool PCT_AnyBits(const uint64_t *line, const size_t first, const size_t last) {
+    size_t firstWord = first / 64;
+    size_t lastWord = last / 64;
+    uint64_t firstMask = UINT64_MAX << (first % 64);
+    uint64_t lastMask = UINT64_MAX >> (63 - last % 64);
+    if (firstWord == lastWord) {
+        return (line[firstWord] & firstMask & lastMask) != 0;
+    }
+    if ((line[firstWord] & firstMask) != 0 || (line[lastWord] & lastMask) != 0) {
+        return true;
+    }
+    for (size_t i = firstWord + 1; i < lastWord; i++) {
+        if (line[i] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline bool PCT_TestBit(const uint64_t *line, const size_t index) {
+    return (line[index / 64] >> (index % 64)) & 1;
+}
+
+/**
+ * @brief Counts cells from start in step direction before the first one whose bit equals
+ * findSet, cells outside [0, length) read as clear. Padding bits past length must be clear.
+ * @return cell count, limit when no such cell is within limit cells
+ */
+static int64_t PCT_ScanBits(const uint64_t *line, const int64_t length, int64_t start,
+                            const int64_t step, const bool findSet, const int64_t limit) {
+    int64_t skipped = 0;
+    if (step > 0) {
+        if (start >= length) {
+            return findSet ? limit : 0;
+        }
+        if (start < 0) {
+            if (!findSet) {
+                return 0;
+            }
+            skipped = -start;
+            start = 0;
+        }
+    } else {
+        if (start < 0) {
+            return findSet ? limit : 0;
+        }
+        if (start >= length) {
+            if (!findSet) {
+                return 0;
+            }
+            skipped = start - (length - 1);
+            start = length - 1;
+        }
+    }
+    if (skipped >= limit) {
+        return limit;
+    }
+
+    uint64_t invert = findSet ? 0 : UINT64_MAX;
+    int64_t word = start / 64;
+    int64_t found = -1;
+    if (step > 0) {
+        int64_t lastWord = (length - 1) / 64;
+        uint64_t bits = (line[word] ^ invert) & (UINT64_MAX << (start % 64));
+        // Padding past length reads as set when looking for clear bits, which ends the run at
+        // the grid edge as it should.
+        while (bits == 0 && word < lastWord && (word + 1) * 64 - start + skipped < limit) {
+            bits = line[++word] ^ invert;
+        }
+        if (bits != 0) {
+            found = skipped + word * 64 + PCT_LowestBit(bits) - start;
+        } else if (word == lastWord && !findSet) {
+            // Length is a multiple of 64 so there was no padding to stop at.
+            found = skipped + length - start;
+        } else {
+            found = limit;
+        }
+    } else {
+        uint64_t bits = (line[word] ^ invert) & (UINT64_MAX >> (63 - start % 64));
+        while (bits == 0 && word > 0 && start - word * 64 + 1 + skipped < limit) {
+            bits = line[--word] ^ invert;
+        }
+        if (bits != 0) {
+            found = skipped + start - (word * 64 + PCT_HighestBit(bits));
+        } else if (word == 0 && !findSet) {
+            // Ran off the low edge, the outside is clear.
+            found = skipped + start + 1;
+        } else {
+            found = limit;
+        }
+    }
+    return found < limit ? found : limit;
+}
+
+static void PCT_BuildOccupancyLevels(PCT_OccupancyGrid *grid) {
+    while (grid->levelCount < PCT_OCCUPANCY_MAX_LEVELS) {
+        const PCT_OccupancyLevel *fine = grid->levels + grid->levelCount - 1;
+        if (fine->width <= 64 && fine->height <= 64) {
+            break;
+        }
+        PCT_OccupancyLevel *coarse = grid->levels + grid->levelCount;
+        coarse->width = (fine->width + 1) / 2;
+        coarse->height = (fine->height + 1) / 2;
+        coarse->wordsPerRow = (coarse->width + 63) / 64;
+        coarse->rows = PCT_AllocateBits(coarse->wordsPerRow * coarse->height);
+        grid->memoryBytes += sizeof(uint64_t) * coarse->wordsPerRow * coarse->height;
+        for (size_t y = 0; y < fine->height; y++) {
+            const uint64_t *fineRow = fine->rows + y * fine->wordsPerRow;
+            uint64_t *coarseRow = coarse->rows + (y / 2) * coarse->wordsPerRow;
+            for (size_t w = 0; w < fine->wordsPerRow; w++) {
+                for (uint64_t bits = fineRow[w]; bits != 0; bits &= bits - 1) {
+                    size_t x = (w * 64 + (size_t)PCT_LowestBit(bits)) / 2;
+                    coarseRow[x / 64] |= UINT64_C(1) << (x % 64);
+                }
+            }
+        }
+        grid->levelCount++;
+    }
+}
+
+PCT_OccupancyGrid *PCT_BuildOccupancyGrid(const PCT_AaBb *boxes, const size_t boxesCount,
+                                          float cellSize) {
+    assert(boxes != NULL || boxesCount == 0);
+    assert(cellSize > 0.0f);
+
+    PCT_OccupancyGrid *grid = calloc(1, sizeof(PCT_OccupancyGrid));
+    if (grid == NULL) {
+        printf("Failed to allocate occupancy grid.\n");
+        exit(PCT_EXIT_CODE_MEMORY_ERROR);
+    }
+    PCT_AaBb bounds = {0};
+    for (size_t i = 0; i < boxesCount; i++) {
+        bounds.x1 = i == 0 ? boxes[i].x1 : fminf(bounds.x1, boxes[i].x1);
+        bounds.y1 = i == 0 ? boxes[i].y1 : fminf(bounds.y1, boxes[i].y1);
+        bounds.x2 = i == 0 ? boxes[i].x2 : fmaxf(bounds.x2, boxes[i].x2);
+        bounds.y2 = i == 0 ? boxes[i].y2 : fmaxf(bounds.y2, boxes[i].y2);
+    }
+    size_t width, height;
+    for (;;) {
+        width = (size_t)ceilf((bounds.x2 - bounds.x1) / cellSize) + 1;
+        height = (size_t)ceilf((bounds.y2 - bounds.y1) / cellSize) + 1;
+        if (width * height <= PCT_OCCUPANCY_MAX_CELLS) {
+            break;
+        }
+        cellSize *= 2.0f;
+    }
+    grid->origin = (PCT_Point){bounds.x1, bounds.y1};
+    grid->cellSize = cellSize;
+    grid->inverseCellSize = 1.0f / cellSize;
+    grid->width = width;
+    grid->height = height;
+    grid->wordsPerRow = (width + 63) / 64;
+    grid->wordsPerColumn = (height + 63) / 64;
+    uint64_t *anyRows = PCT_AllocateBits(grid->wordsPerRow * height);
+    grid->fullRows = PCT_AllocateBits(grid->wordsPerRow * height);
+    grid->anyColumns = PCT_AllocateBits(grid->wordsPerColumn * width);
+    grid->fullColumns = PCT_AllocateBits(grid->wordsPerColumn * width);
+    grid->memoryBytes = sizeof(PCT_OccupancyGrid) +
+                        sizeof(uint64_t) * 2 * (grid->wordsPerRow * height +
+                                                grid->wordsPerColumn * width);
+
+    float lastX = (float)(width - 1);
+    float lastY = (float)(height - 1);
+    for (size_t i = 0; i < boxesCount; i++) {
+        float x1 = (boxes[i].x1 - grid->origin.x) * grid->inverseCellSize;
+        float x2 = (boxes[i].x2 - grid->origin.x) * grid->inverseCellSize;
+        float y1 = (boxes[i].y1 - grid->origin.y) * grid->inverseCellSize;
+        float y2 = (boxes[i].y2 - grid->origin.y) * grid->inverseCellSize;
+        size_t anyX1 = (size_t)glm_clamp(floorf(x1 - PCT_OCCUPANCY_EPSILON), 0.0f, lastX);
+        size_t anyX2 = (size_t)glm_clamp(floorf(x2 + PCT_OCCUPANCY_EPSILON), 0.0f, lastX);
+        size_t anyY1 = (size_t)glm_clamp(floorf(y1 - PCT_OCCUPANCY_EPSILON), 0.0f, lastY);
+        size_t anyY2 = (size_t)glm_clamp(floorf(y2 + PCT_OCCUPANCY_EPSILON), 0.0f, lastY);
+        for (size_t y = anyY1; y <= anyY2; y++) {
+            PCT_SetBits(anyRows + y * grid->wordsPerRow, anyX1, anyX2);
+        }
+        for (size_t x = anyX1; x <= anyX2; x++) {
+            PCT_SetBits(grid->anyColumns + x * grid->wordsPerColumn, anyY1, anyY2);
+        }
+
+        float fullX1 = ceilf(x1);
+        float fullX2 = floorf(x2) - 1.0f;
+        float fullY1 = ceilf(y1);
+        float fullY2 = floorf(y2) - 1.0f;
+        if (fullX1 > fullX2 || fullY1 > fullY2) {
+            continue;
+        }
+        for (size_t y = (size_t)fullY1; y <= (size_t)fullY2; y++) {
+            PCT_SetBits(grid->fullRows + y * grid->wordsPerRow, (size_t)fullX1, (size_t)fullX2);
+        }
+        for (size_t x = (size_t)fullX1; x <= (size_t)fullX2; x++) {
+            PCT_SetBits(grid->fullColumns + x * grid->wordsPerColumn, (size_t)fullY1,
+                        (size_t)fullY2);
+        }
+    }
+
+    grid->levels[0] = (PCT_OccupancyLevel){anyRows, width, height, grid->wordsPerRow};
+    grid->levelCount = 1;
+    PCT_BuildOccupancyLevels(grid);
+    return grid;
+}
+
+void PCT_DestroyOccupancyGrid(PCT_OccupancyGrid *grid) {
+    if (grid == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < grid->levelCount; i++) {
+        free(grid->levels[i].rows);
+    }
+    free(grid->fullRows);
+    free(grid->anyColumns);
+    free(grid->fullColumns);
+    free(grid);
+}
+
+static inline int64_t PCT_CellX(const PCT_OccupancyGrid *grid, const float x) {
+    return (int64_t)floorf((x - grid->origin.x) * grid->inverseCellSize);
+}
+
+static inline int64_t PCT_CellY(const PCT_OccupancyGrid *grid, const float y) {
+    return (int64_t)floorf((y - grid->origin.y) * grid->inverseCellSize);
+}
+
+PCT_Occupancy PCT_OccupancyAtPoint(const PCT_OccupancyGrid *grid, const PCT_Point *point) {
+    assert(grid != NULL);
+    assert(point != NULL);
+
+    int64_t x = PCT_CellX(grid, point->x);
+    int64_t y = PCT_CellY(grid, point->y);
+    if (x < 0 || y < 0 || x >= (int64_t)grid->width || y >= (int64_t)grid->height) {
+        return PCT_OCCUPANCY_EMPTY;
+    }
+    if (PCT_TestBit(grid->fullRows + y * grid->wordsPerRow, (size_t)x)) {
+        return PCT_OCCUPANCY_FULL;
+    }
+    return PCT_TestBit(grid->levels[0].rows + y * grid->wordsPerRow, (size_t)x)
+               ? PCT_OCCUPANCY_PARTIAL
+               : PCT_OCCUPANCY_EMPTY;
+}
+
+PCT_Occupancy PCT_OccupancyGroundBelow(const PCT_OccupancyGrid *grid, const PCT_Point *point,
+                                       const float maxDistance, float *distance) {
+    assert(grid != NULL);
+    assert(point != NULL);
+
+    int64_t x = PCT_CellX(grid, point->x);
+    int64_t top = PCT_CellY(grid, point->y);
+    int64_t cells = top - PCT_CellY(grid, point->y - maxDistance) + 1;
+    if (x < 0 || x >= (int64_t)grid->width) {
+        return PCT_OCCUPANCY_EMPTY;
+    }
+    int64_t height = (int64_t)grid->height;
+    const uint64_t *anyColumn = grid->anyColumns + x * grid->wordsPerColumn;
+    int64_t anyCells = PCT_ScanBits(anyColumn, height, top, -1, true, cells);
+    if (anyCells >= cells) {
+        return PCT_OCCUPANCY_EMPTY;
+    }
+    const uint64_t *fullColumn = grid->fullColumns + x * grid->wordsPerColumn;
+    int64_t fullCells = PCT_ScanBits(fullColumn, height, top, -1, true, cells);
+    int64_t groundCells = fullCells < cells ? fullCells : anyCells;
+    if (distance != NULL) {
+        float groundY = grid->origin.y + (float)(top - groundCells + 1) * grid->cellSize;
+        *distance = fmaxf(point->y - groundY, 0.0f);
+    }
+    return fullCells < cells ? PCT_OCCUPANCY_FULL : PCT_OCCUPANCY_PARTIAL;
+}
+
+static float PCT_OccupancyRun(const PCT_OccupancyGrid *grid, const uint64_t *anyLine,
+                              const uint64_t *fullLine, const int64_t length, const float origin,
+                              const float position, const float direction, const bool solid,
+                              const float maxDistance) {
+    int64_t start = (int64_t)floorf((position - origin) * grid->inverseCellSize);
+    int64_t step = direction < 0.0f ? -1 : 1;
+    int64_t limit = (int64_t)ceilf(maxDistance * grid->inverseCellSize) + 1;
+    int64_t cells = 0;
+    if (anyLine == NULL) {
+        // Line outside the grid is empty everywhere.
+        cells = solid ? 0 : limit;
+    } else if (solid) {
+        cells = PCT_ScanBits(fullLine, length, start, step, false, limit);
+    } else {
+        cells = PCT_ScanBits(anyLine, length, start, step, true, limit);
+    }
+    float end = origin + (float)(step > 0 ? start + cells : start - cells + 1) * grid->cellSize;
+    return glm_clamp((end - position) * (float)step, 0.0f, maxDistance);
+}
+
+float PCT_OccupancyRowRun(const PCT_OccupancyGrid *grid, const PCT_Point *point,
+                          const float direction, const bool solid, const float maxDistance) {
+    assert(grid != NULL);
+    assert(point != NULL);
+
+    int64_t y = PCT_CellY(grid, point->y);
+    bool inside = y >= 0 && y < (int64_t)grid->height;
+    const uint64_t *anyRow = inside ? grid->levels[0].rows + y * grid->wordsPerRow : NULL;
+    const uint64_t *fullRow = inside ? grid->fullRows + y * grid->wordsPerRow : NULL;
+    return PCT_OccupancyRun(grid, anyRow, fullRow, (int64_t)grid->width, grid->origin.x, point->x,
+                            direction, solid, maxDistance);
+}
+
+float PCT_OccupancyColumnRun(const PCT_OccupancyGrid *grid, const PCT_Point *point,
+                             const float direction, const bool solid, const float maxDistance) {
+    assert(grid != NULL);
+    assert(point != NULL);
+
+    int64_t x = PCT_CellX(grid, point->x);
+    bool inside = x >= 0 && x < (int64_t)grid->width;
+    const uint64_t *anyColumn = inside ? grid->anyColumns + x * grid->wordsPerColumn : NULL;
+    const uint64_t *fullColumn = inside ? grid->fullColumns + x * grid->wordsPerColumn : NULL;
+    return PCT_OccupancyRun(grid, anyColumn, fullColumn, (int64_t)grid->height, grid->origin.y,
+                            point->y, direction, solid, maxDistance);
+}
+
+bool PCT_OccupancyBoxEmpty(const PCT_OccupancyGrid *grid, const PCT_AaBb *box) {
+    assert(grid != NULL);
+    assert(box != NULL);
+
+    int64_t x1 = PCT_CellX(grid, box->x1);
+    int64_t x2 = PCT_CellX(grid, box->x2);
+    int64_t y1 = PCT_CellY(grid, box->y1);
+    int64_t y2 = PCT_CellY(grid, box->y2);
+    if (x2 < 0 || y2 < 0 || x1 >= (int64_t)grid->width || y1 >= (int64_t)grid->height) {
+        return true;
+    }
+    x1 = x1 > 0 ? x1 : 0;
+    y1 = y1 > 0 ? y1 : 0;
+    x2 = x2 < (int64_t)grid->width ? x2 : (int64_t)grid->width - 1;
+    y2 = y2 < (int64_t)grid->height ? y2 : (int64_t)grid->height - 1;
+    // Coarse cells cover their whole block, a clear one proves the box empty without reading
+    // the finer levels.
+    for (size_t level = grid->levelCount; level-- > 0;) {
+        const PCT_OccupancyLevel *occupancy = grid->levels + level;
+        bool any = false;
+        for (int64_t y = y1 >> level; y <= y2 >> level && !any; y++) {
+            any = PCT_AnyBits(occupancy->rows + y * occupancy->wordsPerRow, (size_t)(x1 >> level),
+                              (size_t)(x2 >> level));
+        }
+        if (!any) {
+            return true;
+        }
+    }
+    return false;
+}
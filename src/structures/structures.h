@@ -3,13 +3,55 @@
 
 #include "../game/game.h"
 #include <cglm/cglm.h>
+#include <stdio.h>
+#if defined(PCT_KDTREE_PROFILE)
+#include <SDL3/SDL.h>
+#endif
 
 #define PCT_KDTREE_AXIS_X 0
 #define PCT_KDTREE_AXIS_Y 1
 #define PCT_KDTREE_AXIS_NONE 2
 
+#ifndef PCT_KDTREE_MAX_DEPTH
+#define PCT_KDTREE_MAX_DEPTH 64
+#endif
+
+#ifndef PCT_KDTREE_LEAF_SIZE
+#define PCT_KDTREE_LEAF_SIZE 128
+#endif
+
+#ifndef PCT_KDTREE_SAH_BINS
+#define PCT_KDTREE_SAH_BINS 16
+#endif
+#define PCT_KDTREE_SAH_MAX_BINS 64
+#define PCT_KDTREE_SAH_TRAVERSAL_COST 1.0f
+#define PCT_KDTREE_SAH_INTERSECTION_COST 1.0f
+
+#define PCT_KDTREE_STATS_BUCKETS 12
+
+#ifndef PCT_RAY_PACKET_SIZE
+#define PCT_RAY_PACKET_SIZE 32
+#endif
+
+#ifndef PCT_OCCUPANCY_CELL_SIZE
+#define PCT_OCCUPANCY_CELL_SIZE 0.015625f
+#endif
+#ifndef PCT_OCCUPANCY_MAX_CELLS
+#define PCT_OCCUPANCY_MAX_CELLS (1 << 24)
+#endif
+#define PCT_OCCUPANCY_MAX_LEVELS 8
+
+#define PCT_COMPACT_KDTREE_AXIS_SHIFT 30
+#define PCT_COMPACT_KDTREE_VALUE_MASK ((UINT32_C(1) << PCT_COMPACT_KDTREE_AXIS_SHIFT) - 1)
+
 typedef struct PCT_KdTreeNode {
     uint8_t axis;
+    float coverage;
+    PCT_AaBb bounds;
+#if defined(PCT_KDTREE_PROFILE)
+    SDL_AtomicInt queryCount;
+    uint32_t heat;
+#endif
     union PCT_NodeType {
         struct PCT_TreeNode {
             float boundary;
@@ -22,9 +64,373 @@ typedef struct PCT_KdTreeNode {
     } data;
 } PCT_KdTree;
 
+typedef struct {
+    PCT_AaBb box;
+    float coverage;
+} PCT_LodBox;
+
+/**
+ * @brief 8 byte record of a compact tree. Splits keep the right child index in the low 30 bits of
+ * info and their axis in the top 2, the left child follows directly. Leaves keep
+ * PCT_KDTREE_AXIS_NONE with their entry count, followed by a record with the first box and the
+ * number of boxes stored by the leaf itself and two corner records holding the frame its entries
+ * are quantized in.
+ */
+typedef union {
+    struct {
+        float boundary;
+        uint32_t info;
+    } split;
+    struct {
+        uint32_t first;
+        uint32_t info;
+    } leaf;
+    struct {
+        float x;
+        float y;
+    } corner;
+} PCT_CompactKdNode;
+
+/**
+ * @brief Read-only kd-tree for large maps. Leaf entries are boxes clipped to the leaf and
+ * quantized outward to 8 or 16 bits per coordinate, so leaves are scanned in integers and only
+ * candidates are checked against the exact boxes. Every box is stored once, by the first leaf
+ * holding it, later leaves refer to it through boxIndices.
+ */
+typedef struct {
+    PCT_CompactKdNode *nodes;
+    size_t nodeCount;
+    uint8_t *quantized;
+    uint32_t *boxIndices;
+    size_t entryCount;
+    PCT_AaBb *boxes;
+    size_t boxCount;
+    uint8_t quantizationBits;
+    size_t memoryBytes;
+} PCT_CompactKdTree;
+
+typedef enum { PCT_OCCUPANCY_EMPTY, PCT_OCCUPANCY_PARTIAL, PCT_OCCUPANCY_FULL } PCT_Occupancy;
+
+/**
+ * @brief One resolution of the occupancy pyramid, bit set when any box touches the cell.
+ */
+typedef struct {
+    uint64_t *rows;
+    size_t width;
+    size_t height;
+    size_t wordsPerRow;
+} PCT_OccupancyLevel;
+
+/**
+ * @brief Static boxes rasterized into bitmaps. A cell is partial when any box touches it and full
+ * when a single box covers all of it, so full and empty answers are exact and only partial cells
+ * need the kd-tree. Bits are kept row major for row scans and column major for column scans,
+ * levels[0] is the partial row bitmap and every further level halves the resolution.
+ */
+typedef struct {
+    PCT_Point origin;
+    float cellSize;
+    float inverseCellSize;
+    size_t width;
+    size_t height;
+    size_t wordsPerRow;
+    size_t wordsPerColumn;
+    uint64_t *fullRows;
+    uint64_t *anyColumns;
+    uint64_t *fullColumns;
+    PCT_OccupancyLevel levels[PCT_OCCUPANCY_MAX_LEVELS];
+    size_t levelCount;
+    size_t memoryBytes;
+} PCT_OccupancyGrid;
+
+typedef enum { PCT_KDTREE_SPLIT_MEDIAN, PCT_KDTREE_SPLIT_SAH } PCT_KdTreeSplitMode;
+
+typedef struct {
+    PCT_KdTreeSplitMode splitMode;
+    size_t leafSize;
+    size_t maxDepth;
+    size_t binCount;
+    float traversalCost;
+    float intersectionCost;
+} PCT_KdTreeBuildParams;
+
+/**
+ * @brief Shape of a built tree. Leaf histogram bucket 0 counts empty leaves, bucket i counts
+ * leaves holding [2^(i-1), 2^i) boxes and the last bucket everything above.
+ */
+typedef struct {
+    size_t depth;
+    size_t nodeCount;
+    size_t leafCount;
+    size_t storedBoxes;
+    size_t sourceBoxes;
+    size_t maxLeafOccupancy;
+    size_t leafHistogram[PCT_KDTREE_STATS_BUCKETS];
+    size_t memoryBytes;
+    float duplicationFactor;
+} PCT_KdTreeStats;
+
+/**
+ * @brief Code asking the tree, set per thread with PCT_KdTreeProfileSetSite so counters of
+ * queries can be told apart without passing the site through every caller.
+ */
+typedef enum {
+    PCT_KDTREE_SITE_OTHER,
+    PCT_KDTREE_SITE_PLAYER,
+    PCT_KDTREE_SITE_ENEMY,
+    PCT_KDTREE_SITE_DRAW,
+    PCT_KDTREE_SITE_COUNT
+} PCT_KdTreeSite;
+
+/**
+ * @brief Work done by queries. Duplicate hits are boxes a range query reported more than once
+ * because they are stored by several leaves.
+ */
+typedef struct {
+    uint64_t queries;
+    uint64_t nodesVisited;
+    uint64_t leavesScanned;
+    uint64_t boxesTested;
+    uint64_t boxesHit;
+    uint64_t duplicateHits;
+} PCT_KdTreeQueryCounters;
+
+/**
+ * @brief Decisions taken while building. SAH leaves are nodes big enough to split the cost model
+ * kept whole, depth leaves are nodes big enough to split that hit the depth limit.
+ */
+typedef struct {
+    uint64_t builds;
+    uint64_t splits;
+    uint64_t leaves;
+    uint64_t straddlingCopies;
+    uint64_t sahEvaluations;
+    uint64_t sahLeaves;
+    uint64_t depthLeaves;
+} PCT_KdTreeBuildCounters;
+
+/**
+ * @brief Counters of PCT_KDTREE_PROFILE builds. Window holds the last window closed by
+ * PCT_KdTreeProfileRoll, total everything since start.
+ */
+typedef struct {
+    PCT_KdTreeQueryCounters window[PCT_KDTREE_SITE_COUNT];
+    PCT_KdTreeQueryCounters total[PCT_KDTREE_SITE_COUNT];
+    PCT_KdTreeBuildCounters build;
+    uint64_t windowCount;
+    uint32_t maxHeat;
+} PCT_KdTreeProfile;
+
+typedef struct {
+    const PCT_AaBb *box;
+    float time;
+    vec2 normal;
+} PCT_RayHit;
+
+/**
+ * @brief Slab test of ray origin + direction * t for t in [0, maxTime] against box.
+ * @param time receives entry time, 0 when origin is inside box
+ * @param normal receives surface normal at entry, zero when origin is inside box
+ */
+bool PCT_RayBoxTest(const PCT_Point *origin, const PCT_Vector *direction, const PCT_AaBb *box,
+                    float maxTime, float *time, vec2 normal);
+
 PCT_KdTree *PCT_BuildKdTree(PCT_AaBb *boxes, size_t boxesCount);
+
+/**
+ * @brief Median split, PCT_KDTREE_LEAF_SIZE leaves and PCT_KDTREE_MAX_DEPTH depth, same tree as
+ * PCT_BuildKdTree builds.
+ */
+PCT_KdTreeBuildParams PCT_KdTreeDefaultBuildParams(void);
+
+/**
+ * @brief Builds tree with split strategy, leaf size and depth chosen at run time.
+ * Takes ownership of boxes same as PCT_BuildKdTree. maxDepth is clamped to PCT_KDTREE_MAX_DEPTH.
+ * With PCT_KDTREE_SPLIT_SAH leafSize is the smallest node that is considered for splitting, the
+ * cost model decides whether bigger nodes are split.
+ */
+PCT_KdTree *PCT_BuildKdTreeWithParams(PCT_AaBb *boxes, size_t boxesCount,
+                                      const PCT_KdTreeBuildParams *params);
+
+/**
+ * @brief Collects depth, leaf occupancy histogram, duplication factor and memory of tree.
+ * @param sourceBoxesCount number of boxes tree was built from, used for duplication factor
+ */
+void PCT_KdTreeComputeStats(const PCT_KdTree *tree, size_t sourceBoxesCount,
+                            PCT_KdTreeStats *stats);
+void PCT_KdTreePrintStats(const PCT_KdTreeStats *stats, FILE *stream);
+
+#if defined(PCT_KDTREE_PROFILE)
+#define PCT_KDTREE_PROFILE_QUERY(counters) PCT_KdTreeProfileAddQuery(counters)
+#define PCT_KDTREE_PROFILE_BUILD(counters) PCT_KdTreeProfileAddBuild(counters)
+#define PCT_KDTREE_PROFILE_LEAF(leaf) PCT_KdTreeProfileAddLeaf(leaf)
+#else
+#define PCT_KDTREE_PROFILE_QUERY(counters) ((void)(counters))
+#define PCT_KDTREE_PROFILE_BUILD(counters) ((void)(counters))
+#define PCT_KDTREE_PROFILE_LEAF(leaf) ((void)(leaf))
+#endif
+
+/**
+ * @return true when built with PCT_KDTREE_PROFILE, all other profile calls do nothing otherwise
+ */
+bool PCT_KdTreeProfileEnabled(void);
+
+/**
+ * @brief Attributes queries of the calling thread to site until it is set again.
+ * @return site that was set before, so callers can restore it
+ */
+PCT_KdTreeSite PCT_KdTreeProfileSetSite(PCT_KdTreeSite site);
+void PCT_KdTreeProfileAddQuery(const PCT_KdTreeQueryCounters *counters);
+void PCT_KdTreeProfileAddBuild(const PCT_KdTreeBuildCounters *counters);
+void PCT_KdTreeProfileAddLeaf(const PCT_KdTree *leaf);
+
+/**
+ * @brief Closes the current window. Query counters gathered since the previous call move into
+ * profile and query counts of the leaves of tree become their heat.
+ */
+void PCT_KdTreeProfileRoll(const PCT_KdTree *tree, PCT_KdTreeProfile *profile);
+
+/**
+ * @return number of queries that scanned leaf in the last closed window
+ */
+uint32_t PCT_KdTreeLeafHeat(const PCT_KdTree *leaf);
+void PCT_KdTreePrintProfile(const PCT_KdTreeProfile *profile, FILE *stream);
 PCT_AaBb **PCT_KdTreeRangeSearch(const PCT_KdTree *tree, const PCT_AaBb *range, size_t *numBoxes);
 
+/**
+ * @brief Iterative range search writing into caller owned storage, does not allocate.
+ * @param boxes receives at most capacity pointers to boxes overlapping range
+ * @return total number of overlapping boxes, grow boxes and retry when it exceeds capacity
+ */
+size_t PCT_KdTreeRangeQuery(const PCT_KdTree *tree, const PCT_AaBb *range, const PCT_AaBb **boxes,
+                            size_t capacity);
+
+/**
+ * @brief Collects what has to be drawn to show view at given detail. Subtrees whose bounds fit
+ * in minExtent are returned as their bounds with coverage being the filled fraction, leaf boxes
+ * smaller than minExtent are merged with their neighbours. Does not allocate.
+ * @param minExtent world size below which detail is not visible, e.g. size of a pixel
+ * @param boxes receives at most capacity boxes to draw
+ * @return total number of boxes to draw, grow boxes and retry when it exceeds capacity
+ */
+size_t PCT_KdTreeLodQuery(const PCT_KdTree *tree, const PCT_AaBb *view, float minExtent,
+                          PCT_LodBox *boxes, size_t capacity);
+
+/**
+ * @brief Traces ray origin + direction * t for t in [0, maxTime] visiting nodes front to back and
+ * stops at the first hit. Does not allocate.
+ * @param hit receives nearest hit box, its time and surface normal, may be NULL
+ * @return true when any box is hit
+ */
+bool PCT_KdTreeRaycast(const PCT_KdTree *tree, const PCT_Point *origin, const PCT_Vector *direction,
+                       float maxTime, PCT_RayHit *hit);
+
+/**
+ * @brief Traces segment from -> to, hit time is a fraction of the segment length.
+ */
+bool PCT_KdTreeSegmentCast(const PCT_KdTree *tree, const PCT_Point *from, const PCT_Point *to,
+                           PCT_RayHit *hit);
+
+/**
+ * @brief Traces many rays together, tree is walked once per PCT_RAY_PACKET_SIZE rays.
+ * Does not allocate.
+ * @param maxTimes per ray limits, NULL means 1.0 for every ray
+ * @param hits receives nearest hit for every ray, box is NULL for rays that missed
+ * @return number of rays that hit anything
+ */
+size_t PCT_KdTreeRaycastPacket(const PCT_KdTree *tree, const PCT_Point *origins,
+                               const PCT_Vector *directions, const float *maxTimes, size_t count,
+                               PCT_RayHit *hits);
+
+/**
+ * @brief Finds up to k boxes closest to point, boxes containing point are at distance 0.
+ * Walks the tree near side first and prunes far sides that cannot beat the current k-th distance.
+ * Does not allocate.
+ * @param boxes receives up to k nearest boxes ordered by distance
+ * @param distances receives distances matching boxes, must hold k values
+ * @return number of boxes found, less than k only when the tree holds fewer boxes
+ */
+size_t PCT_KdTreeNearest(const PCT_KdTree *tree, const PCT_Point *point, size_t k,
+                         const PCT_AaBb **boxes, float *distances);
+
+/**
+ * @brief Finds boxes containing point descending a single path of the tree. Boxes are treated as
+ * half open, x1 <= x < x2 and y1 <= y < y2, so a point on a shared edge belongs to one box.
+ * Does not allocate.
+ * @param boxes receives at most capacity pointers to boxes containing point
+ * @return total number of boxes containing point
+ */
+size_t PCT_KdTreePointQuery(const PCT_KdTree *tree, const PCT_Point *point, const PCT_AaBb **boxes,
+                            size_t capacity);
+
 void PCT_DestroyKdTree(PCT_KdTree *tree);
 
+/**
+ * @brief Builds a tree with params and packs it, quantizing leaf entries to quantizationBits,
+ * 8 or 16. Boxes are only read. User should call PCT_DestroyCompactKdTree to free it.
+ */
+PCT_CompactKdTree *PCT_BuildCompactKdTree(const PCT_AaBb *boxes, size_t boxesCount,
+                                          const PCT_KdTreeBuildParams *params,
+                                          uint8_t quantizationBits);
+void PCT_DestroyCompactKdTree(PCT_CompactKdTree *tree);
+
+/**
+ * @brief Same as PCT_KdTreeRangeQuery, a box straddling several leaves may be reported fewer
+ * times. Does not allocate.
+ */
+size_t PCT_CompactKdTreeRangeQuery(const PCT_CompactKdTree *tree, const PCT_AaBb *range,
+                                   const PCT_AaBb **boxes, size_t capacity);
+
+/**
+ * @brief Same as PCT_KdTreeRaycast. Does not allocate.
+ */
+bool PCT_CompactKdTreeRaycast(const PCT_CompactKdTree *tree, const PCT_Point *origin,
+                              const PCT_Vector *direction, float maxTime, PCT_RayHit *hit);
+bool PCT_CompactKdTreeSegmentCast(const PCT_CompactKdTree *tree, const PCT_Point *from,
+                                  const PCT_Point *to, PCT_RayHit *hit);
+
+/**
+ * @brief Rasterizes boxes into cells of cellSize, growing cells until the grid fits in
+ * PCT_OCCUPANCY_MAX_CELLS. Boxes are only read. User should call PCT_DestroyOccupancyGrid to free
+ * it.
+ */
+PCT_OccupancyGrid *PCT_BuildOccupancyGrid(const PCT_AaBb *boxes, size_t boxesCount,
+                                          float cellSize);
+void PCT_DestroyOccupancyGrid(PCT_OccupancyGrid *grid);
+
+/**
+ * @return occupancy of the cell holding point, empty outside the grid
+ */
+PCT_Occupancy PCT_OccupancyAtPoint(const PCT_OccupancyGrid *grid, const PCT_Point *point);
+
+/**
+ * @brief Scans the column under point down to point.y - maxDistance.
+ * @param distance receives distance from point to the top of the first full cell, or of the first
+ * partial cell when there is none, may be NULL
+ * @return full when a full cell is in range, partial when only partial cells are and the kd-tree
+ * has to decide, empty when no box is in range
+ */
+PCT_Occupancy PCT_OccupancyGroundBelow(const PCT_OccupancyGrid *grid, const PCT_Point *point,
+                                       float maxDistance, float *distance);
+
+/**
+ * @brief Measures how far from point the row continues in direction, -1 or 1, while its cells
+ * are all full when solid is set or all empty otherwise. Whole words are skipped at once.
+ * @return distance to the end of the run, at most maxDistance
+ */
+float PCT_OccupancyRowRun(const PCT_OccupancyGrid *grid, const PCT_Point *point, float direction,
+                          bool solid, float maxDistance);
+
+/**
+ * @brief Same as PCT_OccupancyRowRun along the column of point, direction 1 goes up.
+ */
+float PCT_OccupancyColumnRun(const PCT_OccupancyGrid *grid, const PCT_Point *point,
+                             float direction, bool solid, float maxDistance);
+
+/**
+ * @brief Tests box against coarse levels first and descends only while they report something.
+ * @return true when no box touches any cell overlapped by box
+ */
+bool PCT_OccupancyBoxEmpty(const PCT_OccupancyGrid *grid, const PCT_AaBb *box);
+
 #endif // PCT_STRUCTURES